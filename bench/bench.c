@@ -0,0 +1,69 @@
+#if !defined(_WIN32)
+#define _POSIX_C_SOURCE 199309L
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+double bench_now_seconds(void) {
+#if defined(_WIN32)
+    LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+#endif
+}
+
+bool bench_read_file(const char* filename, unsigned char** data, unsigned long* size) {
+    FILE* file = fopen(filename, "rb");
+    if (file == NULL) {
+        return false;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long file_size = ftell(file);
+    rewind(file);
+
+    unsigned char* buffer = (unsigned char*)malloc(file_size > 0 ? file_size : 1);
+    if (buffer == NULL || fread(buffer, 1, file_size, file) != (size_t)file_size) {
+        free(buffer);
+        fclose(file);
+        return false;
+    }
+    fclose(file);
+
+    *data = buffer;
+    *size = (unsigned long)file_size;
+    return true;
+}
+
+// the counters run for the whole process, a section is the difference of two reads.
+static perf_counters_t section_start;
+
+void bench_counters_begin(void) {
+    read_perf_counters(&section_start);
+}
+
+void bench_counters_end(bench_counters_t* counters) {
+    read_perf_counters(counters);
+    for (int counter = 0; counter < PERF_COUNTER_COUNT; ++counter) {
+        if (counters->values[counter] < 0 || section_start.values[counter] < 0) {
+            counters->values[counter] = -1;
+        } else {
+            counters->values[counter] -= section_start.values[counter];
+        }
+    }
+}
@@ -0,0 +1,20 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdbool.h>
+#include "perf.h"
+
+// wall clock in seconds, from a monotonic high resolution counter.
+double bench_now_seconds(void);
+
+// read a whole file into a malloc'd buffer. returns false if the file can not be read.
+bool bench_read_file(const char* filename, unsigned char** data, unsigned long* size);
+
+// hardware counters around a measured section, read through perf.h: every value is the count between begin and end,
+// or -1 where perf.h has no such counter (not linux, perf_event_paranoid, most vms). open_perf_counters() first.
+typedef perf_counters_t bench_counters_t;
+
+void bench_counters_begin(void);
+void bench_counters_end(bench_counters_t* counters);
+
+#endif
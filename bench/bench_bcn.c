@@ -0,0 +1,166 @@
+// block compressed texture storage against plain 32 bit texels (see bcn.h).
+// for every texture it reports the memory and the error of BC1 and BC3, then samples it the way draw_texel() does
+// over a rotated, magnified quad, reading plain texels, blocks through the decoded block cache and blocks decoded
+// on every sample, so the saved memory traffic can be weighed against the decode work.
+// usage: bench_bcn [iterations] [file.png ...]
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "bench.h"
+#include "bcn.h"
+#include "upng.h"
+
+static const char* default_files[] = {
+    "./assets/crab.png",
+    "./assets/drone.png",
+    "./assets/f22.png",
+};
+
+enum SAMPLER {
+    SAMPLER_PLAIN,
+    SAMPLER_BC1_CACHED,
+    SAMPLER_BC1_UNCACHED,
+    SAMPLER_BC3_CACHED,
+    SAMPLER_BC3_UNCACHED,
+    SAMPLER_COUNT
+};
+
+static const char* sampler_names[SAMPLER_COUNT] = {
+    "RGBA8",
+    "BC1 block cache",
+    "BC1 no cache",
+    "BC3 block cache",
+    "BC3 no cache",
+};
+
+// the quad covers this many pixels on a side, at about 1.5 texels per pixel.
+#define QUAD_SIZE 512
+
+// peak signal to noise ratio over the color channels, in dB.
+static double get_psnr(const uint32_t* texels, const compressed_texture_t* compressed) {
+    double squared_error = 0.0;
+    for (int y = 0; y < compressed->height; ++y) {
+        for (int x = 0; x < compressed->width; ++x) {
+            uint32_t a = texels[y * compressed->width + x];
+            uint32_t b = sample_compressed_texture_uncached(compressed, x, y);
+            for (int channel = 0; channel < 3; ++channel) {
+                double delta = (double)((a >> (channel * 8)) & 0xFF) - (double)((b >> (channel * 8)) & 0xFF);
+                squared_error += delta * delta;
+            }
+        }
+    }
+    double mean_squared_error = squared_error / (3.0 * compressed->width * compressed->height);
+    return mean_squared_error > 0.0 ? 10.0 * log10(255.0 * 255.0 / mean_squared_error) : 99.0;
+}
+
+// scanline order over the quad, like the rasterizer. the checksum keeps the samples from being optimized away.
+static uint32_t run_sampling_pass(int sampler, const uint32_t* texels, int width, int height,
+                                  const compressed_texture_t* bc1, const compressed_texture_t* bc3) {
+    const float angle = 0.5f;
+    const float scale = 1.5f / QUAD_SIZE;
+    float du_dx = cosf(angle) * scale;
+    float dv_dx = sinf(angle) * scale;
+    uint32_t checksum = 0;
+    for (int y = 0; y < QUAD_SIZE; ++y) {
+        float u = -sinf(angle) * scale * y;
+        float v = cosf(angle) * scale * y;
+        for (int x = 0; x < QUAD_SIZE; ++x) {
+            int tex_x = abs((int)(u * width)) % width;
+            int tex_y = abs((int)(v * height)) % height;
+            switch (sampler) {
+                case SAMPLER_PLAIN: checksum += texels[tex_y * width + tex_x]; break;
+                case SAMPLER_BC1_CACHED: checksum += sample_compressed_texture(bc1, tex_x, tex_y); break;
+                case SAMPLER_BC1_UNCACHED: checksum += sample_compressed_texture_uncached(bc1, tex_x, tex_y); break;
+                case SAMPLER_BC3_CACHED: checksum += sample_compressed_texture(bc3, tex_x, tex_y); break;
+                case SAMPLER_BC3_UNCACHED: checksum += sample_compressed_texture_uncached(bc3, tex_x, tex_y); break;
+            }
+            u += du_dx;
+            v += dv_dx;
+        }
+    }
+    return checksum;
+}
+
+int main(int argc, char* argv[]) {
+    int iterations = 50;
+    const char** files = default_files;
+    int file_count = sizeof(default_files) / sizeof(default_files[0]);
+
+    if (argc > 1) {
+        iterations = atoi(argv[1]);
+        if (iterations <= 0) {
+            fprintf(stderr, "usage: %s [iterations] [file.png ...]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (argc > 2) {
+        files = (const char**)&argv[2];
+        file_count = argc - 2;
+    }
+
+    // before any table is printed, so a missing counter is reported above it and reads n/a inside.
+    open_perf_counters();
+    for (int file_idx = 0; file_idx < file_count; ++file_idx) {
+        upng_t* png_image = upng_new_from_file(files[file_idx]);
+        if (png_image == NULL || upng_decode(png_image) != UPNG_EOK || upng_get_format(png_image) != UPNG_RGBA8) {
+            printf("%s: unable to decode as RGBA.\n", files[file_idx]);
+            if (png_image != NULL) {
+                upng_free(png_image);
+            }
+            continue;
+        }
+        int width = upng_get_width(png_image);
+        int height = upng_get_height(png_image);
+        const uint32_t* texels = (const uint32_t*)upng_get_buffer(png_image);
+
+        double start = bench_now_seconds();
+        compressed_texture_t* bc1 = compress_texture(texels, width, height, BLOCK_FORMAT_BC1);
+        double bc1_seconds = bench_now_seconds() - start;
+        start = bench_now_seconds();
+        compressed_texture_t* bc3 = compress_texture(texels, width, height, BLOCK_FORMAT_BC3);
+        double bc3_seconds = bench_now_seconds() - start;
+
+        printf("%s: %dx%d, RGBA8 %d KB\n", files[file_idx], width, height, width * height * 4 / 1024);
+        printf("  BC1 %6zu KB, %5.1f dB, compressed in %.2f ms\n", get_compressed_texture_size(bc1) / 1024, get_psnr(texels, bc1), bc1_seconds * 1000.0);
+        printf("  BC3 %6zu KB, %5.1f dB, compressed in %.2f ms\n", get_compressed_texture_size(bc3) / 1024, get_psnr(texels, bc3), bc3_seconds * 1000.0);
+
+        printf("  %-18s %10s %10s", "sampler", "best ms", "ns/texel");
+        for (int counter = 0; counter < PERF_COUNTER_COUNT; ++counter) {
+            printf(" %16s", get_perf_counter_name(counter));
+        }
+        printf("\n");
+
+        for (int sampler = 0; sampler < SAMPLER_COUNT; ++sampler) {
+            uint32_t checksum = 0;
+            double best_seconds = 1e30;
+            bench_counters_t counters;
+            bench_counters_begin();
+            for (int iteration = 0; iteration < iterations; ++iteration) {
+                double pass_start = bench_now_seconds();
+                checksum += run_sampling_pass(sampler, texels, width, height, bc1, bc3);
+                double elapsed = bench_now_seconds() - pass_start;
+                if (elapsed < best_seconds) {
+                    best_seconds = elapsed;
+                }
+            }
+            bench_counters_end(&counters);
+
+            printf("  %-18s %10.3f %10.2f", sampler_names[sampler], best_seconds * 1000.0, best_seconds * 1e9 / (QUAD_SIZE * QUAD_SIZE));
+            // per pass, so the numbers compare across iteration counts.
+            for (int counter = 0; counter < PERF_COUNTER_COUNT; ++counter) {
+                if (counters.values[counter] < 0) {
+                    printf(" %16s", "n/a");
+                } else {
+                    printf(" %16.0f", (double)counters.values[counter] / iterations);
+                }
+            }
+            printf("   (checksum %08x)\n", checksum);
+        }
+        printf("\n");
+
+        free_compressed_texture(bc1);
+        free_compressed_texture(bc3);
+        upng_free(png_image);
+    }
+    return 0;
+}
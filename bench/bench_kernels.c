@@ -0,0 +1,399 @@
+// microbenchmarks of the renderer's inner kernels over synthetic inputs: math, clipping, rasterization, shading,
+// texture decode and mesh loading. every kernel runs in batches of a calibrated size (about 2 ms each), the batch
+// is timed as a whole, and the median over the repetitions is reported as ns/op, with the fastest batch and the
+// median absolute deviation to tell a steady number from a noisy one. kernels that draw also report Mpixels/s.
+// usage: bench_kernels [repetitions] [name filter]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "bench.h"
+#include "array.h"
+#include "asset.h"
+#include "clipping.h"
+#include "display.h"
+#include "light.h"
+#include "matrix.h"
+#include "stats.h"
+#include "triangle.h"
+#include "upng.h"
+#include "vector.h"
+
+#define MIN_BATCH_SECONDS 0.002
+#define MAX_BATCH_OP_COUNT (1 << 19)
+// inputs are cycled through, a power of two so an op picks its input with a mask.
+#define INPUT_COUNT 1024
+#define TARGET_WIDTH 1024
+#define TARGET_HEIGHT 768
+
+static const char* texture_filename = "./assets/f22.png";
+static const char* png_filename = "./assets/f22.png";
+static const char* obj_filename = "./assets/f22.obj";
+
+// a kernel runs op_count ops of its kind with param, and returns how many pixels they drew (0 if they do not draw).
+typedef double (*kernel_function_t)(int param, int op_count);
+
+typedef struct {
+    const char* name;
+    kernel_function_t function;
+    int param;
+    void (*prepare)(void); // before every batch, outside the timing. may be NULL.
+} kernel_t;
+
+// results go here so the compiler can not drop the work.
+static volatile float float_sink;
+static volatile uint32_t int_sink;
+
+static uint32_t random_state = 12345;
+
+static float random_float(float min, float max) {
+    random_state = random_state * 1664525u + 1013904223u;
+    return min + (max - min) * (float)(random_state >> 8) / (float)(1u << 24);
+}
+
+static mat4_t matrices[INPUT_COUNT];
+static vec4_t vectors[INPUT_COUNT];
+static vec2_t points[INPUT_COUNT];
+static uint32_t colors[INPUT_COUNT];
+static float factors[INPUT_COUNT];
+static upng_t* texture = NULL;
+static unsigned char* png_data = NULL;
+static unsigned long png_size = 0;
+
+static void make_inputs(void) {
+    for (int input_idx = 0; input_idx < INPUT_COUNT; ++input_idx) {
+        for (int row = 0; row < 4; ++row) {
+            for (int column = 0; column < 4; ++column) {
+                matrices[input_idx].m[row][column] = random_float(-1.0, 1.0);
+            }
+        }
+        vectors[input_idx] = vec4_from_vec3(vec3_new(random_float(-10.0, 10.0), random_float(-10.0, 10.0), random_float(-10.0, 10.0)));
+        points[input_idx] = vec2_new(random_float(0.0, TARGET_WIDTH), random_float(0.0, TARGET_HEIGHT));
+        colors[input_idx] = 0xFF000000 | ((uint32_t)random_float(0.0, 16777215.0));
+        factors[input_idx] = random_float(-0.2, 1.2);
+    }
+}
+
+static double run_mat4_mul_mat4(int param, int op_count) {
+    float sum = 0.0;
+    for (int op_idx = 0; op_idx < op_count; ++op_idx) {
+        mat4_t result = mat4_mul_mat4(matrices[op_idx & (INPUT_COUNT - 1)], matrices[(op_idx + 1) & (INPUT_COUNT - 1)]);
+        sum += result.m[op_idx & 3][3];
+    }
+    float_sink = sum;
+    return 0.0;
+}
+
+static double run_mat4_mul_vec4(int param, int op_count) {
+    float sum = 0.0;
+    for (int op_idx = 0; op_idx < op_count; ++op_idx) {
+        vec4_t result = mat4_mul_vec4(matrices[(op_idx >> 4) & (INPUT_COUNT - 1)], vectors[op_idx & (INPUT_COUNT - 1)]);
+        sum += result.w;
+    }
+    float_sink = sum;
+    return 0.0;
+}
+
+static double run_barycentric_weights(int param, int op_count) {
+    float sum = 0.0;
+    for (int op_idx = 0; op_idx < op_count; ++op_idx) {
+        vec3_t weights = barycentric_weights(points[op_idx & (INPUT_COUNT - 1)], points[(op_idx + 1) & (INPUT_COUNT - 1)],
+            points[(op_idx + 2) & (INPUT_COUNT - 1)], points[(op_idx + 3) & (INPUT_COUNT - 1)]);
+        sum += weights.y;
+    }
+    float_sink = sum;
+    return 0.0;
+}
+
+enum CLIP_CASE {
+    CLIP_CASE_INSIDE, // no plane crosses it.
+    CLIP_CASE_NEAR, // crosses the near plane.
+    CLIP_CASE_CORNER, // crosses the left and the top plane.
+    CLIP_CASE_OUTSIDE, // entirely left of the frustum.
+    CLIP_CASE_COUNT
+};
+
+#define CLIP_POLYGON_COUNT 64
+static polygon_t clip_polygons[CLIP_CASE_COUNT][CLIP_POLYGON_COUNT];
+
+// camera space triangles in the frustum of the renderer (60 degrees vertically, 4:3, 0.1 to 100), jittered.
+static void make_clip_polygons(void) {
+    vec3_t centers[CLIP_CASE_COUNT] = { {0.0, 0.0, 10.0}, {0.0, 0.0, 0.1}, {-7.7, 5.8, 10.0}, {-30.0, 0.0, 10.0} };
+    tex2_t uvs[3] = { {0.0, 0.0}, {1.0, 0.0}, {0.0, 1.0} };
+    for (int clip_case = 0; clip_case < CLIP_CASE_COUNT; ++clip_case) {
+        for (int polygon_idx = 0; polygon_idx < CLIP_POLYGON_COUNT; ++polygon_idx) {
+            vec3_t vertices[3];
+            for (int vertex_idx = 0; vertex_idx < 3; ++vertex_idx) {
+                vertices[vertex_idx] = vec3_new(centers[clip_case].x + random_float(-2.0, 2.0), centers[clip_case].y + random_float(-2.0, 2.0),
+                    centers[clip_case].z + random_float(-0.5, 0.5));
+            }
+            clip_polygons[clip_case][polygon_idx] = create_polygon_from_triangle(vertices[0], vertices[1], vertices[2], uvs[0], uvs[1], uvs[2]);
+        }
+    }
+}
+
+// clipping works in place, so every op starts from a copy of the polygon.
+static double run_clip_polygon(int clip_case, int op_count) {
+    int vertex_count = 0;
+    for (int op_idx = 0; op_idx < op_count; ++op_idx) {
+        polygon_t polygon = clip_polygons[clip_case][op_idx & (CLIP_POLYGON_COUNT - 1)];
+        clip_polygon(&polygon);
+        vertex_count += polygon.vertex_count;
+    }
+    int_sink = vertex_count;
+    return 0.0;
+}
+
+// a convex fan of vertex_count vertices, the most a clipped triangle gets is 9.
+static double run_triangles_from_polygon(int vertex_count, int op_count) {
+    polygon_t polygon;
+    polygon.vertex_count = vertex_count;
+    for (int vertex_idx = 0; vertex_idx < vertex_count; ++vertex_idx) {
+        float angle = 2.0 * M_PI * vertex_idx / vertex_count;
+        polygon.vertices[vertex_idx] = vec3_new(cosf(angle), sinf(angle), 1.0);
+        polygon.texcoords[vertex_idx] = (tex2_t){ cosf(angle) * 0.5f + 0.5f, sinf(angle) * 0.5f + 0.5f };
+    }
+    triangle_t triangles[MAX_POLYGON_TRIANGLE_COUNT];
+    int total_count = 0;
+    for (int op_idx = 0; op_idx < op_count; ++op_idx) {
+        int triangle_count = 0;
+        polygon.vertices[0].z = 1.0 + (op_idx & 7);
+        triangles_from_polygon(&polygon, triangles, &triangle_count);
+        total_count += triangle_count + (int)triangles[triangle_count - 1].points[0].z;
+    }
+    int_sink = total_count;
+    return 0.0;
+}
+
+// every triangle of a batch lands in front of the ones before it, so all of its fragments pass the depth test
+// and get written, whatever they overlap. depth runs from 0.99 towards the camera in steps the z buffer resolves.
+static float get_batch_w(int op_idx) {
+    float depth = 0.99f - op_idx * 1e-6f;
+    return 1.0f / (1.0f - depth);
+}
+
+static int64_t get_fragments_tested(void) {
+    return get_frame_pipeline_stats()->fragments_tested;
+}
+
+// right triangles with legs of size pixels, half of them flipped, at positions spread over the target.
+static double run_draw_filled_triangle(int size, int op_count) {
+    int64_t fragments_before = get_fragments_tested();
+    for (int op_idx = 0; op_idx < op_count; ++op_idx) {
+        vec2_t point = points[op_idx & (INPUT_COUNT - 1)];
+        int x = (int)point.x % (TARGET_WIDTH - size);
+        int y = (int)point.y % (TARGET_HEIGHT - size);
+        int flip = op_idx & 1 ? size : 0;
+        float w = get_batch_w(op_idx);
+        draw_filled_triangle(x + flip, y, 0.0, w, x + size - flip, y + size, 0.0, w, x, y + size - flip, 0.0, w, colors[op_idx & (INPUT_COUNT - 1)]);
+    }
+    return (double)(get_fragments_tested() - fragments_before);
+}
+
+static double run_draw_textured_triangle(int size, int op_count) {
+    int64_t fragments_before = get_fragments_tested();
+    for (int op_idx = 0; op_idx < op_count; ++op_idx) {
+        vec2_t point = points[op_idx & (INPUT_COUNT - 1)];
+        int x = (int)point.x % (TARGET_WIDTH - size);
+        int y = (int)point.y % (TARGET_HEIGHT - size);
+        int flip = op_idx & 1 ? size : 0;
+        float w = get_batch_w(op_idx);
+        draw_textured_triangle(x + flip, y, 0.0, w, 0.0, 0.0, x + size - flip, y + size, 0.0, w, 1.0, 1.0,
+            x, y + size - flip, 0.0, w, 0.0, 1.0, texture);
+    }
+    return (double)(get_fragments_tested() - fragments_before);
+}
+
+// lines of length pixels in every direction, the longer axis decides how many pixels a line takes.
+static double run_draw_line(int length, int op_count) {
+    double pixel_count = 0.0;
+    for (int op_idx = 0; op_idx < op_count; ++op_idx) {
+        vec2_t point = points[op_idx & (INPUT_COUNT - 1)];
+        float angle = factors[op_idx & (INPUT_COUNT - 1)] * 2.0 * M_PI;
+        int x0 = (int)point.x;
+        int y0 = (int)point.y;
+        int x1 = x0 + (int)(cosf(angle) * length);
+        int y1 = y0 + (int)(sinf(angle) * length);
+        draw_line(x0, y0, x1, y1, colors[op_idx & (INPUT_COUNT - 1)]);
+        pixel_count += (abs(x1 - x0) > abs(y1 - y0) ? abs(x1 - x0) : abs(y1 - y0)) + 1;
+    }
+    return pixel_count;
+}
+
+static double run_light_apply_intensity(int param, int op_count) {
+    uint32_t sum = 0;
+    for (int op_idx = 0; op_idx < op_count; ++op_idx) {
+        sum += light_apply_intensity(colors[op_idx & (INPUT_COUNT - 1)], factors[(op_idx * 7) & (INPUT_COUNT - 1)]);
+    }
+    int_sink = sum;
+    return 0.0;
+}
+
+enum UPNG_STAGE {
+    UPNG_STAGE_HEADER, // signature and IHDR only.
+    UPNG_STAGE_DECODE, // header, inflate, unfilter and the scanline post process.
+};
+
+// upng keeps inflate and unfilter to itself, so the stages are timed as far as its interface goes.
+static double run_upng(int stage, int op_count) {
+    double pixel_count = 0.0;
+    for (int op_idx = 0; op_idx < op_count; ++op_idx) {
+        upng_t* png_image = upng_new_from_bytes(png_data, png_size);
+        upng_error error = stage == UPNG_STAGE_HEADER ? upng_header(png_image) : upng_decode(png_image);
+        if (stage == UPNG_STAGE_DECODE && error == UPNG_EOK) {
+            pixel_count += (double)upng_get_width(png_image) * upng_get_height(png_image);
+        }
+        int_sink = error;
+        upng_free(png_image);
+    }
+    return pixel_count;
+}
+
+static double run_load_obj_file_data(int param, int op_count) {
+    int face_count = 0;
+    for (int op_idx = 0; op_idx < op_count; ++op_idx) {
+        geometry_lod_t geometry = { 0 };
+        load_obj_file_data(obj_filename, &geometry);
+        face_count += array_length(geometry.faces);
+        array_free(geometry.vertices);
+        array_free(geometry.faces);
+    }
+    int_sink = face_count;
+    return 0.0;
+}
+
+static void prepare_raster(void) {
+    clear_z_buffer();
+}
+
+static const kernel_t kernels[] = {
+    { "mat4_mul_mat4", run_mat4_mul_mat4, 0, NULL },
+    { "mat4_mul_vec4", run_mat4_mul_vec4, 0, NULL },
+    { "barycentric_weights", run_barycentric_weights, 0, NULL },
+    { "clip_polygon inside", run_clip_polygon, CLIP_CASE_INSIDE, NULL },
+    { "clip_polygon near", run_clip_polygon, CLIP_CASE_NEAR, NULL },
+    { "clip_polygon corner", run_clip_polygon, CLIP_CASE_CORNER, NULL },
+    { "clip_polygon outside", run_clip_polygon, CLIP_CASE_OUTSIDE, NULL },
+    { "triangles_from_polygon 3", run_triangles_from_polygon, 3, NULL },
+    { "triangles_from_polygon 6", run_triangles_from_polygon, 6, NULL },
+    { "triangles_from_polygon 9", run_triangles_from_polygon, 9, NULL },
+    { "draw_filled_triangle 4px", run_draw_filled_triangle, 4, prepare_raster },
+    { "draw_filled_triangle 16px", run_draw_filled_triangle, 16, prepare_raster },
+    { "draw_filled_triangle 64px", run_draw_filled_triangle, 64, prepare_raster },
+    { "draw_filled_triangle 256px", run_draw_filled_triangle, 256, prepare_raster },
+    { "draw_textured_triangle 4px", run_draw_textured_triangle, 4, prepare_raster },
+    { "draw_textured_triangle 16px", run_draw_textured_triangle, 16, prepare_raster },
+    { "draw_textured_triangle 64px", run_draw_textured_triangle, 64, prepare_raster },
+    { "draw_textured_triangle 256px", run_draw_textured_triangle, 256, prepare_raster },
+    { "draw_line 16px", run_draw_line, 16, NULL },
+    { "draw_line 128px", run_draw_line, 128, NULL },
+    { "light_apply_intensity", run_light_apply_intensity, 0, NULL },
+    { "upng_header", run_upng, UPNG_STAGE_HEADER, NULL },
+    { "upng_decode", run_upng, UPNG_STAGE_DECODE, NULL },
+    { "load_obj_file_data", run_load_obj_file_data, 0, NULL },
+};
+
+static int compare_doubles(const void* lhs, const void* rhs) {
+    double a = *(const double*)lhs;
+    double b = *(const double*)rhs;
+    return (a > b) - (a < b);
+}
+
+static double time_batch(const kernel_t* kernel, int op_count, double* pixel_count) {
+    if (kernel->prepare != NULL) {
+        kernel->prepare();
+    }
+    double start = bench_now_seconds();
+    *pixel_count = kernel->function(kernel->param, op_count);
+    return bench_now_seconds() - start;
+}
+
+static void run_kernel(const kernel_t* kernel, int repetitions) {
+    // double the batch until it takes long enough for the clock, the first batches warm the caches up too.
+    int op_count = 1;
+    double pixel_count = 0.0;
+    while (time_batch(kernel, op_count, &pixel_count) < MIN_BATCH_SECONDS && op_count < MAX_BATCH_OP_COUNT) {
+        op_count *= 2;
+    }
+
+    double* ns_per_op = (double*)malloc(sizeof(double) * repetitions);
+    double pixels_per_op = 0.0;
+    for (int repetition = 0; repetition < repetitions; ++repetition) {
+        ns_per_op[repetition] = time_batch(kernel, op_count, &pixel_count) * 1e9 / op_count;
+        pixels_per_op = pixel_count / op_count;
+    }
+    qsort(ns_per_op, repetitions, sizeof(double), compare_doubles);
+    double median = ns_per_op[repetitions / 2];
+    double min = ns_per_op[0];
+    for (int repetition = 0; repetition < repetitions; ++repetition) {
+        ns_per_op[repetition] = fabs(ns_per_op[repetition] - median);
+    }
+    qsort(ns_per_op, repetitions, sizeof(double), compare_doubles);
+    double deviation = ns_per_op[repetitions / 2];
+    free(ns_per_op);
+
+    printf("%-30s %10d %12.2f %12.2f %7.1f%%", kernel->name, op_count, median, min, median > 0.0 ? deviation * 100.0 / median : 0.0);
+    if (pixels_per_op > 0.0) {
+        // pixels per ns are gigapixels per second.
+        printf(" %12.1f %10.1f", pixels_per_op * 1000.0 / median, pixels_per_op);
+    }
+    printf("\n");
+}
+
+int main(int argc, char* argv[]) {
+    int repetitions = 15;
+    const char* filter = NULL;
+    if (argc > 1) {
+        repetitions = atoi(argv[1]);
+        if (repetitions <= 0) {
+            fprintf(stderr, "usage: %s [repetitions] [name filter]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (argc > 2) {
+        filter = argv[2];
+    }
+
+    make_inputs();
+    make_clip_polygons();
+    float fovy = M_PI / 3.0;
+    float fovx = atan(tan(fovy / 2) * (800.0 / 600.0)) * 2.0;
+    init_frustrum_planes(fovx, fovy, 0.1, 100.0);
+    initialize_offscreen(TARGET_WIDTH, TARGET_HEIGHT);
+    set_render_mode(RENDER_MODE_TEXTURED);
+    clear_color_buffer(0xFF000000);
+
+    texture = upng_new_from_file(texture_filename);
+    if (texture != NULL && (upng_decode(texture) != UPNG_EOK || upng_get_format(texture) != UPNG_RGBA8)) {
+        upng_free(texture);
+        texture = NULL;
+    }
+    bool has_png = bench_read_file(png_filename, &png_data, &png_size);
+    FILE* obj_file = fopen(obj_filename, "r");
+    bool has_obj = obj_file != NULL;
+    if (obj_file != NULL) {
+        fclose(obj_file);
+    }
+
+    printf("%d repetitions, %dx%d target\n", repetitions, TARGET_WIDTH, TARGET_HEIGHT);
+    printf("%-30s %10s %12s %12s %8s %12s %10s\n", "kernel", "ops/batch", "median ns/op", "min ns/op", "MAD", "Mpixels/s", "pixels/op");
+    for (int kernel_idx = 0; kernel_idx < (int)(sizeof(kernels) / sizeof(kernels[0])); ++kernel_idx) {
+        const kernel_t* kernel = &kernels[kernel_idx];
+        if (filter != NULL && strstr(kernel->name, filter) == NULL) {
+            continue;
+        }
+        if ((kernel->function == run_draw_textured_triangle && texture == NULL) ||
+            (kernel->function == run_upng && !has_png) || (kernel->function == run_load_obj_file_data && !has_obj)) {
+            printf("%-30s skipped, its input file is missing.\n", kernel->name);
+            continue;
+        }
+        run_kernel(kernel, repetitions);
+    }
+
+    if (texture != NULL) {
+        upng_free(texture);
+    }
+    free(png_data);
+    destroy_window();
+    return 0;
+}
@@ -0,0 +1,95 @@
+// PNG decode throughput over the bundled textures.
+// usage: bench_upng [iterations] [file.png ...]
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench.h"
+#include "upng.h"
+
+static const char* default_files[] = {
+    "./assets/crab.png",
+    "./assets/drone.png",
+    "./assets/efa.png",
+    "./assets/f117.png",
+    "./assets/f22.png",
+    "./assets/cube.png",
+    "./assets/pikuma.png",
+};
+
+int main(int argc, char* argv[]) {
+    int iterations = 20;
+    const char** files = default_files;
+    int file_count = sizeof(default_files) / sizeof(default_files[0]);
+
+    if (argc > 1) {
+        iterations = atoi(argv[1]);
+        if (iterations <= 0) {
+            fprintf(stderr, "usage: %s [iterations] [file.png ...]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (argc > 2) {
+        files = (const char**)&argv[2];
+        file_count = argc - 2;
+    }
+
+    printf("%-24s %10s %12s %12s %12s\n", "file", "pixels", "best ms", "mean ms", "MB/s");
+
+    double total_seconds = 0.0;
+    double total_bytes = 0.0;
+    for (int file_idx = 0; file_idx < file_count; ++file_idx) {
+        unsigned char* png_data = NULL;
+        unsigned long png_size = 0;
+        if (!bench_read_file(files[file_idx], &png_data, &png_size)) {
+            printf("%-24s unable to read file.\n", files[file_idx]);
+            continue;
+        }
+
+        double best_seconds = 1e30;
+        double sum_seconds = 0.0;
+        unsigned decoded_size = 0;
+        unsigned width = 0;
+        unsigned height = 0;
+        upng_error error = UPNG_EOK;
+
+        // the source is not owned by upng, so every iteration decodes from the same bytes in memory.
+        for (int iteration = 0; iteration < iterations && error == UPNG_EOK; ++iteration) {
+            upng_t* png_image = upng_new_from_bytes(png_data, png_size);
+            double start = bench_now_seconds();
+            error = upng_decode(png_image);
+            double elapsed = bench_now_seconds() - start;
+
+            decoded_size = upng_get_size(png_image);
+            width = upng_get_width(png_image);
+            height = upng_get_height(png_image);
+            upng_free(png_image);
+
+            sum_seconds += elapsed;
+            if (elapsed < best_seconds) {
+                best_seconds = elapsed;
+            }
+        }
+        free(png_data);
+
+        if (error != UPNG_EOK) {
+            printf("%-24s decode failed with error %d.\n", files[file_idx], error);
+            continue;
+        }
+
+        double mean_seconds = sum_seconds / iterations;
+        printf("%-24s %10u %12.3f %12.3f %12.1f\n",
+            files[file_idx],
+            width * height,
+            best_seconds * 1000.0,
+            mean_seconds * 1000.0,
+            decoded_size / mean_seconds / (1024.0 * 1024.0));
+
+        total_seconds += mean_seconds;
+        total_bytes += decoded_size;
+    }
+
+    if (total_seconds > 0.0) {
+        printf("%-24s %10s %12s %12.3f %12.1f\n", "total", "", "", total_seconds * 1000.0, total_bytes / total_seconds / (1024.0 * 1024.0));
+    }
+
+    return 0;
+}
@@ -0,0 +1,158 @@
+// face order before and after the load time vertex cache pass (see vcache.h).
+// for every mesh it runs the per instance geometry loop of the renderer (transform every vertex, then gather
+// the three transformed vertices of every face and backface test them) over three layouts:
+// the order the OBJ exporter wrote, the faces reordered, and the faces reordered plus the vertices renumbered.
+// usage: bench_vcache [iterations] [file.obj ...]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "array.h"
+#include "asset.h"
+#include "matrix.h"
+#include "vcache.h"
+
+static const char* default_files[] = {
+    "./assets/drone.obj",
+    "./assets/crab.obj",
+};
+
+enum LAYOUT {
+    LAYOUT_ORIGINAL,
+    LAYOUT_FACES,
+    LAYOUT_FACES_AND_VERTICES,
+    LAYOUT_COUNT
+};
+
+static const char* layout_names[LAYOUT_COUNT] = {
+    "original",
+    "faces",
+    "faces + vertices",
+};
+
+// the geometry stage of process_mesh_instance without clipping and projection.
+// returns the number of front facing faces, so the loop can not be optimized away.
+static int run_geometry_pass(geometry_lod_t* lod, mat4_t model_view, vec4_t* view_space_vertices) {
+    int vertex_count = array_length(lod->vertices);
+    for (int vertex_idx = 0; vertex_idx < vertex_count; ++vertex_idx) {
+        view_space_vertices[vertex_idx] = mat4_mul_vec4(model_view, vec4_from_vec3(lod->vertices[vertex_idx]));
+    }
+
+    int visible_count = 0;
+    int face_count = array_length(lod->faces);
+    for (int face_idx = 0; face_idx < face_count; ++face_idx) {
+        face_t face = lod->faces[face_idx];
+        vec3_t a = vec3_from_vec4(view_space_vertices[face.a]);
+        vec3_t b = vec3_from_vec4(view_space_vertices[face.b]);
+        vec3_t c = vec3_from_vec4(view_space_vertices[face.c]);
+        vec3_t normal = vec3_cross(vec3_sub(b, a), vec3_sub(c, a));
+        // the camera sits at the origin of view space.
+        if (vec3_dot(normal, vec3_mul(a, -1.0)) > 0.0) {
+            visible_count += 1;
+        }
+    }
+    return visible_count;
+}
+
+static void copy_lod(geometry_lod_t* source, geometry_lod_t* destination) {
+    destination->vertices = NULL;
+    destination->faces = NULL;
+    destination->face_normals = NULL;
+    for (int vertex_idx = 0; vertex_idx < array_length(source->vertices); ++vertex_idx) {
+        array_push(destination->vertices, source->vertices[vertex_idx]);
+    }
+    for (int face_idx = 0; face_idx < array_length(source->faces); ++face_idx) {
+        array_push(destination->faces, source->faces[face_idx]);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int iterations = 2000;
+    const char** files = default_files;
+    int file_count = sizeof(default_files) / sizeof(default_files[0]);
+
+    if (argc > 1) {
+        iterations = atoi(argv[1]);
+        if (iterations <= 0) {
+            fprintf(stderr, "usage: %s [iterations] [file.obj ...]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (argc > 2) {
+        files = (const char**)&argv[2];
+        file_count = argc - 2;
+    }
+
+    mat4_t model_view = mat4_mul_mat4(mat4_make_translate(0.0, 0.0, 5.0),
+        mat4_mul_mat4(mat4_make_rotation_y(0.6), mat4_make_rotation_x(0.3)));
+
+    // before any table is printed, so a missing counter is reported above it and reads n/a inside.
+    open_perf_counters();
+    for (int file_idx = 0; file_idx < file_count; ++file_idx) {
+        geometry_lod_t layouts[LAYOUT_COUNT];
+        memset(layouts, 0, sizeof(layouts));
+        load_obj_file_data(files[file_idx], &layouts[LAYOUT_ORIGINAL]);
+        int vertex_count = array_length(layouts[LAYOUT_ORIGINAL].vertices);
+        int face_count = array_length(layouts[LAYOUT_ORIGINAL].faces);
+        if (face_count == 0) {
+            printf("%s: no faces loaded.\n", files[file_idx]);
+            continue;
+        }
+
+        copy_lod(&layouts[LAYOUT_ORIGINAL], &layouts[LAYOUT_FACES]);
+        double start = bench_now_seconds();
+        optimize_vertex_cache(layouts[LAYOUT_FACES].faces, vertex_count);
+        double optimize_seconds = bench_now_seconds() - start;
+
+        copy_lod(&layouts[LAYOUT_FACES], &layouts[LAYOUT_FACES_AND_VERTICES]);
+        optimize_vertex_fetch(layouts[LAYOUT_FACES_AND_VERTICES].vertices, layouts[LAYOUT_FACES_AND_VERTICES].faces);
+
+        printf("%s: %d vertices, %d faces, cache optimization took %.2f ms\n",
+            files[file_idx], vertex_count, face_count, optimize_seconds * 1000.0);
+        printf("%-18s %8s %8s %10s", "layout", "ACMR 16", "ACMR 32", "best us");
+        for (int counter = 0; counter < PERF_COUNTER_COUNT; ++counter) {
+            printf(" %16s", get_perf_counter_name(counter));
+        }
+        printf("\n");
+
+        vec4_t* view_space_vertices = (vec4_t*)malloc(sizeof(vec4_t) * vertex_count);
+        for (int layout = 0; layout < LAYOUT_COUNT; ++layout) {
+            geometry_lod_t* lod = &layouts[layout];
+            int visible_count = 0;
+            double best_seconds = 1e30;
+
+            bench_counters_t counters;
+            bench_counters_begin();
+            for (int iteration = 0; iteration < iterations; ++iteration) {
+                double pass_start = bench_now_seconds();
+                visible_count += run_geometry_pass(lod, model_view, view_space_vertices);
+                double elapsed = bench_now_seconds() - pass_start;
+                if (elapsed < best_seconds) {
+                    best_seconds = elapsed;
+                }
+            }
+            bench_counters_end(&counters);
+
+            printf("%-18s %8.3f %8.3f %10.2f",
+                layout_names[layout],
+                get_average_cache_miss_ratio(lod->faces, vertex_count, 16),
+                get_average_cache_miss_ratio(lod->faces, vertex_count, 32),
+                best_seconds * 1e6);
+            // per pass, so the numbers compare across iteration counts.
+            for (int counter = 0; counter < PERF_COUNTER_COUNT; ++counter) {
+                if (counters.values[counter] < 0) {
+                    printf(" %16s", "n/a");
+                } else {
+                    printf(" %16.0f", (double)counters.values[counter] / iterations);
+                }
+            }
+            printf("   (%d front facing)\n", visible_count / iterations);
+
+            array_free(lod->vertices);
+            array_free(lod->faces);
+        }
+        free(view_space_vertices);
+        printf("\n");
+    }
+    return 0;
+}
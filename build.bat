@@ -1 +1,10 @@
-clang src/*.c -Wall -I include/ -L lib/ -l lib/SDL2 -std=c99 -o renderer.exe -g -O0
\ No newline at end of file
+clang src/*.c -Wall -I include/ -L lib/ -l lib/SDL2 -std=c99 -o renderer.exe -g -O0
+clang bench/bench_upng.c bench/bench.c src/perf.c src/upng.c -Wall -I src/ -std=c99 -o bench_upng.exe -O2
+clang bench/bench_vcache.c bench/bench.c src/perf.c src/vcache.c src/asset.c src/procedural.c src/bundle.c src/texture.c src/bcn.c src/job.c src/simplify.c src/array.c src/vector.c src/matrix.c src/upng.c -Wall -I include/ -I src/ -L lib/ -l lib/SDL2 -std=c99 -o bench_vcache.exe -O2
+clang tools/pack_cells.c src/vcache.c src/asset.c src/procedural.c src/bundle.c src/texture.c src/bcn.c src/job.c src/simplify.c src/array.c src/vector.c src/matrix.c src/upng.c -Wall -I include/ -I src/ -L lib/ -l lib/SDL2 -std=c99 -o pack_cells.exe -O2
+clang tools/pack_vtex.c src/upng.c -Wall -I include/ -I src/ -std=c99 -o pack_vtex.exe -O2
+clang bench/bench_bcn.c bench/bench.c src/perf.c src/bcn.c src/upng.c -Wall -I include/ -I src/ -L lib/ -l lib/SDL2 -std=c99 -o bench_bcn.exe -O2
+clang tools/pack_bundle.c src/vcache.c src/asset.c src/procedural.c src/bundle.c src/texture.c src/bcn.c src/job.c src/simplify.c src/array.c src/vector.c src/matrix.c src/upng.c -Wall -I include/ -I src/ -L lib/ -l lib/SDL2 -std=c99 -o pack_bundle.exe -O2
+clang src/*.c -D RENDERER_HEADLESS -Wall -I include/ -L lib/ -l lib/SDL2 -std=c99 -o renderer_headless.exe -O2
+clang src/*.c -D RENDERER_PROFILE -Wall -I include/ -L lib/ -l lib/SDL2 -std=c99 -o renderer_profile.exe -O2
+clang bench/bench_kernels.c bench/bench.c src/perf.c src/array.c src/asset.c src/procedural.c src/bcn.c src/bundle.c src/clipping.c src/display.c src/job.c src/light.c src/matrix.c src/present.c src/simplify.c src/stats.c src/texture.c src/triangle.c src/upng.c src/vcache.c src/vector.c src/vtexture.c -Wall -I include/ -I src/ -L lib/ -l lib/SDL2 -std=c99 -o bench_kernels.exe -O2
\ No newline at end of file
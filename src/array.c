@@ -33,8 +33,25 @@ int array_length(void* array) {
     return (array != NULL) ? ARRAY_OCCUPIED(array) : 0;
 }
 
+void array_clear(void* array) {
+    if (array != NULL) {
+        ARRAY_OCCUPIED(array) = 0;
+    }
+}
+
+void array_truncate(void* array, int length) {
+    if (array != NULL && length < ARRAY_OCCUPIED(array)) {
+        ARRAY_OCCUPIED(array) = length;
+    }
+}
+
 void array_free(void* array) {
     if (array != NULL) {
         free(ARRAY_RAW_DATA(array));
     }
-}
\ No newline at end of file
+}
+
+void array_write_header(void* header, int count) {
+    ((int*)header)[0] = count;
+    ((int*)header)[1] = count;
+}
@@ -9,6 +9,16 @@
 
 void* array_hold(void* array, int count, int item_size);
 int array_length(void* array);
+// keeps the allocation, so a per-frame array can be refilled without reallocating.
+void array_clear(void* array);
+// drops the items from length on, keeping the allocation. length must not be more than array_length().
+void array_truncate(void* array, int length);
 void array_free(void* array);
 
+// an array is two ints (capacity, then length) followed by the items. code that lays arrays out in a file
+// writes the header with array_write_header() and uses them in place once mapped (see stream.h).
+// such arrays are read only: never push to or free them.
+#define ARRAY_HEADER_SIZE (2 * (int)sizeof(int))
+void array_write_header(void* header, int count);
+
 #endif
\ No newline at end of file
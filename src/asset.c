@@ -0,0 +1,364 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "asset.h"
+#include "bundle.h"
+#include "array.h"
+#include "job.h"
+#include "simplify.h"
+#include "vcache.h"
+#include "procedural.h"
+
+// every loaded geometry, looked up by filename. textures live in the texture registry, see texture.h.
+static geometry_t** geometries = NULL;
+static bool is_vertex_cache_optimization_enabled = true;
+
+void set_vertex_cache_optimization(bool is_enabled) {
+    is_vertex_cache_optimization_enabled = is_enabled;
+}
+
+bool is_geometry_ready(geometry_t* geometry) {
+    return SDL_AtomicGet(&geometry->is_ready) != 0;
+}
+
+int get_geometry_asset_count(void) {
+    return array_length(geometries);
+}
+
+// shared by every instance, so backface culling can happen in object space without a per-instance cross product.
+static void compute_face_normals(geometry_lod_t* lod) {
+    for (int face_idx = 0; face_idx < array_length(lod->faces); ++face_idx) {
+        face_t face = lod->faces[face_idx];
+        vec3_t b_minus_a = vec3_sub(lod->vertices[face.b], lod->vertices[face.a]);
+        vec3_t c_minus_a = vec3_sub(lod->vertices[face.c], lod->vertices[face.a]);
+        array_push(lod->face_normals, vec3_cross(b_minus_a, c_minus_a));
+    }
+}
+
+// OBJ exporters write faces in modelling order. reordering them keeps the vertices of consecutive faces close together,
+// and renumbering the vertices in that order lets the face loop walk the transformed vertices forward.
+static void optimize_lod_order(geometry_lod_t* lod) {
+    if (!is_vertex_cache_optimization_enabled) {
+        return;
+    }
+    optimize_vertex_cache(lod->faces, array_length(lod->vertices));
+    optimize_vertex_fetch(lod->vertices, lod->faces);
+}
+
+static void compute_bounds(geometry_t* geometry) {
+    vec3_t* vertices = geometry->lods[0].vertices;
+    int vertex_count = array_length(vertices);
+    if (vertex_count == 0) {
+        return;
+    }
+
+    vec3_t min = vertices[0];
+    vec3_t max = vertices[0];
+    for (int vertex_idx = 1; vertex_idx < vertex_count; ++vertex_idx) {
+        vec3_t v = vertices[vertex_idx];
+        min = vec3_new(v.x < min.x ? v.x : min.x, v.y < min.y ? v.y : min.y, v.z < min.z ? v.z : min.z);
+        max = vec3_new(v.x > max.x ? v.x : max.x, v.y > max.y ? v.y : max.y, v.z > max.z ? v.z : max.z);
+    }
+    geometry->bounds_center = vec3_mul(vec3_add(min, max), 0.5);
+    geometry->bounds_radius = 0.0;
+    for (int vertex_idx = 0; vertex_idx < vertex_count; ++vertex_idx) {
+        float distance = vec3_length(vec3_sub(vertices[vertex_idx], geometry->bounds_center));
+        if (distance > geometry->bounds_radius) {
+            geometry->bounds_radius = distance;
+        }
+    }
+}
+
+// every level is simplified from the previous one. the chain stops early once locked seams keep a level from shrinking.
+static void generate_lods(geometry_t* geometry) {
+    geometry->lod_count = 1;
+    while (geometry->lod_count < MAX_GEOMETRY_LOD_COUNT) {
+        geometry_lod_t* previous = &geometry->lods[geometry->lod_count - 1];
+        geometry_lod_t* lod = &geometry->lods[geometry->lod_count];
+        int previous_face_count = array_length(previous->faces);
+
+        int face_count = simplify_mesh(previous->vertices, previous->faces, previous_face_count / 2, &lod->vertices, &lod->faces);
+        if (face_count == 0 || face_count > previous_face_count * 0.9) {
+            array_free(lod->vertices);
+            array_free(lod->faces);
+            lod->vertices = NULL;
+            lod->faces = NULL;
+            break;
+        }
+        optimize_lod_order(lod);
+        compute_face_normals(lod);
+        geometry->lod_count += 1;
+    }
+}
+
+void build_geometry(const char* filename, geometry_t* geometry) {
+    if (is_procedural_geometry_filename(filename)) {
+        build_procedural_geometry(filename, &geometry->lods[0]);
+        compute_face_normals(&geometry->lods[0]);
+        compute_bounds(geometry);
+        geometry->lod_count = 1;
+        return;
+    }
+    load_obj_file_data(filename, &geometry->lods[0]);
+    optimize_lod_order(&geometry->lods[0]);
+    compute_face_normals(&geometry->lods[0]);
+    compute_bounds(geometry);
+    generate_lods(geometry);
+}
+
+// parse into a local geometry and only then publish the arrays, so the render loop never sees a half-parsed mesh.
+static void load_geometry_job(void* data) {
+    geometry_t* geometry = (geometry_t*)data;
+    geometry_t parsed = { 0 };
+    build_geometry(geometry->filename, &parsed);
+
+    memcpy(geometry->lods, parsed.lods, sizeof(parsed.lods));
+    geometry->lod_count = parsed.lod_count;
+    geometry->bounds_center = parsed.bounds_center;
+    geometry->bounds_radius = parsed.bounds_radius;
+    SDL_AtomicSet(&geometry->is_ready, 1);
+}
+
+// the length of the array at offset, or -1 if its header or its items run past size.
+static int get_data_array_length(const unsigned char* data, uint64_t size, uint32_t offset, size_t item_size) {
+    if (offset % sizeof(int) != 0 || (uint64_t)offset + ARRAY_HEADER_SIZE > size) {
+        return -1;
+    }
+    int length = array_length((void*)(data + offset + ARRAY_HEADER_SIZE));
+    if (length < 0 || (uint64_t)offset + ARRAY_HEADER_SIZE + (uint64_t)length * item_size > size) {
+        return -1;
+    }
+    return length;
+}
+
+bool is_geometry_lod_data_valid(const unsigned char* data, uint64_t size, uint32_t vertices_offset, uint32_t faces_offset, uint32_t face_normals_offset) {
+    int vertex_count = get_data_array_length(data, size, vertices_offset, sizeof(vec3_t));
+    int face_count = get_data_array_length(data, size, faces_offset, sizeof(face_t));
+    int face_normal_count = get_data_array_length(data, size, face_normals_offset, sizeof(vec3_t));
+    if (vertex_count < 0 || face_count < 0 || face_normal_count != face_count) {
+        return false;
+    }
+    const face_t* faces = (const face_t*)(data + faces_offset + ARRAY_HEADER_SIZE);
+    for (int face_idx = 0; face_idx < face_count; ++face_idx) {
+        const face_t* face = &faces[face_idx];
+        if (face->a < 0 || face->a >= vertex_count || face->b < 0 || face->b >= vertex_count ||
+            face->c < 0 || face->c >= vertex_count) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int select_geometry_lod(geometry_t* geometry, int current_lod, float screen_radius) {
+    const float lod_screen_radii[] = GEOMETRY_LOD_SCREEN_RADII;
+    int lod = current_lod < geometry->lod_count ? current_lod : geometry->lod_count - 1;
+
+    while (lod > 0 && screen_radius > lod_screen_radii[lod - 1] * (1.0f + GEOMETRY_LOD_HYSTERESIS)) {
+        lod -= 1;
+    }
+    while (lod < geometry->lod_count - 1 && screen_radius < lod_screen_radii[lod] * (1.0f - GEOMETRY_LOD_HYSTERESIS)) {
+        lod += 1;
+    }
+    return lod;
+}
+
+static void load_texture_job(void* data) {
+    load_texture_file((texture_t*)data);
+}
+
+geometry_t* load_geometry_asset(const char* filename) {
+    for (int geometry_idx = 0; geometry_idx < array_length(geometries); ++geometry_idx) {
+        if (strcmp(geometries[geometry_idx]->filename, filename) == 0) {
+            geometries[geometry_idx]->reference_count += 1;
+            return geometries[geometry_idx];
+        }
+    }
+
+    geometry_t* geometry = (geometry_t*)calloc(1, sizeof(geometry_t));
+    if (geometry == NULL) {
+        return NULL;
+    }
+    snprintf(geometry->filename, sizeof(geometry->filename), "%s", filename);
+    SDL_AtomicSet(&geometry->is_ready, 0);
+    geometry->reference_count = 1;
+    array_push(geometries, geometry);
+
+    const bundle_entry_t* entry = find_bundle_entry(filename, BUNDLE_ENTRY_GEOMETRY);
+    if (entry != NULL) {
+        const unsigned char* entry_data = get_bundle_entry_data(entry);
+        for (uint32_t lod_idx = 0; lod_idx < entry->lod_count; ++lod_idx) {
+            geometry_lod_t* lod = &geometry->lods[lod_idx];
+            lod->vertices = (vec3_t*)(entry_data + entry->vertices_offsets[lod_idx] + ARRAY_HEADER_SIZE);
+            lod->faces = (face_t*)(entry_data + entry->faces_offsets[lod_idx] + ARRAY_HEADER_SIZE);
+            lod->face_normals = (vec3_t*)(entry_data + entry->face_normals_offsets[lod_idx] + ARRAY_HEADER_SIZE);
+        }
+        geometry->lod_count = (int)entry->lod_count;
+        geometry->bounds_center = entry->bounds_center;
+        geometry->bounds_radius = entry->bounds_radius;
+        geometry->is_mapped = true;
+        SDL_AtomicSet(&geometry->is_ready, 1);
+        return geometry;
+    }
+
+    submit_job(load_geometry_job, geometry);
+    return geometry;
+}
+
+texture_t* load_texture_asset(const char* filename) {
+    texture_t* texture = find_texture(filename);
+    if (texture != NULL) {
+        texture->reference_count += 1;
+        return texture;
+    }
+
+    texture = create_texture(filename);
+    if (texture == NULL) {
+        return NULL;
+    }
+    texture->reference_count = 1;
+
+    // the PNG bytes are used where they are mapped, there is nothing left to read.
+    const bundle_entry_t* entry = find_bundle_entry(filename, BUNDLE_ENTRY_TEXTURE);
+    if (entry != NULL) {
+        texture->png_data = (unsigned char*)get_bundle_entry_data(entry);
+        texture->png_size = (unsigned long)entry->size;
+        texture->is_png_data_mapped = true;
+        SDL_AtomicSet(&texture->state, TEXTURE_STATE_COMPRESSED);
+        return texture;
+    }
+
+    submit_job(load_texture_job, texture);
+    return texture;
+}
+
+static void free_geometry_data(geometry_t* geometry) {
+    for (int lod_idx = 0; lod_idx < geometry->lod_count && !geometry->is_mapped; ++lod_idx) {
+        array_free(geometry->lods[lod_idx].face_normals);
+        array_free(geometry->lods[lod_idx].faces);
+        array_free(geometry->lods[lod_idx].vertices);
+    }
+    free(geometry);
+}
+
+void release_geometry_asset(geometry_t* geometry) {
+    if (geometry == NULL || --geometry->reference_count > 0) {
+        return;
+    }
+
+    // the parse job may still be writing into it.
+    if (!is_geometry_ready(geometry)) {
+        wait_for_jobs();
+    }
+
+    int geometry_count = array_length(geometries);
+    for (int geometry_idx = 0; geometry_idx < geometry_count; ++geometry_idx) {
+        if (geometries[geometry_idx] == geometry) {
+            // order does not matter, move the last geometry into the hole.
+            geometries[geometry_idx] = geometries[geometry_count - 1];
+            array_truncate(geometries, geometry_count - 1);
+            break;
+        }
+    }
+    free_geometry_data(geometry);
+}
+
+void release_texture_asset(texture_t* texture) {
+    if (texture == NULL || --texture->reference_count > 0) {
+        return;
+    }
+
+    // a file read or a decode may still be in flight.
+    int state = SDL_AtomicGet(&texture->state);
+    if (state == TEXTURE_STATE_UNLOADED || state == TEXTURE_STATE_DECODING) {
+        wait_for_jobs();
+    }
+    destroy_texture(texture);
+}
+
+void free_assets(void) {
+    // make sure no job is still writing into an asset that is about to be freed.
+    wait_for_jobs();
+
+    for (int geometry_idx = 0; geometry_idx < array_length(geometries); ++geometry_idx) {
+        free_geometry_data(geometries[geometry_idx]);
+    }
+    array_free(geometries);
+    geometries = NULL;
+
+    free_textures();
+}
+
+void load_obj_file_data(const char* obj_filename, geometry_lod_t* geometry) {
+    // todo: read the contents of the obj file
+    // and load the vertices and faces in our geometry.vertices and geometry.faces
+    FILE *file;
+
+    // Open the file for reading
+    file = fopen(obj_filename, "r");
+
+    // Check if the file was opened successfully
+    if (file == NULL) {
+        printf("Unable to open the file %s. \n", obj_filename);
+        return;
+    }
+
+    // Buffer to store each line
+    char line[1024]; // You can adjust the size as needed
+    tex2_t* texture_coordinates = NULL;
+
+    // Read the file line by line
+    while (fgets(line, sizeof(line), file) != NULL) {
+        
+        // Variables to store parsed data
+        vec3_t position;
+        face_t face;
+        int vertex_indices[3];
+        int texture_indices[3];
+        int normal_indices[3];
+        tex2_t vertex_uv;
+
+        // Use sscanf to parse the line
+        if (sscanf(line, "v %f %f %f", &position.x, &position.y, &position.z) == 3) {
+            array_push(geometry->vertices, position);
+
+        } else if (sscanf(line, "vt %f %f", &vertex_uv.u,  &vertex_uv.v) == 2) {
+            array_push(texture_coordinates, vertex_uv);
+        }else if (sscanf(line, "f %d/%d/%d %d/%d/%d %d/%d/%d", 
+            &vertex_indices[0],
+            &texture_indices[0],
+            &normal_indices[0],
+            &vertex_indices[1],
+            &texture_indices[1],
+            &normal_indices[1],
+            &vertex_indices[2],
+            &texture_indices[2],
+            &normal_indices[2]) == 9){
+           
+            // printf("a0: %d, b0: %d, c0: %d\n", face_0.a, face_0.b, face_0.c);
+            // printf("a1: %d, b1: %d, c2: %d\n", face_1.a, face_1.b, face_1.c);
+            // printf("a2: %d, b2: %d, c2: %d\n", face_2.a, face_2.b, face_2.c);
+
+
+            //@NOTE(SJM): we need to subtract all indices by 1 since we start at 1. 
+            face.a = vertex_indices[0] - 1;
+            face.b = vertex_indices[1] - 1;
+            face.c = vertex_indices[2] - 1;
+            face.a_uv = texture_coordinates[texture_indices[0] -1];
+            face.b_uv = texture_coordinates[texture_indices[1] -1];
+            face.c_uv = texture_coordinates[texture_indices[2] -1];
+
+            face.color = 0xFFFFFFFF;
+
+
+            array_push(geometry->faces, face);
+
+
+        } else {
+            // printf("Failed to parse the line: %s\n", line);
+        }
+    }
+    array_free(texture_coordinates);
+
+    // Close the file
+    fclose(file);
+}
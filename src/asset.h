@@ -0,0 +1,70 @@
+#ifndef ASSET_H
+#define ASSET_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <SDL2/SDL_atomic.h>
+#include "vector.h"
+#include "triangle.h"
+#include "texture.h"
+
+#define MAX_ASSET_FILENAME_LENGTH 256
+
+// levels of detail are generated at load time, every level has about half the faces of the previous one.
+#define MAX_GEOMETRY_LOD_COUNT 4
+// projected bounding sphere radius in pixels below which level i + 1 takes over from level i.
+#define GEOMETRY_LOD_SCREEN_RADII { 120.0f, 60.0f, 30.0f }
+// a level only changes once the radius is this far past its threshold, so a mesh sitting at a threshold does not pop.
+#define GEOMETRY_LOD_HYSTERESIS 0.15f
+
+typedef struct {
+    vec3_t* vertices; // dynamic array of vertices
+    face_t* faces; // dynamic array of faces
+    vec3_t* face_normals; // object space, one per face. not normalized, only the side of the plane matters.
+} geometry_lod_t;
+
+// mesh geometry shared by every scene object that loads the same OBJ file.
+typedef struct {
+    char filename[MAX_ASSET_FILENAME_LENGTH];
+    geometry_lod_t lods[MAX_GEOMETRY_LOD_COUNT]; // lods[0] is the mesh as loaded.
+    int lod_count;
+    vec3_t bounds_center; // object space bounding sphere of lods[0].
+    float bounds_radius;
+    SDL_atomic_t is_ready; // set by the loader once all levels are filled in.
+    bool is_mapped; // the levels point into the asset bundle (see bundle.h) and are read only.
+    int reference_count;
+} geometry_t;
+
+// the asset manager hands out reference counted handles keyed by file path:
+// loading a path that is already loaded only bumps its reference count, the file is parsed / decoded once.
+// the OBJ parse and the PNG read run on the job system, the handle is returned right away.
+// assets in the open asset bundle are used in place instead, and are ready right away.
+// all of these must be called from the main thread.
+geometry_t* load_geometry_asset(const char* filename);
+texture_t* load_texture_asset(const char* filename);
+void release_geometry_asset(geometry_t* geometry);
+void release_texture_asset(texture_t* texture);
+
+bool is_geometry_ready(geometry_t* geometry);
+// picks the level for a projected bounding sphere radius (in pixels), starting from the level used last frame.
+int select_geometry_lod(geometry_t* geometry, int current_lod, float screen_radius);
+int get_geometry_asset_count(void);
+// reorder faces and vertices of every level for locality at load time (on by default).
+// only affects geometry loaded after the call.
+void set_vertex_cache_optimization(bool is_enabled);
+
+// parses an OBJ file into the geometry arrays. safe to call from a job.
+void load_obj_file_data(const char* filename, geometry_lod_t* geometry);
+// everything the loader does to an OBJ file: parse, reorder, normals, bounds and levels of detail.
+// fills in lods, lod_count and the bounds of geometry. safe to call from a job.
+void build_geometry(const char* filename, geometry_t* geometry);
+
+// a level laid out in a file as three arrays (see array_write_header()) at the given offsets from data. true if every
+// array lies inside the size bytes at an int aligned offset, there is a normal per face and every face indexes a vertex
+// of the level. the pipeline indexes the arrays without checks, so levels mapped from a file are checked first.
+bool is_geometry_lod_data_valid(const unsigned char* data, uint64_t size, uint32_t vertices_offset, uint32_t faces_offset, uint32_t face_normals_offset);
+
+// frees whatever is still loaded, regardless of reference counts.
+void free_assets(void);
+
+#endif
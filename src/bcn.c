@@ -0,0 +1,273 @@
+#include <stdlib.h>
+#include <SDL2/SDL_atomic.h>
+#include "bcn.h"
+#include "job.h"
+
+typedef struct {
+    uint32_t texture_id; // 0 is never handed out, so a zeroed entry is empty.
+    int block_idx;
+    uint32_t texels[16];
+} cached_block_t;
+
+static THREAD_LOCAL cached_block_t block_cache[BLOCK_CACHE_SIZE];
+static SDL_atomic_t next_texture_id;
+
+int get_block_size(int format) {
+    return format == BLOCK_FORMAT_BC3 ? 16 : 8;
+}
+
+const char* get_block_format_name(int format) {
+    switch (format) {
+        case BLOCK_FORMAT_BC1: return "BC1";
+        case BLOCK_FORMAT_BC3: return "BC3";
+        default: return "RGBA8";
+    }
+}
+
+static int get_channel(uint32_t texel, int channel) {
+    return (texel >> (channel * 8)) & 0xFF;
+}
+
+// the middle channel (green in RGBA) gets the extra bit.
+static uint16_t pack_565(int c0, int c1, int c2) {
+    return (uint16_t)(((c0 >> 3) << 11) | ((c1 >> 2) << 5) | (c2 >> 3));
+}
+
+static uint32_t unpack_565(uint16_t packed) {
+    uint32_t c0 = (packed >> 11) & 0x1F;
+    uint32_t c1 = (packed >> 5) & 0x3F;
+    uint32_t c2 = packed & 0x1F;
+    c0 = (c0 << 3) | (c0 >> 2);
+    c1 = (c1 << 2) | (c1 >> 4);
+    c2 = (c2 << 3) | (c2 >> 2);
+    return c0 | (c1 << 8) | (c2 << 16);
+}
+
+// (a * weight_a + b * weight_b) / divisor for the three color channels.
+static uint32_t blend_color(uint32_t a, uint32_t b, int weight_a, int weight_b, int divisor) {
+    uint32_t result = 0;
+    for (int channel = 0; channel < 3; ++channel) {
+        int value = (get_channel(a, channel) * weight_a + get_channel(b, channel) * weight_b) / divisor;
+        result |= (uint32_t)value << (channel * 8);
+    }
+    return result;
+}
+
+static int get_color_distance(uint32_t a, uint32_t b) {
+    int distance = 0;
+    for (int channel = 0; channel < 3; ++channel) {
+        int delta = get_channel(a, channel) - get_channel(b, channel);
+        distance += delta * delta;
+    }
+    return distance;
+}
+
+// endpoints from the bounding box of the block colors, pulled in a little so outliers do not stretch the palette.
+// every texel then takes the nearest of the four palette colors.
+static void encode_color_block(const uint32_t texels[16], uint8_t* block) {
+    int min[3] = { 255, 255, 255 };
+    int max[3] = { 0, 0, 0 };
+    for (int texel_idx = 0; texel_idx < 16; ++texel_idx) {
+        for (int channel = 0; channel < 3; ++channel) {
+            int value = get_channel(texels[texel_idx], channel);
+            min[channel] = value < min[channel] ? value : min[channel];
+            max[channel] = value > max[channel] ? value : max[channel];
+        }
+    }
+    for (int channel = 0; channel < 3; ++channel) {
+        int inset = (max[channel] - min[channel]) >> 4;
+        min[channel] += inset;
+        max[channel] -= inset;
+    }
+
+    // packing is monotonic per channel, so color_0 >= color_1 and the block decodes in four color mode.
+    uint16_t color_0 = pack_565(max[0], max[1], max[2]);
+    uint16_t color_1 = pack_565(min[0], min[1], min[2]);
+    uint32_t indices = 0;
+    if (color_0 != color_1) {
+        uint32_t palette[4];
+        palette[0] = unpack_565(color_0);
+        palette[1] = unpack_565(color_1);
+        palette[2] = blend_color(palette[0], palette[1], 2, 1, 3);
+        palette[3] = blend_color(palette[0], palette[1], 1, 2, 3);
+        for (int texel_idx = 0; texel_idx < 16; ++texel_idx) {
+            int best_index = 0;
+            int best_distance = get_color_distance(texels[texel_idx], palette[0]);
+            for (int index = 1; index < 4; ++index) {
+                int distance = get_color_distance(texels[texel_idx], palette[index]);
+                if (distance < best_distance) {
+                    best_distance = distance;
+                    best_index = index;
+                }
+            }
+            indices |= (uint32_t)best_index << (texel_idx * 2);
+        }
+    }
+
+    block[0] = color_0 & 0xFF;
+    block[1] = color_0 >> 8;
+    block[2] = color_1 & 0xFF;
+    block[3] = color_1 >> 8;
+    for (int byte_idx = 0; byte_idx < 4; ++byte_idx) {
+        block[4 + byte_idx] = (indices >> (byte_idx * 8)) & 0xFF;
+    }
+}
+
+static void get_alpha_palette(int alpha_0, int alpha_1, int palette[8]) {
+    palette[0] = alpha_0;
+    palette[1] = alpha_1;
+    if (alpha_0 > alpha_1) {
+        for (int index = 2; index < 8; ++index) {
+            palette[index] = ((8 - index) * alpha_0 + (index - 1) * alpha_1) / 7;
+        }
+    } else {
+        for (int index = 2; index < 6; ++index) {
+            palette[index] = ((6 - index) * alpha_0 + (index - 1) * alpha_1) / 5;
+        }
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+}
+
+static void encode_alpha_block(const uint32_t texels[16], uint8_t* block) {
+    int min = 255;
+    int max = 0;
+    for (int texel_idx = 0; texel_idx < 16; ++texel_idx) {
+        int alpha = texels[texel_idx] >> 24;
+        min = alpha < min ? alpha : min;
+        max = alpha > max ? alpha : max;
+    }
+
+    int palette[8];
+    get_alpha_palette(max, min, palette);
+    uint64_t indices = 0;
+    for (int texel_idx = 0; texel_idx < 16 && max != min; ++texel_idx) {
+        int alpha = texels[texel_idx] >> 24;
+        int best_index = 0;
+        for (int index = 1; index < 8; ++index) {
+            if (abs(palette[index] - alpha) < abs(palette[best_index] - alpha)) {
+                best_index = index;
+            }
+        }
+        indices |= (uint64_t)best_index << (texel_idx * 3);
+    }
+
+    block[0] = (uint8_t)max;
+    block[1] = (uint8_t)min;
+    for (int byte_idx = 0; byte_idx < 6; ++byte_idx) {
+        block[2 + byte_idx] = (indices >> (byte_idx * 8)) & 0xFF;
+    }
+}
+
+static void decode_color_block(const uint8_t* block, int is_four_color_only, uint32_t texels[16]) {
+    uint16_t color_0 = (uint16_t)(block[0] | (block[1] << 8));
+    uint16_t color_1 = (uint16_t)(block[2] | (block[3] << 8));
+    uint32_t indices = block[4] | (block[5] << 8) | (block[6] << 16) | ((uint32_t)block[7] << 24);
+
+    uint32_t palette[4];
+    palette[0] = unpack_565(color_0) | 0xFF000000;
+    palette[1] = unpack_565(color_1) | 0xFF000000;
+    if (color_0 > color_1 || is_four_color_only) {
+        palette[2] = blend_color(palette[0], palette[1], 2, 1, 3) | 0xFF000000;
+        palette[3] = blend_color(palette[0], palette[1], 1, 2, 3) | 0xFF000000;
+    } else {
+        palette[2] = blend_color(palette[0], palette[1], 1, 1, 2) | 0xFF000000;
+        palette[3] = 0; // transparent black
+    }
+
+    for (int texel_idx = 0; texel_idx < 16; ++texel_idx) {
+        texels[texel_idx] = palette[(indices >> (texel_idx * 2)) & 3];
+    }
+}
+
+static void decode_alpha_block(const uint8_t* block, uint32_t texels[16]) {
+    int palette[8];
+    get_alpha_palette(block[0], block[1], palette);
+    uint64_t indices = 0;
+    for (int byte_idx = 0; byte_idx < 6; ++byte_idx) {
+        indices |= (uint64_t)block[2 + byte_idx] << (byte_idx * 8);
+    }
+    for (int texel_idx = 0; texel_idx < 16; ++texel_idx) {
+        uint32_t alpha = (uint32_t)palette[(indices >> (texel_idx * 3)) & 7];
+        texels[texel_idx] = (texels[texel_idx] & 0x00FFFFFF) | (alpha << 24);
+    }
+}
+
+static void decode_block(const compressed_texture_t* texture, int block_idx, uint32_t texels[16]) {
+    const uint8_t* block = &texture->blocks[(size_t)block_idx * get_block_size(texture->format)];
+    if (texture->format == BLOCK_FORMAT_BC3) {
+        decode_color_block(block + 8, 1, texels);
+        decode_alpha_block(block, texels);
+    } else {
+        decode_color_block(block, 0, texels);
+    }
+}
+
+compressed_texture_t* compress_texture(const uint32_t* texels, int width, int height, int format) {
+    if (format != BLOCK_FORMAT_BC1 && format != BLOCK_FORMAT_BC3) {
+        return NULL;
+    }
+    compressed_texture_t* texture = (compressed_texture_t*)malloc(sizeof(compressed_texture_t));
+    texture->id = (uint32_t)SDL_AtomicAdd(&next_texture_id, 1) + 1;
+    texture->format = format;
+    texture->width = width;
+    texture->height = height;
+    texture->blocks_x = (width + 3) / 4;
+    texture->blocks_y = (height + 3) / 4;
+    int block_size = get_block_size(format);
+    texture->blocks = (uint8_t*)malloc((size_t)texture->blocks_x * texture->blocks_y * block_size);
+
+    uint8_t* block = texture->blocks;
+    for (int block_y = 0; block_y < texture->blocks_y; ++block_y) {
+        for (int block_x = 0; block_x < texture->blocks_x; ++block_x) {
+            // blocks hanging over the edge repeat the last row / column.
+            uint32_t block_texels[16];
+            for (int y = 0; y < 4; ++y) {
+                int source_y = block_y * 4 + y < height ? block_y * 4 + y : height - 1;
+                for (int x = 0; x < 4; ++x) {
+                    int source_x = block_x * 4 + x < width ? block_x * 4 + x : width - 1;
+                    block_texels[y * 4 + x] = texels[source_y * width + source_x];
+                }
+            }
+            if (format == BLOCK_FORMAT_BC3) {
+                encode_alpha_block(block_texels, block);
+                encode_color_block(block_texels, block + 8);
+            } else {
+                encode_color_block(block_texels, block);
+            }
+            block += block_size;
+        }
+    }
+    return texture;
+}
+
+void free_compressed_texture(compressed_texture_t* texture) {
+    if (texture == NULL) {
+        return;
+    }
+    free(texture->blocks);
+    free(texture);
+}
+
+size_t get_compressed_texture_size(const compressed_texture_t* texture) {
+    return (size_t)texture->blocks_x * texture->blocks_y * get_block_size(texture->format);
+}
+
+uint32_t sample_compressed_texture(const compressed_texture_t* texture, int tex_x, int tex_y) {
+    int block_x = tex_x >> 2;
+    int block_y = tex_y >> 2;
+    int block_idx = block_y * texture->blocks_x + block_x;
+    cached_block_t* entry = &block_cache[(block_x % BLOCK_CACHE_COLUMNS) + (block_y % BLOCK_CACHE_ROWS) * BLOCK_CACHE_COLUMNS];
+    if (entry->texture_id != texture->id || entry->block_idx != block_idx) {
+        decode_block(texture, block_idx, entry->texels);
+        entry->texture_id = texture->id;
+        entry->block_idx = block_idx;
+    }
+    return entry->texels[((tex_y & 3) << 2) | (tex_x & 3)];
+}
+
+uint32_t sample_compressed_texture_uncached(const compressed_texture_t* texture, int tex_x, int tex_y) {
+    uint32_t texels[16];
+    decode_block(texture, (tex_y >> 2) * texture->blocks_x + (tex_x >> 2), texels);
+    return texels[((tex_y & 3) << 2) | (tex_x & 3)];
+}
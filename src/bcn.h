@@ -0,0 +1,46 @@
+#ifndef BCN_H
+#define BCN_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// block compressed textures: every 4x4 texel block is stored as two endpoint colors and an index per texel,
+// laid out like BC1 (8 bytes per block, opaque) and BC3 (16 bytes per block, BC1 color plus interpolated alpha).
+// texels are decoded a block at a time in the sampler, through a small cache of decoded blocks per thread.
+
+enum BLOCK_FORMAT {
+    BLOCK_FORMAT_NONE, // plain 32 bit texels, see draw_texel().
+    BLOCK_FORMAT_BC1,
+    BLOCK_FORMAT_BC3,
+    BLOCK_FORMAT_COUNT
+};
+
+// decoded blocks kept per thread, indexed by the low bits of the block coordinates: a window of 16x4 blocks
+// (64x16 texels) never collides, so a span keeps its blocks until the scanlines below it reuse them.
+#define BLOCK_CACHE_COLUMNS 16
+#define BLOCK_CACHE_ROWS 4
+#define BLOCK_CACHE_SIZE (BLOCK_CACHE_COLUMNS * BLOCK_CACHE_ROWS)
+
+typedef struct {
+    uint32_t id; // unique per compression, so a block cache entry can never outlive its texture.
+    int format; // one of BLOCK_FORMAT, never BLOCK_FORMAT_NONE.
+    int width;
+    int height;
+    int blocks_x;
+    int blocks_y;
+    uint8_t* blocks; // row by row.
+} compressed_texture_t;
+
+// texels are 32 bit, with the alpha in the top byte, as upng decodes RGBA. BC1 stores no alpha and decodes opaque.
+compressed_texture_t* compress_texture(const uint32_t* texels, int width, int height, int format);
+void free_compressed_texture(compressed_texture_t* texture);
+size_t get_compressed_texture_size(const compressed_texture_t* texture);
+int get_block_size(int format);
+const char* get_block_format_name(int format);
+
+// tex_x and tex_y must be inside the texture.
+uint32_t sample_compressed_texture(const compressed_texture_t* texture, int tex_x, int tex_y);
+// the same texel, decoding its block every time. for measuring what the block cache saves.
+uint32_t sample_compressed_texture_uncached(const compressed_texture_t* texture, int tex_x, int tex_y);
+
+#endif
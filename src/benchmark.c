@@ -0,0 +1,452 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+#include "array.h"
+#include "benchmark.h"
+#include "perf.h"
+#include "stats.h"
+
+typedef struct {
+    float time;
+    vec3_t position;
+    float yaw;
+    float pitch;
+} camera_keyframe_t;
+
+typedef struct {
+    double stage_ms[BENCHMARK_STAGE_COUNT];
+    double frame_ms;
+} benchmark_frame_t;
+
+typedef struct {
+    double min_ms;
+    double mean_ms;
+    double median_ms;
+    double p95_ms;
+    double p99_ms;
+} benchmark_summary_t;
+
+static const char* stage_names[BENCHMARK_STAGE_COUNT] = { "update", "occlusion", "geometry", "raster", "present" };
+
+static camera_keyframe_t* keyframes = NULL;
+static benchmark_frame_t* frames = NULL;
+static benchmark_frame_t current_frame;
+static bool is_recording = false;
+static uint64_t frame_start = 0;
+static uint64_t stage_start = 0;
+// hardware counters per stage over the recorded frames, -1 for a counter that is missing. see perf.h.
+static int64_t stage_perf_totals[BENCHMARK_STAGE_COUNT][PERF_COUNTER_COUNT];
+static perf_counters_t stage_perf_start;
+static const char* perf_counter_keys[PERF_COUNTER_COUNT] = { "cycles", "instructions", "l1d_read_misses", "llc_misses", "branch_misses" };
+
+// one turn around the default scene (the planes around z = 7), a second per eighth, looking at its center.
+static void make_default_camera_path(void) {
+    const int keyframe_count = 9;
+    vec3_t center = vec3_new(0.0, -1.0, 7.0);
+    float radius = 7.0;
+    for (int keyframe_idx = 0; keyframe_idx < keyframe_count; ++keyframe_idx) {
+        float angle = 2.0 * M_PI * keyframe_idx / (keyframe_count - 1);
+        camera_keyframe_t keyframe;
+        keyframe.time = (float)keyframe_idx;
+        keyframe.position = vec3_new(center.x + sinf(angle) * radius, 0.0, center.z - cosf(angle) * radius);
+        // a yaw of a looks along (sin a, 0, cos a).
+        keyframe.yaw = -angle;
+        keyframe.pitch = 0.0;
+        array_push(keyframes, keyframe);
+    }
+}
+
+bool load_camera_path(const char* filename) {
+    array_free(keyframes);
+    keyframes = NULL;
+    if (filename == NULL) {
+        make_default_camera_path();
+        return true;
+    }
+
+    FILE* file = fopen(filename, "r");
+    if (file == NULL) {
+        printf("Unable to open the camera path %s.\n", filename);
+        return false;
+    }
+    char line[256];
+    int line_number = 0;
+    bool is_valid = true;
+    while (is_valid && fgets(line, sizeof(line), file) != NULL) {
+        line_number += 1;
+        char* comment = strchr(line, '#');
+        if (comment != NULL) {
+            *comment = '\0';
+        }
+        camera_keyframe_t keyframe;
+        int field_count = sscanf(line, "%f %f %f %f %f %f", &keyframe.time, &keyframe.position.x, &keyframe.position.y,
+            &keyframe.position.z, &keyframe.yaw, &keyframe.pitch);
+        if (field_count <= 0) {
+            continue;
+        }
+        int keyframe_count = array_length(keyframes);
+        if (field_count != 6 || (keyframe_count > 0 && keyframe.time <= keyframes[keyframe_count - 1].time)) {
+            printf("%s:%d: expected \"seconds x y z yaw pitch\", later than the keyframe before.\n", filename, line_number);
+            is_valid = false;
+            break;
+        }
+        array_push(keyframes, keyframe);
+    }
+    fclose(file);
+    if (is_valid && array_length(keyframes) == 0) {
+        printf("%s has no keyframes.\n", filename);
+        is_valid = false;
+    }
+    if (!is_valid) {
+        array_free(keyframes);
+        keyframes = NULL;
+    }
+    return is_valid;
+}
+
+void sample_camera_path(float time, vec3_t* position, float* yaw, float* pitch) {
+    int keyframe_count = array_length(keyframes);
+    if (keyframe_count == 0) {
+        return;
+    }
+    int next_idx = 0;
+    while (next_idx < keyframe_count && keyframes[next_idx].time <= time) {
+        next_idx += 1;
+    }
+    if (next_idx == 0 || next_idx == keyframe_count) {
+        camera_keyframe_t* keyframe = &keyframes[next_idx == 0 ? 0 : keyframe_count - 1];
+        *position = keyframe->position;
+        *yaw = keyframe->yaw;
+        *pitch = keyframe->pitch;
+        return;
+    }
+    camera_keyframe_t* from = &keyframes[next_idx - 1];
+    camera_keyframe_t* to = &keyframes[next_idx];
+    float t = (time - from->time) / (to->time - from->time);
+    *position = vec3_add(from->position, vec3_mul(vec3_sub(to->position, from->position), t));
+    *yaw = from->yaw + (to->yaw - from->yaw) * t;
+    *pitch = from->pitch + (to->pitch - from->pitch) * t;
+}
+
+static double get_elapsed_ms(uint64_t start, uint64_t end) {
+    return (double)(end - start) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+}
+
+void start_benchmark_recording(void) {
+    array_clear(frames);
+    memset(stage_perf_totals, 0, sizeof(stage_perf_totals));
+    is_recording = true;
+}
+
+bool is_benchmark_recording(void) {
+    return is_recording;
+}
+
+void begin_benchmark_frame(void) {
+    if (!is_recording) {
+        return;
+    }
+    memset(&current_frame, 0, sizeof(current_frame));
+    frame_start = SDL_GetPerformanceCounter();
+    stage_start = frame_start;
+    if (are_perf_counters_open()) {
+        read_perf_counters(&stage_perf_start);
+    }
+}
+
+void end_benchmark_stage(int stage) {
+    if (!is_recording) {
+        return;
+    }
+    uint64_t now = SDL_GetPerformanceCounter();
+    current_frame.stage_ms[stage] += get_elapsed_ms(stage_start, now);
+    stage_start = now;
+    // reading the counters takes a syscall each, the next stage pays for it.
+    if (are_perf_counters_open()) {
+        perf_counters_t counters;
+        read_perf_counters(&counters);
+        for (int counter = 0; counter < PERF_COUNTER_COUNT; ++counter) {
+            if (counters.values[counter] < 0 || stage_perf_start.values[counter] < 0) {
+                stage_perf_totals[stage][counter] = -1;
+            } else if (stage_perf_totals[stage][counter] >= 0) {
+                stage_perf_totals[stage][counter] += counters.values[counter] - stage_perf_start.values[counter];
+            }
+        }
+        stage_perf_start = counters;
+    }
+}
+
+void end_benchmark_frame(void) {
+    if (!is_recording) {
+        return;
+    }
+    current_frame.frame_ms = get_elapsed_ms(frame_start, SDL_GetPerformanceCounter());
+    array_push(frames, current_frame);
+}
+
+const char* get_benchmark_stage_name(int stage) {
+    return stage_names[stage];
+}
+
+static int compare_doubles(const void* lhs, const void* rhs) {
+    double a = *(const double*)lhs;
+    double b = *(const double*)rhs;
+    return (a > b) - (a < b);
+}
+
+// nearest rank percentiles. stage -1 is the whole frame.
+static benchmark_summary_t summarize_stage(int stage) {
+    benchmark_summary_t summary = { 0 };
+    int frame_count = array_length(frames);
+    if (frame_count == 0) {
+        return summary;
+    }
+    double* times = (double*)malloc(sizeof(double) * frame_count);
+    double sum = 0.0;
+    for (int frame_idx = 0; frame_idx < frame_count; ++frame_idx) {
+        times[frame_idx] = stage < 0 ? frames[frame_idx].frame_ms : frames[frame_idx].stage_ms[stage];
+        sum += times[frame_idx];
+    }
+    qsort(times, frame_count, sizeof(double), compare_doubles);
+    summary.min_ms = times[0];
+    summary.mean_ms = sum / frame_count;
+    summary.median_ms = times[(frame_count - 1) / 2];
+    summary.p95_ms = times[(int)ceil(0.95 * frame_count) - 1];
+    summary.p99_ms = times[(int)ceil(0.99 * frame_count) - 1];
+    free(times);
+    return summary;
+}
+
+// per recorded frame, or per unit of work of the stage (see get_stage_work_count), -1 if the counter is missing.
+static double get_stage_perf(int stage, int counter, double work_count) {
+    int64_t total = stage_perf_totals[stage][counter];
+    return total < 0 || work_count <= 0.0 ? -1.0 : (double)total / work_count;
+}
+
+static double get_stage_ipc(int stage) {
+    int64_t cycles = stage_perf_totals[stage][PERF_COUNTER_CYCLES];
+    int64_t instructions = stage_perf_totals[stage][PERF_COUNTER_INSTRUCTIONS];
+    return cycles <= 0 || instructions < 0 ? -1.0 : (double)instructions / (double)cycles;
+}
+
+// what the geometry stage and the rasterizer work through: faces and depth tested fragments. 0 for other stages.
+static double get_stage_work_count(int stage, const char** unit) {
+    int stats_frame_count = 0;
+    pipeline_stats_t stats = get_pipeline_stats_totals(&stats_frame_count);
+    if (stage == BENCHMARK_STAGE_GEOMETRY) {
+        *unit = "face";
+        return (double)stats.faces_processed;
+    }
+    if (stage == BENCHMARK_STAGE_RASTER) {
+        *unit = "fragment";
+        return (double)stats.fragments_tested;
+    }
+    *unit = NULL;
+    return 0.0;
+}
+
+static void print_benchmark_perf(void) {
+    double frame_count = array_length(frames) > 0 ? (double)array_length(frames) : 1.0;
+    printf("%-14s", "per frame");
+    for (int counter = 0; counter < PERF_COUNTER_COUNT; ++counter) {
+        printf(" %15s", get_perf_counter_name(counter));
+    }
+    printf(" %6s\n", "IPC");
+    for (int stage = 0; stage < BENCHMARK_STAGE_COUNT; ++stage) {
+        printf("%-14s", stage_names[stage]);
+        for (int counter = 0; counter < PERF_COUNTER_COUNT; ++counter) {
+            double value = get_stage_perf(stage, counter, frame_count);
+            if (value < 0.0) {
+                printf(" %15s", "-");
+            } else {
+                printf(" %15.0f", value);
+            }
+        }
+        double ipc = get_stage_ipc(stage);
+        if (ipc < 0.0) {
+            printf(" %6s\n", "-");
+        } else {
+            printf(" %6.2f\n", ipc);
+        }
+    }
+    for (int stage = 0; stage < BENCHMARK_STAGE_COUNT; ++stage) {
+        const char* unit = NULL;
+        double work_count = get_stage_work_count(stage, &unit);
+        if (unit == NULL) {
+            continue;
+        }
+        char label[32];
+        snprintf(label, sizeof(label), "per %s", unit);
+        printf("%-14s", label);
+        for (int counter = 0; counter < PERF_COUNTER_COUNT; ++counter) {
+            double value = get_stage_perf(stage, counter, work_count);
+            if (value < 0.0) {
+                printf(" %15s", "-");
+            } else {
+                printf(" %15.3f", value);
+            }
+        }
+        printf("\n");
+    }
+}
+
+void print_benchmark_results(void) {
+    printf("benchmark: %d frames\n", array_length(frames));
+    printf("%-10s %9s %9s %9s %9s %9s\n", "ms", "min", "mean", "median", "p95", "p99");
+    for (int stage = -1; stage < BENCHMARK_STAGE_COUNT; ++stage) {
+        benchmark_summary_t summary = summarize_stage(stage);
+        printf("%-10s %9.3f %9.3f %9.3f %9.3f %9.3f\n", stage < 0 ? "frame" : stage_names[stage],
+            summary.min_ms, summary.mean_ms, summary.median_ms, summary.p95_ms, summary.p99_ms);
+    }
+    if (are_perf_counters_open()) {
+        print_benchmark_perf();
+    }
+}
+
+bool write_benchmark_results(const char* prefix) {
+    char filename[1024];
+    snprintf(filename, sizeof(filename), "%s.json", prefix);
+    FILE* json = fopen(filename, "w");
+    if (json == NULL) {
+        printf("Unable to write %s.\n", filename);
+        return false;
+    }
+    int frame_count = array_length(frames);
+    fprintf(json, "{\n    \"frames\": %d,\n    \"stages\": {\n", frame_count);
+    for (int stage = -1; stage < BENCHMARK_STAGE_COUNT; ++stage) {
+        benchmark_summary_t summary = summarize_stage(stage);
+        fprintf(json, "        \"%s\": { \"min_ms\": %.4f, \"mean_ms\": %.4f, \"median_ms\": %.4f, \"p95_ms\": %.4f, \"p99_ms\": %.4f }%s\n",
+            stage < 0 ? "frame" : stage_names[stage], summary.min_ms, summary.mean_ms, summary.median_ms,
+            summary.p95_ms, summary.p99_ms, stage + 1 < BENCHMARK_STAGE_COUNT ? "," : "");
+    }
+    fprintf(json, "    },\n");
+
+    // the pipeline counters, per frame.
+    int stats_frame_count = 0;
+    pipeline_stats_t stats = get_pipeline_stats_totals(&stats_frame_count);
+    double count = stats_frame_count > 0 ? (double)stats_frame_count : 1.0;
+    fprintf(json, "    \"counters\": {\n");
+    fprintf(json, "        \"instances_processed\": %.1f,\n", stats.instances_processed / count);
+    fprintf(json, "        \"instances_occluded\": %.1f,\n", stats.instances_occluded / count);
+    fprintf(json, "        \"faces_processed\": %.1f,\n", stats.faces_processed / count);
+    fprintf(json, "        \"faces_backface_culled\": %.1f,\n", stats.faces_backface_culled / count);
+    fprintf(json, "        \"faces_frustum_rejected\": %.1f,\n", stats.faces_frustum_rejected / count);
+    fprintf(json, "        \"faces_clipped\": %.1f,\n", stats.faces_clipped / count);
+    fprintf(json, "        \"triangles_emitted\": %.1f,\n", stats.triangles_emitted / count);
+    fprintf(json, "        \"fragments_tested\": %.1f,\n", stats.fragments_tested / count);
+    fprintf(json, "        \"fragments_written\": %.1f,\n", stats.fragments_written / count);
+    fprintf(json, "        \"pixels_covered\": %.1f,\n", stats.pixels_covered / count);
+    fprintf(json, "        \"average_overdraw\": %.3f\n", get_average_overdraw(&stats));
+    fprintf(json, "    },\n");
+
+    // the hardware counters per stage, per frame and per unit of work. -1 for a missing counter.
+    if (are_perf_counters_open()) {
+        fprintf(json, "    \"perf\": {\n");
+        for (int stage = 0; stage < BENCHMARK_STAGE_COUNT; ++stage) {
+            fprintf(json, "        \"%s\": {", stage_names[stage]);
+            for (int counter = 0; counter < PERF_COUNTER_COUNT; ++counter) {
+                fprintf(json, " \"%s\": %.1f,", perf_counter_keys[counter], get_stage_perf(stage, counter, count));
+            }
+            const char* unit = NULL;
+            double work_count = get_stage_work_count(stage, &unit);
+            if (unit != NULL) {
+                for (int counter = 0; counter < PERF_COUNTER_COUNT; ++counter) {
+                    fprintf(json, " \"%s_per_%s\": %.4f,", perf_counter_keys[counter], unit, get_stage_perf(stage, counter, work_count));
+                }
+            }
+            fprintf(json, " \"ipc\": %.3f }%s\n", get_stage_ipc(stage), stage + 1 < BENCHMARK_STAGE_COUNT ? "," : "");
+        }
+        fprintf(json, "    },\n");
+    }
+    fprintf(json, "    \"frame_ms\": [");
+    for (int frame_idx = 0; frame_idx < frame_count; ++frame_idx) {
+        fprintf(json, "%s%.4f", frame_idx > 0 ? ", " : "", frames[frame_idx].frame_ms);
+    }
+    fprintf(json, "]\n}\n");
+    fclose(json);
+
+    snprintf(filename, sizeof(filename), "%s.csv", prefix);
+    FILE* csv = fopen(filename, "w");
+    if (csv == NULL) {
+        printf("Unable to write %s.\n", filename);
+        return false;
+    }
+    fprintf(csv, "stage,min_ms,mean_ms,median_ms,p95_ms,p99_ms\n");
+    for (int stage = -1; stage < BENCHMARK_STAGE_COUNT; ++stage) {
+        benchmark_summary_t summary = summarize_stage(stage);
+        fprintf(csv, "%s,%.4f,%.4f,%.4f,%.4f,%.4f\n", stage < 0 ? "frame" : stage_names[stage],
+            summary.min_ms, summary.mean_ms, summary.median_ms, summary.p95_ms, summary.p99_ms);
+    }
+    fclose(csv);
+    return true;
+}
+
+// finds "key": <number> after the "stage": { of the JSON write_benchmark_results() writes.
+static bool read_baseline_value(const char* json, const char* stage, const char* key, double* value) {
+    char pattern[64];
+    snprintf(pattern, sizeof(pattern), "\"%s\": {", stage);
+    const char* stage_start = strstr(json, pattern);
+    if (stage_start == NULL) {
+        return false;
+    }
+    const char* stage_end = strchr(stage_start, '}');
+    snprintf(pattern, sizeof(pattern), "\"%s\":", key);
+    const char* key_start = strstr(stage_start, pattern);
+    if (key_start == NULL || (stage_end != NULL && key_start > stage_end)) {
+        return false;
+    }
+    return sscanf(key_start + strlen(pattern), "%lf", value) == 1;
+}
+
+// differences below this are timer noise, whatever the percentage.
+#define REGRESSION_MIN_DELTA_MS 0.05
+
+int compare_benchmark_baseline(const char* filename, float threshold_percent) {
+    FILE* file = fopen(filename, "rb");
+    if (file == NULL) {
+        printf("Unable to open the baseline %s.\n", filename);
+        return -1;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char* json = (char*)malloc(size + 1);
+    size_t read_size = fread(json, 1, size, file);
+    json[read_size] = '\0';
+    fclose(file);
+
+    static const char* keys[2] = { "median_ms", "p95_ms" };
+    int regression_count = 0;
+    bool is_valid = true;
+    printf("against %s (%.1f%% allowed):\n", filename, threshold_percent);
+    for (int stage = -1; stage < BENCHMARK_STAGE_COUNT && is_valid; ++stage) {
+        const char* stage_name = stage < 0 ? "frame" : stage_names[stage];
+        benchmark_summary_t summary = summarize_stage(stage);
+        double current_values[2] = { summary.median_ms, summary.p95_ms };
+        for (int key_idx = 0; key_idx < 2; ++key_idx) {
+            double baseline_value = 0.0;
+            if (!read_baseline_value(json, stage_name, keys[key_idx], &baseline_value)) {
+                printf("%s has no %s %s.\n", filename, stage_name, keys[key_idx]);
+                is_valid = false;
+                break;
+            }
+            double delta = current_values[key_idx] - baseline_value;
+            bool is_regression = delta > REGRESSION_MIN_DELTA_MS && delta > baseline_value * threshold_percent / 100.0;
+            regression_count += is_regression ? 1 : 0;
+            printf("%-10s %-9s %9.3f -> %9.3f %+7.1f%%%s\n", stage_name, keys[key_idx], baseline_value, current_values[key_idx],
+                baseline_value > 0.0 ? delta / baseline_value * 100.0 : 0.0, is_regression ? "  REGRESSION" : "");
+        }
+    }
+    free(json);
+    return is_valid ? regression_count : -1;
+}
+
+void free_benchmark(void) {
+    array_free(keyframes);
+    array_free(frames);
+    keyframes = NULL;
+    frames = NULL;
+    is_recording = false;
+}
@@ -0,0 +1,44 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <stdbool.h>
+#include "vector.h"
+
+// benchmark mode: the camera follows a scripted path at a fixed timestep with the frame cap off, and the time of
+// every recorded frame and of its stages is kept. the results go out as a summary (min, mean, median, p95, p99 per
+// stage) in JSON and CSV, and can be held against the JSON of an earlier run to flag regressions.
+
+// the stages of a frame, in the order they run.
+enum BENCHMARK_STAGE {
+    BENCHMARK_STAGE_UPDATE, // texture residency, scene BVH, streaming, frustum query.
+    BENCHMARK_STAGE_OCCLUSION, // the occluder depth pass.
+    BENCHMARK_STAGE_GEOMETRY, // transform, cull, clip, project.
+    BENCHMARK_STAGE_RASTER, // clear, grid and the triangles.
+    BENCHMARK_STAGE_PRESENT,
+    BENCHMARK_STAGE_COUNT
+};
+
+// a camera path file has a keyframe per line, "seconds x y z yaw pitch", in increasing time. # starts a comment.
+// the camera moves in straight lines between them and holds the last one. NULL loads a built-in orbit around
+// the default scene.
+bool load_camera_path(const char* filename);
+void sample_camera_path(float time, vec3_t* position, float* yaw, float* pitch);
+
+// frames are only recorded between begin_benchmark_frame() and end_benchmark_frame() while recording.
+void start_benchmark_recording(void);
+bool is_benchmark_recording(void);
+void begin_benchmark_frame(void);
+// the time since the previous stage ended (or the frame began) goes to this stage.
+void end_benchmark_stage(int stage);
+void end_benchmark_frame(void);
+
+const char* get_benchmark_stage_name(int stage);
+void print_benchmark_results(void);
+// writes <prefix>.json and <prefix>.csv. the JSON also has the pipeline counters of the run per frame, see stats.h.
+bool write_benchmark_results(const char* prefix);
+// compares median and p95 of every stage with the JSON a previous run wrote. returns how many of them are slower
+// by more than threshold_percent, or -1 if the baseline can not be read.
+int compare_benchmark_baseline(const char* filename, float threshold_percent);
+void free_benchmark(void);
+
+#endif
@@ -0,0 +1,157 @@
+#if !defined(_WIN32)
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bundle.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const unsigned char* bundle_data = NULL; // the whole file, mapped read only.
+static size_t bundle_size = 0;
+static const bundle_entry_t* entries = NULL; // points into the mapping.
+static int entry_count = 0;
+
+#if defined(_WIN32)
+static HANDLE bundle_file = INVALID_HANDLE_VALUE;
+static HANDLE bundle_file_mapping = NULL;
+#endif
+
+static const unsigned char* map_bundle_file(const char* filename, size_t* size) {
+#if defined(_WIN32)
+    bundle_file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (bundle_file == INVALID_HANDLE_VALUE) {
+        return NULL;
+    }
+    LARGE_INTEGER file_size;
+    GetFileSizeEx(bundle_file, &file_size);
+    *size = (size_t)file_size.QuadPart;
+    bundle_file_mapping = CreateFileMappingA(bundle_file, NULL, PAGE_READONLY, 0, 0, NULL);
+    void* mapping = bundle_file_mapping != NULL ? MapViewOfFile(bundle_file_mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+    if (mapping == NULL) {
+        if (bundle_file_mapping != NULL) {
+            CloseHandle(bundle_file_mapping);
+            bundle_file_mapping = NULL;
+        }
+        CloseHandle(bundle_file);
+        bundle_file = INVALID_HANDLE_VALUE;
+    }
+    return (const unsigned char*)mapping;
+#else
+    // the mapping stays valid once the descriptor is closed.
+    int file = open(filename, O_RDONLY);
+    if (file < 0) {
+        return NULL;
+    }
+    struct stat file_stat;
+    void* mapping = MAP_FAILED;
+    if (fstat(file, &file_stat) == 0 && file_stat.st_size > 0) {
+        *size = (size_t)file_stat.st_size;
+        mapping = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, file, 0);
+    }
+    close(file);
+    return mapping != MAP_FAILED ? (const unsigned char*)mapping : NULL;
+#endif
+}
+
+static void unmap_bundle_file(void) {
+#if defined(_WIN32)
+    UnmapViewOfFile(bundle_data);
+    CloseHandle(bundle_file_mapping);
+    CloseHandle(bundle_file);
+    bundle_file_mapping = NULL;
+    bundle_file = INVALID_HANDLE_VALUE;
+#else
+    munmap((void*)bundle_data, bundle_size);
+#endif
+}
+
+// the renderer indexes the arrays of a level without checks, so every one of them has to be sound.
+static bool are_geometry_lods_valid(const bundle_entry_t* entry) {
+    if (entry->lod_count < 1) {
+        return false;
+    }
+    const unsigned char* entry_data = bundle_data + entry->offset;
+    for (uint32_t lod_idx = 0; lod_idx < entry->lod_count; ++lod_idx) {
+        if (!is_geometry_lod_data_valid(entry_data, entry->size, entry->vertices_offsets[lod_idx],
+                entry->faces_offsets[lod_idx], entry->face_normals_offsets[lod_idx])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool open_asset_bundle(const char* filename) {
+    close_asset_bundle();
+
+    bundle_data = map_bundle_file(filename, &bundle_size);
+    if (bundle_data == NULL) {
+        printf("Unable to map the asset bundle %s.\n", filename);
+        return false;
+    }
+
+    const bundle_file_header_t* header = (const bundle_file_header_t*)bundle_data;
+    bool is_valid = bundle_size >= sizeof(bundle_file_header_t) &&
+        memcmp(header->magic, BUNDLE_FILE_MAGIC, sizeof(header->magic)) == 0 &&
+        header->version == BUNDLE_FILE_VERSION &&
+        header->page_size == BUNDLE_PAGE_SIZE &&
+        header->vertex_size == sizeof(vec3_t) &&
+        header->face_size == sizeof(face_t) &&
+        sizeof(bundle_file_header_t) + (uint64_t)header->entry_count * sizeof(bundle_entry_t) <= bundle_size;
+    for (uint32_t entry_idx = 0; is_valid && entry_idx < header->entry_count; ++entry_idx) {
+        const bundle_entry_t* entry = (const bundle_entry_t*)(bundle_data + sizeof(bundle_file_header_t)) + entry_idx;
+        is_valid = entry->offset <= bundle_size && entry->size <= bundle_size - entry->offset &&
+            entry->lod_count <= MAX_GEOMETRY_LOD_COUNT && memchr(entry->name, '\0', sizeof(entry->name)) != NULL &&
+            (entry->type != BUNDLE_ENTRY_GEOMETRY || are_geometry_lods_valid(entry));
+    }
+    if (!is_valid) {
+        printf("%s is not an asset bundle of this build.\n", filename);
+        unmap_bundle_file();
+        bundle_data = NULL;
+        return false;
+    }
+
+    entries = (const bundle_entry_t*)(bundle_data + sizeof(bundle_file_header_t));
+    entry_count = (int)header->entry_count;
+    return true;
+}
+
+void close_asset_bundle(void) {
+    if (bundle_data == NULL) {
+        return;
+    }
+    unmap_bundle_file();
+    bundle_data = NULL;
+    bundle_size = 0;
+    entries = NULL;
+    entry_count = 0;
+}
+
+bool is_asset_bundle_filename(const char* filename) {
+    size_t length = strlen(filename);
+    return length > 7 && strcmp(filename + length - 7, ".bundle") == 0;
+}
+
+// a scene has tens of assets, the index is small enough to walk.
+const bundle_entry_t* find_bundle_entry(const char* name, int type) {
+    for (int entry_idx = 0; entry_idx < entry_count; ++entry_idx) {
+        if (entries[entry_idx].type == (uint32_t)type && strcmp(entries[entry_idx].name, name) == 0) {
+            return &entries[entry_idx];
+        }
+    }
+    return NULL;
+}
+
+const unsigned char* get_bundle_entry_data(const bundle_entry_t* entry) {
+    return bundle_data + entry->offset;
+}
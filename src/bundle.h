@@ -0,0 +1,62 @@
+#ifndef BUNDLE_H
+#define BUNDLE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "vector.h"
+#include "asset.h"
+
+// asset bundles: every mesh and texture of a scene in one file (see tools/pack_bundle.c), already in the layout the
+// renderer keeps in memory. the bundle is mapped once, and assets found in it point straight into the mapping,
+// so startup is a single map and the pages fault in as the frames first touch them.
+// the asset manager looks in the open bundle before it goes to the loose files, by the same path.
+
+#define BUNDLE_FILE_MAGIC "SJMBNDL1"
+#define BUNDLE_FILE_VERSION 1
+// every entry starts on a page boundary, so touching one asset never faults in a page of another.
+#define BUNDLE_PAGE_SIZE 4096
+
+enum BUNDLE_ENTRY_TYPE {
+    BUNDLE_ENTRY_GEOMETRY,
+    BUNDLE_ENTRY_TEXTURE,
+};
+
+// the file starts with this header, followed by entry_count entries. the file is written and read by the same build,
+// the struct sizes in the header catch a mismatch.
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t page_size;
+    uint32_t entry_count;
+    uint32_t vertex_size; // sizeof(vec3_t)
+    uint32_t face_size; // sizeof(face_t)
+    uint32_t reserved;
+} bundle_file_header_t;
+
+// a geometry is three arrays (see ARRAY_HEADER_SIZE in array.h) per level, at the given offsets from the start of
+// the entry: vertices, faces and face normals, as the loader leaves them (reordered, levels generated).
+// a texture is the PNG file as it is, which is what texture_t keeps until a frame samples it.
+typedef struct {
+    char name[MAX_ASSET_FILENAME_LENGTH]; // the path the asset is loaded by.
+    uint32_t type; // one of BUNDLE_ENTRY_TYPE
+    uint32_t lod_count;
+    uint64_t offset; // page aligned, from the start of the file.
+    uint64_t size;
+    vec3_t bounds_center;
+    float bounds_radius;
+    uint32_t vertices_offsets[MAX_GEOMETRY_LOD_COUNT];
+    uint32_t faces_offsets[MAX_GEOMETRY_LOD_COUNT];
+    uint32_t face_normals_offsets[MAX_GEOMETRY_LOD_COUNT];
+} bundle_entry_t;
+
+// returns false if the file can not be mapped or is not a bundle of this build. only one bundle is open at a time.
+bool open_asset_bundle(const char* filename);
+// every asset that came from the bundle has to be released first, see free_assets().
+void close_asset_bundle(void);
+bool is_asset_bundle_filename(const char* filename);
+
+// NULL if the open bundle has no such entry, or no bundle is open.
+const bundle_entry_t* find_bundle_entry(const char* name, int type);
+const unsigned char* get_bundle_entry_data(const bundle_entry_t* entry);
+
+#endif
@@ -0,0 +1,398 @@
+#include <math.h>
+#include <stdlib.h>
+#include "bvh.h"
+#include "array.h"
+#include "mesh.h"
+
+typedef struct {
+    vec3_t min;
+    vec3_t max;
+    int parent; // -1 for the root.
+    int left; // -1 for a leaf.
+    int right;
+    int item; // leaves only, index into the item list.
+} bvh_node_t;
+
+// dynamic arrays. nodes[0] is the root once anything is in the tree.
+static bvh_node_t* nodes = NULL;
+static bvh_item_t* items = NULL;
+static int* moved_leaves = NULL;
+// nodes are walked with an explicit stack instead of recursion, reused between queries.
+static int* node_stack = NULL;
+
+typedef struct {
+    bvh_item_t item;
+    vec3_t min;
+    vec3_t max;
+    vec3_t centroid;
+} build_entry_t;
+
+// qsort has no context argument.
+static int bvh_sort_axis = 0;
+
+static float get_axis(vec3_t v, int axis) {
+    return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+}
+
+static int compare_centroids(const void* lhs, const void* rhs) {
+    float a = get_axis(((const build_entry_t*)lhs)->centroid, bvh_sort_axis);
+    float b = get_axis(((const build_entry_t*)rhs)->centroid, bvh_sort_axis);
+    return a < b ? -1 : (a > b ? 1 : 0);
+}
+
+static vec3_t vec3_min(vec3_t a, vec3_t b) {
+    return vec3_new(fminf(a.x, b.x), fminf(a.y, b.y), fminf(a.z, b.z));
+}
+
+static vec3_t vec3_max(vec3_t a, vec3_t b) {
+    return vec3_new(fmaxf(a.x, b.x), fmaxf(a.y, b.y), fmaxf(a.z, b.z));
+}
+
+static void get_item_box(bvh_item_t item, vec3_t* min, vec3_t* max) {
+    mesh_t* mesh = get_mesh(item.mesh_idx);
+    vec3_t center;
+    float radius;
+    get_mesh_instance_bounds(mesh, &mesh->instances[item.instance_idx], &center, &radius);
+    *min = vec3_sub(center, vec3_new(radius, radius, radius));
+    *max = vec3_add(center, vec3_new(radius, radius, radius));
+}
+
+// top down, splitting at the median centroid along the longest axis of the centroids.
+static int build_node(build_entry_t* entries, int count, int parent) {
+    int node_idx = array_length(nodes);
+    bvh_node_t node = { .parent = parent, .left = -1, .right = -1, .item = -1 };
+    array_push(nodes, node);
+
+    if (count == 1) {
+        nodes[node_idx].min = entries[0].min;
+        nodes[node_idx].max = entries[0].max;
+        nodes[node_idx].item = array_length(items);
+        array_push(items, entries[0].item);
+        mesh_t* mesh = get_mesh(entries[0].item.mesh_idx);
+        mesh->instances[entries[0].item.instance_idx].bvh_leaf = node_idx;
+        return node_idx;
+    }
+
+    vec3_t centroid_min = entries[0].centroid;
+    vec3_t centroid_max = entries[0].centroid;
+    for (int entry_idx = 1; entry_idx < count; ++entry_idx) {
+        centroid_min = vec3_min(centroid_min, entries[entry_idx].centroid);
+        centroid_max = vec3_max(centroid_max, entries[entry_idx].centroid);
+    }
+    vec3_t extent = vec3_sub(centroid_max, centroid_min);
+    bvh_sort_axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+    qsort(entries, count, sizeof(build_entry_t), compare_centroids);
+
+    // the array can move while the children are pushed, so index it again afterwards.
+    int left = build_node(entries, count / 2, node_idx);
+    int right = build_node(entries + count / 2, count - count / 2, node_idx);
+    nodes[node_idx].left = left;
+    nodes[node_idx].right = right;
+    nodes[node_idx].min = vec3_min(nodes[left].min, nodes[right].min);
+    nodes[node_idx].max = vec3_max(nodes[left].max, nodes[right].max);
+    return node_idx;
+}
+
+static void rebuild_scene_bvh(int item_count) {
+    array_clear(nodes);
+    array_clear(items);
+    array_clear(moved_leaves);
+
+    build_entry_t* entries = (build_entry_t*)malloc(sizeof(build_entry_t) * (item_count > 0 ? item_count : 1));
+    int entry_count = 0;
+    for (int mesh_idx = 0; mesh_idx < get_mesh_count(); ++mesh_idx) {
+        mesh_t* mesh = get_mesh(mesh_idx);
+        if (!is_mesh_geometry_ready(mesh)) {
+            continue;
+        }
+        for (int instance_idx = 0; instance_idx < get_mesh_instance_count(mesh); ++instance_idx) {
+            build_entry_t* entry = &entries[entry_count++];
+            entry->item = (bvh_item_t){ mesh_idx, instance_idx };
+            get_item_box(entry->item, &entry->min, &entry->max);
+            entry->centroid = vec3_mul(vec3_add(entry->min, entry->max), 0.5);
+        }
+    }
+
+    if (entry_count > 0) {
+        build_node(entries, entry_count, -1);
+    }
+    free(entries);
+}
+
+// grow the boxes from the leaf up. stops early once a parent already contains the new box, unless it must shrink.
+static void refit_leaf(int leaf) {
+    bvh_node_t* node = &nodes[leaf];
+    get_item_box(items[node->item], &node->min, &node->max);
+
+    for (int node_idx = node->parent; node_idx >= 0; node_idx = nodes[node_idx].parent) {
+        bvh_node_t* parent = &nodes[node_idx];
+        vec3_t min = vec3_min(nodes[parent->left].min, nodes[parent->right].min);
+        vec3_t max = vec3_max(nodes[parent->left].max, nodes[parent->right].max);
+        if (min.x == parent->min.x && min.y == parent->min.y && min.z == parent->min.z &&
+            max.x == parent->max.x && max.y == parent->max.y && max.z == parent->max.z) {
+            break;
+        }
+        parent->min = min;
+        parent->max = max;
+    }
+}
+
+void update_scene_bvh(void) {
+    // instances are only ever added, so a different count means the set changed.
+    int item_count = 0;
+    for (int mesh_idx = 0; mesh_idx < get_mesh_count(); ++mesh_idx) {
+        mesh_t* mesh = get_mesh(mesh_idx);
+        if (is_mesh_geometry_ready(mesh)) {
+            item_count += get_mesh_instance_count(mesh);
+        }
+    }
+
+    if (item_count != array_length(items) ||
+        array_length(moved_leaves) > array_length(items) * BVH_REBUILD_MOVED_FRACTION) {
+        rebuild_scene_bvh(item_count);
+        return;
+    }
+
+    for (int moved_idx = 0; moved_idx < array_length(moved_leaves); ++moved_idx) {
+        refit_leaf(moved_leaves[moved_idx]);
+    }
+    array_clear(moved_leaves);
+}
+
+void mark_bvh_leaf_moved(int leaf) {
+    array_push(moved_leaves, leaf);
+}
+
+int get_scene_bvh_node_count(void) {
+    return array_length(nodes);
+}
+
+void free_scene_bvh(void) {
+    array_free(nodes);
+    array_free(items);
+    array_free(moved_leaves);
+    array_free(node_stack);
+    nodes = NULL;
+    items = NULL;
+    moved_leaves = NULL;
+    node_stack = NULL;
+}
+
+// pushes a node index together with the frustum planes it still has to be tested against.
+static void push_node(int node_idx, int plane_mask) {
+    array_push(node_stack, node_idx);
+    array_push(node_stack, plane_mask);
+}
+
+static int pop_node(int* plane_mask) {
+    int length = array_length(node_stack);
+    *plane_mask = node_stack[length - 1];
+    int node_idx = node_stack[length - 2];
+    array_truncate(node_stack, length - 2);
+    return node_idx;
+}
+
+void query_scene_bvh_frustum(mat4_t view_projection_matrix, bvh_item_t** visible_items) {
+    array_clear(*visible_items);
+    if (array_length(nodes) == 0) {
+        return;
+    }
+
+    // the planes come straight from the rows of the clip matrix (Gribb & Hartmann), clip space z runs from 0 to w.
+    // a point is inside a plane when a * x + b * y + c * z + d >= 0.
+    float planes[6][4];
+    for (int column = 0; column < 4; ++column) {
+        float row_x = view_projection_matrix.m[0][column];
+        float row_y = view_projection_matrix.m[1][column];
+        float row_z = view_projection_matrix.m[2][column];
+        float row_w = view_projection_matrix.m[3][column];
+        planes[0][column] = row_w + row_x; // left
+        planes[1][column] = row_w - row_x; // right
+        planes[2][column] = row_w + row_y; // bottom
+        planes[3][column] = row_w - row_y; // top
+        planes[4][column] = row_z; // near
+        planes[5][column] = row_w - row_z; // far
+    }
+
+    array_clear(node_stack);
+    push_node(0, 0x3F);
+    while (array_length(node_stack) > 0) {
+        int plane_mask;
+        int node_idx = pop_node(&plane_mask);
+        bvh_node_t* node = &nodes[node_idx];
+
+        // a box completely inside a plane drops it from the mask, its children skip that plane.
+        bool is_outside = false;
+        for (int plane = 0; plane < 6 && !is_outside; ++plane) {
+            if ((plane_mask & (1 << plane)) == 0) {
+                continue;
+            }
+            float* p = planes[plane];
+            float farthest = p[0] * (p[0] >= 0.0f ? node->max.x : node->min.x) +
+                             p[1] * (p[1] >= 0.0f ? node->max.y : node->min.y) +
+                             p[2] * (p[2] >= 0.0f ? node->max.z : node->min.z) + p[3];
+            float nearest = p[0] * (p[0] >= 0.0f ? node->min.x : node->max.x) +
+                            p[1] * (p[1] >= 0.0f ? node->min.y : node->max.y) +
+                            p[2] * (p[2] >= 0.0f ? node->min.z : node->max.z) + p[3];
+            if (farthest < 0.0f) {
+                is_outside = true;
+            } else if (nearest >= 0.0f) {
+                plane_mask &= ~(1 << plane);
+            }
+        }
+        if (is_outside) {
+            continue;
+        }
+
+        if (node->left < 0) {
+            array_push(*visible_items, items[node->item]);
+        } else {
+            push_node(node->right, plane_mask);
+            push_node(node->left, plane_mask);
+        }
+    }
+}
+
+void query_scene_bvh_sphere(vec3_t center, float radius, bvh_item_t** found_items) {
+    array_clear(*found_items);
+    if (array_length(nodes) == 0) {
+        return;
+    }
+
+    array_clear(node_stack);
+    push_node(0, 0);
+    while (array_length(node_stack) > 0) {
+        int unused;
+        bvh_node_t* node = &nodes[pop_node(&unused)];
+
+        // distance from the center to the closest point of the box.
+        vec3_t closest = vec3_max(node->min, vec3_min(center, node->max));
+        vec3_t offset = vec3_sub(center, closest);
+        if (vec3_dot(offset, offset) > radius * radius) {
+            continue;
+        }
+
+        if (node->left < 0) {
+            array_push(*found_items, items[node->item]);
+        } else {
+            push_node(node->right, 0);
+            push_node(node->left, 0);
+        }
+    }
+}
+
+// slab test, returns the entry distance or INFINITY when the ray misses the box within max_distance.
+static float intersect_ray_box(vec3_t origin, vec3_t inverse_direction, float max_distance, vec3_t min, vec3_t max) {
+    float t0 = 0.0f;
+    float t1 = max_distance;
+    for (int axis = 0; axis < 3; ++axis) {
+        float entry = (get_axis(min, axis) - get_axis(origin, axis)) * get_axis(inverse_direction, axis);
+        float exit = (get_axis(max, axis) - get_axis(origin, axis)) * get_axis(inverse_direction, axis);
+        if (entry > exit) {
+            float swap = entry;
+            entry = exit;
+            exit = swap;
+        }
+        // written so a NaN (0 * INFINITY, the ray lies in the slab plane) leaves the interval alone.
+        t0 = entry > t0 ? entry : t0;
+        t1 = exit < t1 ? exit : t1;
+        if (t0 > t1) {
+            return INFINITY;
+        }
+    }
+    return t0;
+}
+
+// Moller & Trumbore, both sides of the face count.
+static float intersect_ray_triangle(vec3_t origin, vec3_t direction, vec3_t a, vec3_t b, vec3_t c) {
+    vec3_t edge_ab = vec3_sub(b, a);
+    vec3_t edge_ac = vec3_sub(c, a);
+    vec3_t p = vec3_cross(direction, edge_ac);
+    float determinant = vec3_dot(edge_ab, p);
+    if (fabsf(determinant) < 1e-12f) {
+        return INFINITY;
+    }
+    float inverse_determinant = 1.0f / determinant;
+    vec3_t to_origin = vec3_sub(origin, a);
+    float u = vec3_dot(to_origin, p) * inverse_determinant;
+    if (u < 0.0f || u > 1.0f) {
+        return INFINITY;
+    }
+    vec3_t q = vec3_cross(to_origin, edge_ab);
+    float v = vec3_dot(direction, q) * inverse_determinant;
+    if (v < 0.0f || u + v > 1.0f) {
+        return INFINITY;
+    }
+    float t = vec3_dot(edge_ac, q) * inverse_determinant;
+    return t >= 0.0f ? t : INFINITY;
+}
+
+// the ray goes into object space (like the camera does for backface culling), the distance along it does not change.
+static float intersect_ray_instance(vec3_t origin, vec3_t direction, bvh_item_t item) {
+    mesh_t* mesh = get_mesh(item.mesh_idx);
+    mesh_instance_t* instance = &mesh->instances[item.instance_idx];
+    mat4_t inverse_rotation = mat4_transpose(get_mesh_instance_rotation_matrix(instance));
+    vec3_t object_origin = vec3_from_vec4(mat4_mul_vec4(inverse_rotation, vec4_from_vec3(vec3_sub(origin, instance->translation))));
+    vec3_t object_direction = vec3_from_vec4(mat4_mul_vec4(inverse_rotation, vec4_from_vec3(direction)));
+    object_origin = vec3_new(object_origin.x / instance->scale.x, object_origin.y / instance->scale.y, object_origin.z / instance->scale.z);
+    object_direction = vec3_new(object_direction.x / instance->scale.x, object_direction.y / instance->scale.y, object_direction.z / instance->scale.z);
+
+    geometry_lod_t* lod = &mesh->geometry->lods[0];
+    float nearest = INFINITY;
+    for (int face_idx = 0; face_idx < array_length(lod->faces); ++face_idx) {
+        face_t face = lod->faces[face_idx];
+        float t = intersect_ray_triangle(object_origin, object_direction, lod->vertices[face.a], lod->vertices[face.b], lod->vertices[face.c]);
+        if (t < nearest) {
+            nearest = t;
+        }
+    }
+    return nearest;
+}
+
+bool raycast_scene_bvh(vec3_t origin, vec3_t direction, float max_distance, bvh_item_t* hit, float* distance) {
+    if (array_length(nodes) == 0) {
+        return false;
+    }
+
+    vec3_t inverse_direction = vec3_new(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+    float nearest = max_distance;
+    bool is_hit = false;
+
+    array_clear(node_stack);
+    push_node(0, 0);
+    while (array_length(node_stack) > 0) {
+        int unused;
+        bvh_node_t* node = &nodes[pop_node(&unused)];
+        if (intersect_ray_box(origin, inverse_direction, nearest, node->min, node->max) == INFINITY) {
+            continue;
+        }
+
+        if (node->left < 0) {
+            float t = intersect_ray_instance(origin, direction, items[node->item]);
+            if (t != INFINITY && t <= nearest) {
+                nearest = t;
+                *hit = items[node->item];
+                is_hit = true;
+            }
+            continue;
+        }
+
+        // the nearer child goes on top of the stack, so its hits shrink the search for the other one.
+        float left_t = intersect_ray_box(origin, inverse_direction, nearest, nodes[node->left].min, nodes[node->left].max);
+        float right_t = intersect_ray_box(origin, inverse_direction, nearest, nodes[node->right].min, nodes[node->right].max);
+        int left = node->left;
+        int right = node->right;
+        if (left_t <= right_t) {
+            if (right_t != INFINITY) push_node(right, 0);
+            if (left_t != INFINITY) push_node(left, 0);
+        } else {
+            if (left_t != INFINITY) push_node(left, 0);
+            if (right_t != INFINITY) push_node(right, 0);
+        }
+    }
+
+    if (is_hit) {
+        *distance = nearest;
+    }
+    return is_hit;
+}
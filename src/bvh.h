@@ -0,0 +1,35 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <stdbool.h>
+#include "vector.h"
+#include "matrix.h"
+
+// a bounding volume hierarchy over every instance of every ready mesh, in world space.
+// each leaf holds one instance and the box around its bounding sphere. the tree is rebuilt when instances are added
+// or a mesh finishes loading, and refit bottom up when instances move (see set_mesh_instance_transform()).
+
+// how many leaves may move in a frame before a full rebuild is cheaper (and gives a tighter tree) than refitting.
+#define BVH_REBUILD_MOVED_FRACTION 0.25f
+
+typedef struct {
+    int mesh_idx;
+    int instance_idx;
+} bvh_item_t;
+
+// once per frame before any query, on the main thread.
+void update_scene_bvh(void);
+void mark_bvh_leaf_moved(int leaf);
+void free_scene_bvh(void);
+int get_scene_bvh_node_count(void);
+
+// the queries clear *items and fill it (a dynamic array, see array.h). the array can be reused between frames.
+// instances whose box is inside or crosses the frustum of view_projection (projection * view).
+void query_scene_bvh_frustum(mat4_t view_projection_matrix, bvh_item_t** items);
+// instances whose box overlaps the sphere.
+void query_scene_bvh_sphere(vec3_t center, float radius, bvh_item_t** items);
+// the nearest face of the full detail geometry along the ray within max_distance.
+// direction does not have to be normalized, distance is in units of direction.
+bool raycast_scene_bvh(vec3_t origin, vec3_t direction, float max_distance, bvh_item_t* hit, float* distance);
+
+#endif
@@ -0,0 +1,271 @@
+#if !defined(_WIN32)
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "capture.h"
+
+#if defined(_WIN32)
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+static char capture_path[1024];
+static FILE* capture_stream = NULL; // stdout, as it was before open_frame_capture() pointed stdout at stderr.
+static bool is_capture_open = false;
+static bool is_path_per_frame = false;
+static int captured_frame_count = 0;
+
+static bool has_extension(const char* filename, const char* extension) {
+    size_t length = strlen(filename);
+    size_t extension_length = strlen(extension);
+    return length > extension_length && strcmp(filename + length - extension_length, extension) == 0;
+}
+
+// the path goes to snprintf() as the format, so the only conversion it may hold is one integer like %d or %04d.
+static bool is_frame_number_pattern(const char* path) {
+    const char* percent = strchr(path, '%');
+    if (percent == NULL || strchr(percent + 1, '%') != NULL) {
+        return false;
+    }
+    const char* conversion = percent + 1;
+    while (*conversion >= '0' && *conversion <= '9') {
+        conversion += 1;
+    }
+    return *conversion == 'd' && conversion - percent <= 4;
+}
+
+static void write_ppm(FILE* file, const uint32_t* pixels, int width, int height, int stride) {
+    fprintf(file, "P6\n%d %d\n255\n", width, height);
+    unsigned char* row = (unsigned char*)malloc((size_t)width * 3);
+    for (int y = 0; y < height; ++y) {
+        const unsigned char* source = (const unsigned char*)&pixels[stride * y];
+        for (int x = 0; x < width; ++x) {
+            row[x * 3 + 0] = source[x * 4 + 0];
+            row[x * 3 + 1] = source[x * 4 + 1];
+            row[x * 3 + 2] = source[x * 4 + 2];
+        }
+        fwrite(row, 1, (size_t)width * 3, file);
+    }
+    free(row);
+}
+
+static uint32_t crc_table[256];
+
+static uint32_t update_crc(uint32_t crc, const unsigned char* data, size_t size) {
+    if (crc_table[1] == 0) {
+        for (uint32_t value_idx = 0; value_idx < 256; ++value_idx) {
+            uint32_t value = value_idx;
+            for (int bit_idx = 0; bit_idx < 8; ++bit_idx) {
+                value = (value & 1) ? 0xEDB88320u ^ (value >> 1) : value >> 1;
+            }
+            crc_table[value_idx] = value;
+        }
+    }
+    for (size_t byte_idx = 0; byte_idx < size; ++byte_idx) {
+        crc = crc_table[(crc ^ data[byte_idx]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+static void put_u32(unsigned char* bytes, uint32_t value) {
+    bytes[0] = (unsigned char)(value >> 24);
+    bytes[1] = (unsigned char)(value >> 16);
+    bytes[2] = (unsigned char)(value >> 8);
+    bytes[3] = (unsigned char)value;
+}
+
+// bytes that are part of a chunk also go into its crc.
+static void write_chunk_bytes(FILE* file, const void* data, size_t size, uint32_t* crc) {
+    if (size == 0) {
+        return;
+    }
+    fwrite(data, 1, size, file);
+    *crc = update_crc(*crc, (const unsigned char*)data, size);
+}
+
+static void write_chunk(FILE* file, const char* type, const unsigned char* data, uint32_t size) {
+    unsigned char length[4];
+    put_u32(length, size);
+    fwrite(length, 1, 4, file);
+    uint32_t crc = 0xFFFFFFFFu;
+    write_chunk_bytes(file, type, 4, &crc);
+    write_chunk_bytes(file, data, size, &crc);
+    unsigned char crc_bytes[4];
+    put_u32(crc_bytes, crc ^ 0xFFFFFFFFu);
+    fwrite(crc_bytes, 1, 4, file);
+}
+
+// the image data goes out as stored deflate blocks: a frame is written far more often than it is looked at, so it
+// is not worth compressing here. every row starts with filter type 0 (none).
+static void write_png(FILE* file, const uint32_t* pixels, int width, int height, int stride) {
+    static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    fwrite(signature, 1, sizeof(signature), file);
+
+    unsigned char header[13];
+    put_u32(&header[0], (uint32_t)width);
+    put_u32(&header[4], (uint32_t)height);
+    header[8] = 8; // bits per channel
+    header[9] = 2; // RGB
+    header[10] = 0; // deflate
+    header[11] = 0; // adaptive filtering
+    header[12] = 0; // not interlaced
+    write_chunk(file, "IHDR", header, sizeof(header));
+
+    size_t row_size = 1 + (size_t)width * 3;
+    size_t raw_size = row_size * height;
+    unsigned char* raw = (unsigned char*)malloc(raw_size);
+    uint32_t adler_a = 1;
+    uint32_t adler_b = 0;
+    for (int y = 0; y < height; ++y) {
+        unsigned char* row = &raw[row_size * y];
+        const unsigned char* source = (const unsigned char*)&pixels[stride * y];
+        row[0] = 0;
+        for (int x = 0; x < width; ++x) {
+            row[1 + x * 3 + 0] = source[x * 4 + 0];
+            row[1 + x * 3 + 1] = source[x * 4 + 1];
+            row[1 + x * 3 + 2] = source[x * 4 + 2];
+        }
+        for (size_t byte_idx = 0; byte_idx < row_size; ++byte_idx) {
+            adler_a = (adler_a + row[byte_idx]) % 65521;
+            adler_b = (adler_b + adler_a) % 65521;
+        }
+    }
+
+    size_t block_count = (raw_size + 65534) / 65535;
+    size_t data_size = 2 + raw_size + block_count * 5 + 4;
+    unsigned char length[4];
+    put_u32(length, (uint32_t)data_size);
+    fwrite(length, 1, 4, file);
+    uint32_t crc = 0xFFFFFFFFu;
+    write_chunk_bytes(file, "IDAT", 4, &crc);
+    static const unsigned char zlib_header[2] = { 0x78, 0x01 };
+    write_chunk_bytes(file, zlib_header, 2, &crc);
+    for (size_t offset = 0; offset < raw_size; offset += 65535) {
+        size_t block_size = raw_size - offset < 65535 ? raw_size - offset : 65535;
+        unsigned char block_header[5];
+        block_header[0] = offset + block_size == raw_size ? 1 : 0; // the last block.
+        block_header[1] = (unsigned char)block_size;
+        block_header[2] = (unsigned char)(block_size >> 8);
+        block_header[3] = (unsigned char)~block_size;
+        block_header[4] = (unsigned char)(~block_size >> 8);
+        write_chunk_bytes(file, block_header, 5, &crc);
+        write_chunk_bytes(file, &raw[offset], block_size, &crc);
+    }
+    unsigned char adler[4];
+    put_u32(adler, (adler_b << 16) | adler_a);
+    write_chunk_bytes(file, adler, 4, &crc);
+    unsigned char crc_bytes[4];
+    put_u32(crc_bytes, crc ^ 0xFFFFFFFFu);
+    fwrite(crc_bytes, 1, 4, file);
+    free(raw);
+
+    write_chunk(file, "IEND", NULL, 0);
+}
+
+bool write_ppm_image(const char* filename, const uint32_t* pixels, int width, int height, int stride) {
+    FILE* file = fopen(filename, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "unable to open %s for writing.\n", filename);
+        return false;
+    }
+    write_ppm(file, pixels, width, height, stride);
+    bool is_written = !ferror(file);
+    fclose(file);
+    return is_written;
+}
+
+bool write_png_image(const char* filename, const uint32_t* pixels, int width, int height, int stride) {
+    FILE* file = fopen(filename, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "unable to open %s for writing.\n", filename);
+        return false;
+    }
+    write_png(file, pixels, width, height, stride);
+    bool is_written = !ferror(file);
+    fclose(file);
+    return is_written;
+}
+
+// the frames keep the real stdout, everything printed to stdout from here on lands on stderr.
+static FILE* take_stdout(void) {
+    fflush(stdout);
+#if defined(_WIN32)
+    int frame_fd = _dup(_fileno(stdout));
+    if (frame_fd < 0 || _dup2(_fileno(stderr), _fileno(stdout)) != 0) {
+        return NULL;
+    }
+    _setmode(frame_fd, _O_BINARY);
+    return _fdopen(frame_fd, "wb");
+#else
+    int frame_fd = dup(STDOUT_FILENO);
+    if (frame_fd < 0 || dup2(STDERR_FILENO, STDOUT_FILENO) < 0) {
+        return NULL;
+    }
+    return fdopen(frame_fd, "wb");
+#endif
+}
+
+bool open_frame_capture(const char* path) {
+    close_frame_capture();
+    if (strcmp(path, "-") == 0) {
+        capture_stream = take_stdout();
+        if (capture_stream == NULL) {
+            fprintf(stderr, "unable to stream frames to stdout.\n");
+            return false;
+        }
+    } else if (!has_extension(path, ".png") && !has_extension(path, ".ppm")) {
+        fprintf(stderr, "%s: frames are written as .png or .ppm.\n", path);
+        return false;
+    } else if (strchr(path, '%') != NULL && !is_frame_number_pattern(path)) {
+        fprintf(stderr, "%s: only one frame number like %%04d can be in the path.\n", path);
+        return false;
+    } else if (strlen(path) >= sizeof(capture_path)) {
+        fprintf(stderr, "%s: path too long.\n", path);
+        return false;
+    }
+    strcpy(capture_path, path);
+    is_path_per_frame = strchr(path, '%') != NULL;
+    captured_frame_count = 0;
+    is_capture_open = true;
+    return true;
+}
+
+void close_frame_capture(void) {
+    if (capture_stream != NULL) {
+        fclose(capture_stream);
+        capture_stream = NULL;
+    }
+    is_capture_open = false;
+}
+
+bool is_frame_capture_open(void) {
+    return is_capture_open;
+}
+
+bool capture_frame(const uint32_t* pixels, int width, int height, int stride) {
+    if (!is_capture_open) {
+        return false;
+    }
+    int frame_idx = captured_frame_count++;
+    if (capture_stream != NULL) {
+        write_ppm(capture_stream, pixels, width, height, stride);
+        fflush(capture_stream);
+        return !ferror(capture_stream);
+    }
+
+    char filename[sizeof(capture_path) + 32];
+    if (is_path_per_frame) {
+        snprintf(filename, sizeof(filename), capture_path, frame_idx);
+    } else {
+        strcpy(filename, capture_path);
+    }
+    if (has_extension(filename, ".png")) {
+        return write_png_image(filename, pixels, width, height, stride);
+    }
+    return write_ppm_image(filename, pixels, width, height, stride);
+}
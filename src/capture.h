@@ -0,0 +1,23 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// frame capture for the headless renderer: frames go to image files, or as a stream of binary PPM images to stdout
+// (which ffmpeg reads with -f image2pipe). pixels are the color buffer as the rasterizer leaves it, R G B A in memory.
+
+// path is "-" for stdout, or a file name ending in .png or .ppm. a path with a printf style integer (frame_%04d.png)
+// gets a file per frame, any other file is overwritten by each frame and so ends up holding the last one.
+// with stdout taken by the frames, whatever the renderer prints goes to stderr instead.
+bool open_frame_capture(const char* path);
+void close_frame_capture(void);
+bool is_frame_capture_open(void);
+
+bool capture_frame(const uint32_t* pixels, int width, int height, int stride);
+
+// stride is in pixels. returns false if the file can not be written.
+bool write_ppm_image(const char* filename, const uint32_t* pixels, int width, int height, int stride);
+bool write_png_image(const char* filename, const uint32_t* pixels, int width, int height, int stride);
+
+#endif
@@ -1,4 +1,5 @@
 #include "clipping.h"
+#include "profile.h"
 #include <math.h>
 #include <assert.h>
 
@@ -46,6 +47,15 @@ void init_frustrum_planes(float fovx, float fovy, float z_near, float z_far) {
 }
 
 
+bool is_sphere_outside_frustum(vec3_t center, float radius) {
+    for (int plane = 0; plane < PLANE_COUNT; ++plane) {
+        float distance = vec3_dot(vec3_sub(center, frustum_planes[plane].point), frustum_planes[plane].normal);
+        if (distance < -radius) {
+            return true;
+        }
+    }
+    return false;
+}
 
 polygon_t create_polygon_from_triangle(
     vec3_t v0,
@@ -68,14 +78,21 @@ float float_lerp(float a, float b, float t) {
     return a + t * (b - a);
 }
 
-void clip_polygon_against_plane(polygon_t* polygon, int plane)
+// returns true if the plane cut anything off.
+bool clip_polygon_against_plane(polygon_t* polygon, int plane)
 {
+    // already clipped away by a previous plane, there is no last vertex to start from.
+    if (polygon->vertex_count == 0) {
+        return false;
+    }
+
     vec3_t plane_point = frustum_planes[plane].point;
     vec3_t plane_normal = frustum_planes[plane].normal; 
 
     vec3_t inside_vertices[MAX_POLYGON_VERTEX_COUNT];    
     tex2_t inside_texcoords[MAX_POLYGON_VERTEX_COUNT];
     int inside_vertex_count = 0;
+    bool is_cut = false;
 
     // start the current vertex with thte first polygon vertex and texture coordinate
     vec3_t* current_vertex = &polygon->vertices[0];
@@ -128,6 +145,8 @@ void clip_polygon_against_plane(polygon_t* polygon, int plane)
             inside_vertices[inside_vertex_count] = vec3_clone(current_vertex);
             inside_texcoords[inside_vertex_count] = tex2_clone(current_texcoords);
             inside_vertex_count += 1;
+        } else {
+            is_cut = true;
         }
 
         previous_dot = current_dot;
@@ -145,16 +164,20 @@ void clip_polygon_against_plane(polygon_t* polygon, int plane)
     }
 
     polygon->vertex_count = inside_vertex_count;
+    return is_cut;
 }
 
-void clip_polygon(polygon_t* polygon) {
-
-    clip_polygon_against_plane(polygon, LEFT_FRUSTUM_PLANE);
-    clip_polygon_against_plane(polygon, RIGHT_FRUSTUM_PLANE);
-    clip_polygon_against_plane(polygon, TOP_FRUSTUM_PLANE);
-    clip_polygon_against_plane(polygon, BOTTOM_FRUSTUM_PLANE);
-    clip_polygon_against_plane(polygon, NEAR_FRUSTUM_PLANE);
-    clip_polygon_against_plane(polygon, FAR_FRUSTUM_PLANE);
+bool clip_polygon(polygon_t* polygon) {
+    PROFILE_SCOPE("clip_polygon");
+
+    bool is_cut = false;
+    is_cut |= clip_polygon_against_plane(polygon, LEFT_FRUSTUM_PLANE);
+    is_cut |= clip_polygon_against_plane(polygon, RIGHT_FRUSTUM_PLANE);
+    is_cut |= clip_polygon_against_plane(polygon, TOP_FRUSTUM_PLANE);
+    is_cut |= clip_polygon_against_plane(polygon, BOTTOM_FRUSTUM_PLANE);
+    is_cut |= clip_polygon_against_plane(polygon, NEAR_FRUSTUM_PLANE);
+    is_cut |= clip_polygon_against_plane(polygon, FAR_FRUSTUM_PLANE);
+    return is_cut;
 }
 
 void triangles_from_polygon(polygon_t* polygon, triangle_t triangles[], int* triangle_count) {
@@ -1,5 +1,6 @@
 #ifndef CLIPPING_H
 #define CLIPPING_H
+#include <stdbool.h>
 #include "vector.h"
 #include "triangle.h"
 
@@ -35,10 +36,13 @@ polygon_t create_polygon_from_triangle(
     tex2_t t2
 );
 
-void  clip_polygon(polygon_t* polygon);
+// returns true if any frustum plane cut the polygon, which may leave it with no vertices at all.
+bool clip_polygon(polygon_t* polygon);
 
 
 void init_frustrum_planes(float fovx, float fovy, float z_near, float z_far);
+// camera space sphere completely on the outside of one of the frustum planes.
+bool is_sphere_outside_frustum(vec3_t center, float radius);
 void triangles_from_polygon(polygon_t* polygon, triangle_t triangles[], int* triangle_count);
 
 
@@ -1,11 +1,24 @@
 #include "display.h"
+#include "present.h"
+#include "profile.h"
 #include <assert.h>
+#include <string.h>
 
 
 static SDL_Window* window = NULL;
 static SDL_Renderer* renderer = NULL;
+// what the rasterizer writes to: owned_color_buffer, or the pixels of the locked texture in PRESENT_MODE_LOCK.
 static uint32_t* color_buffer = NULL;
+static int color_buffer_stride = 0; // pixels from one row to the next, the pitch of a locked texture can be wider.
+static uint32_t* owned_color_buffer = NULL;
+static bool is_color_buffer_locked = false;
+static bool is_color_buffer_acquired = false; // from the present thread, in PRESENT_MODE_PIPELINED.
+static int present_buffer_count = 2;
+static enum PRESENT_MODE present_mode = PRESENT_MODE_LOCK;
 static float* z_buffer = NULL;
+// per pixel since the z buffer was cleared, only counted in the heatmap modes.
+static uint16_t* fragment_test_counts = NULL;
+static uint16_t* fragment_write_counts = NULL;
 static SDL_Texture* color_buffer_texture = NULL;
 static int window_width = 800;
 static int window_height = 600;
@@ -13,6 +26,10 @@ static int window_height = 600;
 static enum RENDER_MODE render_mode = RENDER_MODE_FILLED_WITH_WIREFRAME;
 static enum CULL_MODE cull_mode = CULL_BACKFACE;
 
+// the overdraw heatmap runs from 1 write (blue) to this many or more (red), the tile heatmap up to its busiest tile.
+#define OVERDRAW_HEATMAP_MAX 8
+#define HEATMAP_TILE_SIZE 32
+
 
 
 
@@ -37,7 +54,7 @@ bool should_render_filled_triangles(void) {
 }
 
 bool should_render_textured_triangles(void) {
-    return (render_mode == RENDER_MODE_TEXTURED || render_mode == RENDER_MODE_TEXTURED_WITH_WIREFRAME);
+    return (render_mode == RENDER_MODE_TEXTURED || render_mode == RENDER_MODE_TEXTURED_WITH_WIREFRAME || should_count_fragments());
 }
 
 bool should_render_wireframe(void) {
@@ -48,6 +65,10 @@ bool should_render_wireframe_with_vertices(void) {
     return (render_mode == RENDER_MODE_WIREFRAME_WITH_VERTICES);
 }
 
+bool should_count_fragments(void) {
+    return (render_mode == RENDER_MODE_OVERDRAW || render_mode == RENDER_MODE_TILE_COST);
+}
+
 int get_window_width(void) {
     return window_width;
 }
@@ -55,6 +76,25 @@ int get_window_height(void) {
     return window_height;
 }
 
+// the color and z buffer belong to the renderer, not to SDL: a window only decides how they are presented.
+static void allocate_frame_buffers(void) {
+    owned_color_buffer = (uint32_t*)malloc(sizeof(uint32_t) * window_width * window_height);
+    color_buffer = owned_color_buffer;
+    color_buffer_stride = window_width;
+    z_buffer = (float*)malloc(sizeof(float) * window_width * window_height);
+    fragment_test_counts = (uint16_t*)calloc(window_width * window_height, sizeof(uint16_t));
+    fragment_write_counts = (uint16_t*)calloc(window_width * window_height, sizeof(uint16_t));
+}
+
+// no SDL video at all: frames stay in the color buffer, see get_color_buffer().
+bool initialize_offscreen(int width, int height) {
+    window_width = width;
+    window_height = height;
+    present_mode = PRESENT_MODE_COPY;
+    allocate_frame_buffers();
+    return true;
+}
+
 bool initialize_window(void) {
     if (SDL_Init(SDL_INIT_EVERYTHING) != 0) {
         fprintf(stderr, "SDL_Init failed.");
@@ -100,6 +140,23 @@ bool initialize_window(void) {
         return false;
     }
 
+    if (is_fullscreen)
+    {
+        SDL_SetWindowFullscreen(window, SDL_WINDOW_FULLSCREEN);
+    }
+
+    // allocate the required bytes.
+    allocate_frame_buffers();
+
+    // the present thread makes the renderer its own, the main thread never touches one then.
+    if (present_mode == PRESENT_MODE_PIPELINED) {
+        if (start_present_thread(window, window_width, window_height, present_buffer_count)) {
+            return true;
+        }
+        fprintf(stderr, "presenting on the main thread instead.\n");
+        present_mode = PRESENT_MODE_COPY;
+    }
+
     renderer = SDL_CreateRenderer(
         window,
         -1, // I don't care: get the first display device.
@@ -108,14 +165,6 @@ bool initialize_window(void) {
     if (!renderer) {
         fprintf(stderr, "Error creating window.");
     }
-    if (is_fullscreen)
-    {
-        SDL_SetWindowFullscreen(window, SDL_WINDOW_FULLSCREEN);
-    }
-
-    // allocate the required bytes.
-    color_buffer = (uint32_t*)malloc(sizeof(uint32_t) * window_width * window_height);
-    z_buffer = (float*)malloc(sizeof(float) * window_width * window_height);
 
     color_buffer_texture = SDL_CreateTexture(
         renderer, 
@@ -131,12 +180,13 @@ bool initialize_window(void) {
 
 
 void draw_grid() {
+    PROFILE_SCOPE("draw_grid");
 
     // @NOTE: actual solution:
     for (int y = 0; y  < window_height; ++y) {
         for (int x = 0; x < window_width; ++x) {
             if (x % 10 == 0 || y% 10 == 0) {
-                color_buffer[(window_width * y) + x] = 0x0f333333;
+                color_buffer[(color_buffer_stride * y) + x] = 0x0f333333;
             }
         }
     }
@@ -166,11 +216,12 @@ void draw_pixel(int x, int y, uint32_t color) {
     if (x < 0 || x >= window_width || y < 0 || y >= window_height) {
         return;
     }
-    color_buffer[(window_width * y) + x] = color;
+    color_buffer[(color_buffer_stride * y) + x] = color;
 
 }
 
 void draw_rect(int start_x, int start_y, int width, int height, uint32_t color) {
+    PROFILE_SCOPE("draw_rect");
     
     if (start_y + height >= window_height) {
         return;
@@ -189,34 +240,197 @@ void draw_rect(int start_x, int start_y, int width, int height, uint32_t color)
 }
 
 void draw_triangle(int x0, int y0, int x1, int y1, int x2, int y2, uint32_t color) {
+    PROFILE_SCOPE("draw_triangle");
     draw_line(x0, y0, x1, y1, color);
     draw_line(x0, y0, x2, y2, color);
     draw_line(x1, y1, x2, y2, color);
 }
 
-// copy the color_buffer to the color_buffer_texture
+// blue, cyan, green, yellow, red for heat from 0 to 1, scaled by the brightness of the scene below it so the
+// shapes stay readable.
+static uint32_t get_heatmap_color(float heat, uint32_t scene_color) {
+    static const float stops[5][3] = { {0, 0, 255}, {0, 255, 255}, {0, 255, 0}, {255, 255, 0}, {255, 0, 0} };
+    heat = heat < 0.0f ? 0.0f : (heat > 1.0f ? 1.0f : heat) * 4.0f;
+    int stop_idx = heat >= 4.0f ? 3 : (int)heat;
+    float blend = heat - stop_idx;
+
+    // SDL_PIXELFORMAT_RGBA32 keeps red in the low byte.
+    float luma = (0.299f * (scene_color & 0xFF) + 0.587f * ((scene_color >> 8) & 0xFF) + 0.114f * ((scene_color >> 16) & 0xFF)) / 255.0f;
+    float shade = 0.5f + 0.5f * luma;
+    uint32_t color = 0xFF000000;
+    for (int channel_idx = 0; channel_idx < 3; ++channel_idx) {
+        float value = stops[stop_idx][channel_idx] + (stops[stop_idx + 1][channel_idx] - stops[stop_idx][channel_idx]) * blend;
+        color |= (uint32_t)(value * shade) << (8 * channel_idx);
+    }
+    return color;
+}
+
+// what no fragment reached (the background, the grid) fades to a dark gray.
+static uint32_t get_uncounted_color(uint32_t scene_color) {
+    uint32_t gray = (((scene_color >> 16) & 0xFF) + ((scene_color >> 8) & 0xFF) + (scene_color & 0xFF)) / 10;
+    return 0xFF000000 | (gray << 16) | (gray << 8) | gray;
+}
+
+void draw_fragment_heatmap(void) {
+    PROFILE_SCOPE("draw_fragment_heatmap");
+    if (render_mode == RENDER_MODE_OVERDRAW) {
+        for (int y = 0; y < window_height; ++y) {
+            uint32_t* row = &color_buffer[color_buffer_stride * y];
+            const uint16_t* write_counts = &fragment_write_counts[window_width * y];
+            for (int x = 0; x < window_width; ++x) {
+                row[x] = write_counts[x] == 0 ? get_uncounted_color(row[x]) :
+                    get_heatmap_color((write_counts[x] - 1) / (float)(OVERDRAW_HEATMAP_MAX - 1), row[x]);
+            }
+        }
+    } else if (render_mode == RENDER_MODE_TILE_COST) {
+        // fragments depth tested per tile, rejected ones included: they cost the barycentrics all the same.
+        int tile_count_x = (window_width + HEATMAP_TILE_SIZE - 1) / HEATMAP_TILE_SIZE;
+        int tile_count_y = (window_height + HEATMAP_TILE_SIZE - 1) / HEATMAP_TILE_SIZE;
+        int* tile_costs = (int*)calloc(tile_count_x * tile_count_y, sizeof(int));
+        for (int y = 0; y < window_height; ++y) {
+            const uint16_t* test_counts = &fragment_test_counts[window_width * y];
+            int* tile_row = &tile_costs[tile_count_x * (y / HEATMAP_TILE_SIZE)];
+            for (int x = 0; x < window_width; ++x) {
+                tile_row[x / HEATMAP_TILE_SIZE] += test_counts[x];
+            }
+        }
+        int max_tile_cost = 1;
+        for (int tile_idx = 0; tile_idx < tile_count_x * tile_count_y; ++tile_idx) {
+            max_tile_cost = tile_costs[tile_idx] > max_tile_cost ? tile_costs[tile_idx] : max_tile_cost;
+        }
+        for (int y = 0; y < window_height; ++y) {
+            uint32_t* row = &color_buffer[color_buffer_stride * y];
+            const int* tile_row = &tile_costs[tile_count_x * (y / HEATMAP_TILE_SIZE)];
+            for (int x = 0; x < window_width; ++x) {
+                int tile_cost = tile_row[x / HEATMAP_TILE_SIZE];
+                // a dark line on the edges of every tile.
+                if (x % HEATMAP_TILE_SIZE == 0 || y % HEATMAP_TILE_SIZE == 0) {
+                    row[x] = 0xFF202020;
+                } else {
+                    row[x] = tile_cost == 0 ? get_uncounted_color(row[x]) : get_heatmap_color(tile_cost / (float)max_tile_cost, row[x]);
+                }
+            }
+        }
+        free(tile_costs);
+    } else {
+        return;
+    }
+
+    // the legend, cold to hot.
+    int legend_width = 128;
+    int legend_height = 8;
+    if (legend_width + 8 >= window_width || legend_height + 8 >= window_height) {
+        return;
+    }
+    for (int y = window_height - legend_height - 8; y < window_height - 8; ++y) {
+        for (int x = 0; x < legend_width; ++x) {
+            color_buffer[(color_buffer_stride * y) + x + 8] = get_heatmap_color(x / (float)(legend_width - 1), 0xFFFFFFFF);
+        }
+    }
+}
+
+void set_present_mode(int present_mode_in) {
+    // which thread owns the renderer is settled once the window exists.
+    if (window != NULL && (present_mode == PRESENT_MODE_PIPELINED || present_mode_in == PRESENT_MODE_PIPELINED)) {
+        return;
+    }
+    present_mode = present_mode_in;
+}
+
+void set_present_buffer_count(int buffer_count) {
+    present_buffer_count = buffer_count < 2 ? 2 : (buffer_count > MAX_PRESENT_BUFFER_COUNT ? MAX_PRESENT_BUFFER_COUNT : buffer_count);
+}
+
+int get_present_mode(void) {
+    return present_mode;
+}
+
+// in PRESENT_MODE_LOCK the frame is rasterized straight into the streaming texture, so presenting it needs no copy.
+// a renderer that can not lock falls back to copying for good.
+// in PRESENT_MODE_PIPELINED the frame goes into the next free buffer of the ring, which may wait on the present thread.
+void begin_color_buffer(void) {
+    if (present_mode == PRESENT_MODE_PIPELINED) {
+        if (!is_color_buffer_acquired) {
+            color_buffer = acquire_present_buffer();
+            color_buffer_stride = window_width;
+            is_color_buffer_acquired = true;
+        }
+        return;
+    }
+    if (present_mode != PRESENT_MODE_LOCK || is_color_buffer_locked) {
+        return;
+    }
+    void* pixels = NULL;
+    int pitch = 0;
+    if (SDL_LockTexture(color_buffer_texture, NULL, &pixels, &pitch) != 0) {
+        fprintf(stderr, "SDL_LockTexture failed, presenting by copy: %s\n", SDL_GetError());
+        present_mode = PRESENT_MODE_COPY;
+        return;
+    }
+    color_buffer = (uint32_t*)pixels;
+    color_buffer_stride = pitch / (int)sizeof(uint32_t);
+    is_color_buffer_locked = true;
+}
+
+// copy the color_buffer to the color_buffer_texture, or just unlock it when the frame was drawn into the texture.
+// a pipelined frame is only queued, the present thread does the rest.
 void render_color_buffer() {
-    SDL_UpdateTexture(
-        color_buffer_texture,
-        NULL,
-        color_buffer,
-        (int)(window_width * sizeof(uint32_t))
-    );
+    PROFILE_SCOPE("render_color_buffer");
+    // offscreen, the frame is done once it is drawn.
+    if (window == NULL) {
+        return;
+    }
+    if (present_mode == PRESENT_MODE_PIPELINED) {
+        if (is_color_buffer_acquired) {
+            submit_present_buffer();
+            color_buffer = owned_color_buffer;
+            is_color_buffer_acquired = false;
+        }
+        return;
+    }
+    if (is_color_buffer_locked) {
+        SDL_UnlockTexture(color_buffer_texture);
+        // the texture pixels are gone until the next lock, anything drawn in between lands in the owned buffer.
+        color_buffer = owned_color_buffer;
+        color_buffer_stride = window_width;
+        is_color_buffer_locked = false;
+    } else {
+        SDL_UpdateTexture(
+            color_buffer_texture,
+            NULL,
+            color_buffer,
+            (int)(color_buffer_stride * sizeof(uint32_t))
+        );
+    }
     SDL_RenderCopy(renderer, color_buffer_texture, NULL, NULL);
     SDL_RenderPresent(renderer);
 }
 
+const uint32_t* get_color_buffer(int* stride) {
+    *stride = color_buffer_stride;
+    return color_buffer;
+}
+
 void clear_color_buffer(uint32_t color) {
-    for (int idx = 0; idx < window_width * window_height; ++idx) {
-        color_buffer[idx] = color;
+    PROFILE_SCOPE("clear_color_buffer");
+    for (int y = 0; y < window_height; ++y) {
+        uint32_t* row = &color_buffer[color_buffer_stride * y];
+        for (int x = 0; x < window_width; ++x) {
+            row[x] = color;
+        }
     }
 
 }
 
 void clear_z_buffer() {
+    PROFILE_SCOPE("clear_z_buffer");
     for (int idx = 0; idx < window_width * window_height; ++idx) {
             z_buffer[idx] = 1.0;
     }
+    if (should_count_fragments()) {
+        memset(fragment_test_counts, 0, sizeof(uint16_t) * window_width * window_height);
+        memset(fragment_write_counts, 0, sizeof(uint16_t) * window_width * window_height);
+    }
 
 }
 
@@ -226,7 +440,7 @@ uint32_t get_color_buffer_at(int x, int y) {
         return 1; // sentinel value of 1?
     };
 
-    return color_buffer[(window_width * y) + x];
+    return color_buffer[(color_buffer_stride * y) + x];
 
 }
 void update_color_buffer_at(int x, int y, uint32_t color) {
@@ -234,7 +448,7 @@ void update_color_buffer_at(int x, int y, uint32_t color) {
         return;
      }
 
-    color_buffer[(window_width * y) + x] = color;
+    color_buffer[(color_buffer_stride * y) + x] = color;
 }
 
 
@@ -242,24 +456,59 @@ float get_zbuffer_at(int x, int y) {
     if (x < 0 || x >= window_width || y < 0 || y >= window_height) {
         return 1.0; // sentinel value of 1?
     };
+    // every fragment is depth tested through here, and written through update_zbuffer_at().
+    if (should_count_fragments() && fragment_test_counts[(window_width * y) + x] < UINT16_MAX) {
+        fragment_test_counts[(window_width * y) + x] += 1;
+    }
     return z_buffer[(window_width * y) + x];
 }
+// pixels some triangle wrote since the z buffer was cleared.
+int count_covered_pixels(void) {
+    int covered_count = 0;
+    for (int idx = 0; idx < window_width * window_height; ++idx) {
+        covered_count += z_buffer[idx] < 1.0;
+    }
+    return covered_count;
+}
+
 void update_zbuffer_at(int x, int y, float value) {
     if (x < 0 || x >= window_width || y < 0 || y >= window_height) {
         return;
     };
 
     z_buffer[(window_width * y) + x] = value;
+    if (should_count_fragments() && fragment_write_counts[(window_width * y) + x] < UINT16_MAX) {
+        fragment_write_counts[(window_width * y) + x] += 1;
+    }
 }
 
 
 
 void destroy_window(void) {
+    if (is_present_thread_running()) {
+        present_stats_t stats = get_present_stats();
+        printf("present thread: %d frames, latency %.2f ms mean %.2f ms max, present %.2f ms, waited %.2f ms per frame.\n",
+            stats.frame_count, stats.mean_latency_ms, stats.max_latency_ms, stats.mean_present_ms, stats.mean_wait_ms);
+        stop_present_thread();
+    }
+
     // free the color and z buffer.
-    free(color_buffer);
+    if (is_color_buffer_locked) {
+        SDL_UnlockTexture(color_buffer_texture);
+    }
+    free(owned_color_buffer);
     free(z_buffer);
+    free(fragment_test_counts);
+    free(fragment_write_counts);
 
-    SDL_DestroyRenderer(renderer);
-    SDL_DestroyWindow(window);
-    SDL_Quit();
+    if (color_buffer_texture != NULL) {
+        SDL_DestroyTexture(color_buffer_texture);
+    }
+    if (renderer != NULL) {
+        SDL_DestroyRenderer(renderer);
+    }
+    if (window != NULL) {
+        SDL_DestroyWindow(window);
+        SDL_Quit();
+    }
 }
\ No newline at end of file
@@ -20,7 +20,9 @@ enum RENDER_MODE {
     RENDER_MODE_FILLED, // 3
     RENDER_MODE_FILLED_WITH_WIREFRAME,  // 4,
     RENDER_MODE_TEXTURED, // 5
-    RENDER_MODE_TEXTURED_WITH_WIREFRAME //6 
+    RENDER_MODE_TEXTURED_WITH_WIREFRAME, //6 
+    RENDER_MODE_OVERDRAW, // 7, textured, false colored by how many fragments every pixel was written.
+    RENDER_MODE_TILE_COST // 8, textured, false colored by how many fragments every tile depth tested.
 };
 
 enum CULL_MODE {
@@ -28,6 +30,12 @@ enum CULL_MODE {
     CULL_BACKFACE
 };
 
+enum PRESENT_MODE {
+    PRESENT_MODE_COPY, // rasterize into our own buffer, copied into the streaming texture when presenting.
+    PRESENT_MODE_LOCK, // rasterize into the locked streaming texture itself, honoring its pitch.
+    PRESENT_MODE_PIPELINED // rasterize into a ring of buffers presented by a thread of its own, see present.h.
+};
+
 int get_window_height(void);
 int get_window_width(void);
 
@@ -39,7 +47,11 @@ bool should_render_filled_triangles(void);
 bool should_render_textured_triangles(void);
 bool should_render_wireframe(void);
 bool should_render_wireframe_with_vertices(void);
+// the heatmap modes count the fragments of every pixel between clear_z_buffer() and draw_fragment_heatmap().
+bool should_count_fragments(void);
 bool initialize_window(void);
+// renders without a window or SDL video, for the headless renderer.
+bool initialize_offscreen(int width, int height);
 
 
 
@@ -51,8 +63,19 @@ void draw_line(int x0, int y0, int x1, int y1, uint32_t color);
 void draw_pixel(int x, int y, uint32_t color);
 void draw_rect(int start_x, int start_y, int width, int height, uint32_t color);
 void draw_triangle(int x0, int y0, int x1, int y1, int x2, int y2, uint32_t color);
-
+// false colors the frame drawn so far with the fragment counts of the heatmap modes, with a legend bottom left.
+void draw_fragment_heatmap(void);
+
+// PRESENT_MODE_PIPELINED has to be picked before initialize_window(), and can not be left afterwards.
+void set_present_mode(int present_mode);
+int get_present_mode(void);
+// 2 for double, 3 for triple buffering in PRESENT_MODE_PIPELINED.
+void set_present_buffer_count(int buffer_count);
+// call before the first draw of a frame, render_color_buffer() ends it.
+void begin_color_buffer(void);
 void render_color_buffer(void);
+// the frame as drawn, stride in pixels. only stays valid after render_color_buffer() offscreen or in PRESENT_MODE_COPY.
+const uint32_t* get_color_buffer(int* stride);
 void clear_color_buffer(uint32_t color);
 void clear_z_buffer();
 
@@ -61,6 +84,7 @@ void update_color_buffer_at(int x, int y, uint32_t color);
 
 float get_zbuffer_at(int x, int y);
 void update_zbuffer_at(int x, int y, float value);
+int count_covered_pixels(void);
 
 void destroy_window(void);
 
@@ -0,0 +1,160 @@
+#include "job.h"
+#include "profile.h"
+#include <stdio.h>
+#include <assert.h>
+#include <SDL2/SDL.h>
+
+typedef struct {
+    job_function_t function;
+    void* data;
+} job_t;
+
+// ring buffer of queued jobs, guarded by job_mutex.
+static job_t job_queue[MAX_JOB_COUNT];
+static int job_queue_head = 0;
+static int job_queue_count = 0;
+
+// jobs that were submitted but have not finished yet (queued + running).
+static int jobs_in_flight = 0;
+
+static SDL_mutex* job_mutex = NULL;
+static SDL_cond* job_available = NULL; // signaled when a job is queued or on shutdown.
+static SDL_cond* job_slot_free = NULL; // signaled when a job leaves the queue.
+static SDL_cond* jobs_done = NULL; // signaled when jobs_in_flight drops to zero.
+
+static SDL_Thread* workers[MAX_WORKER_COUNT];
+static int worker_count = 0;
+static bool is_shutting_down = false;
+
+static int worker_main(void* unused) {
+    (void)unused;
+    PROFILE_THREAD_NAME("worker");
+
+    SDL_LockMutex(job_mutex);
+    while (true) {
+        while (job_queue_count == 0 && !is_shutting_down) {
+            SDL_CondWait(job_available, job_mutex);
+        }
+        if (job_queue_count == 0 && is_shutting_down) {
+            break;
+        }
+
+        job_t job = job_queue[job_queue_head];
+        job_queue_head = (job_queue_head + 1) % MAX_JOB_COUNT;
+        job_queue_count -= 1;
+        SDL_CondSignal(job_slot_free);
+        SDL_UnlockMutex(job_mutex);
+
+        {
+            PROFILE_SCOPE("job");
+            job.function(job.data);
+        }
+
+        SDL_LockMutex(job_mutex);
+        jobs_in_flight -= 1;
+        if (jobs_in_flight == 0) {
+            SDL_CondBroadcast(jobs_done);
+        }
+    }
+    SDL_UnlockMutex(job_mutex);
+
+    return 0;
+}
+
+bool init_job_system(int requested_worker_count) {
+    assert(worker_count == 0 && "job system is already running.");
+
+    if (requested_worker_count <= 0) {
+        requested_worker_count = SDL_GetCPUCount() - 1;
+    }
+    if (requested_worker_count < 1) {
+        requested_worker_count = 1;
+    }
+    if (requested_worker_count > MAX_WORKER_COUNT) {
+        requested_worker_count = MAX_WORKER_COUNT;
+    }
+
+    job_mutex = SDL_CreateMutex();
+    job_available = SDL_CreateCond();
+    job_slot_free = SDL_CreateCond();
+    jobs_done = SDL_CreateCond();
+    if (!job_mutex || !job_available || !job_slot_free || !jobs_done) {
+        fprintf(stderr, "Error creating job system synchronization primitives.\n");
+        destroy_job_system();
+        return false;
+    }
+
+    is_shutting_down = false;
+    for (int worker_idx = 0; worker_idx < requested_worker_count; ++worker_idx) {
+        SDL_Thread* worker = SDL_CreateThread(worker_main, "job worker", NULL);
+        if (worker == NULL) {
+            fprintf(stderr, "Error creating job worker thread: %s\n", SDL_GetError());
+            break;
+        }
+        workers[worker_count] = worker;
+        worker_count += 1;
+    }
+
+    return worker_count > 0;
+}
+
+void destroy_job_system(void) {
+    if (job_mutex) {
+        SDL_LockMutex(job_mutex);
+        is_shutting_down = true;
+        SDL_CondBroadcast(job_available);
+        SDL_UnlockMutex(job_mutex);
+    }
+
+    // workers drain the queue before they exit.
+    for (int worker_idx = 0; worker_idx < worker_count; ++worker_idx) {
+        SDL_WaitThread(workers[worker_idx], NULL);
+    }
+    worker_count = 0;
+
+    SDL_DestroyCond(jobs_done);
+    SDL_DestroyCond(job_slot_free);
+    SDL_DestroyCond(job_available);
+    SDL_DestroyMutex(job_mutex);
+    jobs_done = NULL;
+    job_slot_free = NULL;
+    job_available = NULL;
+    job_mutex = NULL;
+}
+
+void submit_job(job_function_t function, void* data) {
+    if (worker_count == 0) {
+        function(data);
+        return;
+    }
+
+    SDL_LockMutex(job_mutex);
+    while (job_queue_count == MAX_JOB_COUNT) {
+        SDL_CondWait(job_slot_free, job_mutex);
+    }
+
+    int tail = (job_queue_head + job_queue_count) % MAX_JOB_COUNT;
+    job_queue[tail].function = function;
+    job_queue[tail].data = data;
+    job_queue_count += 1;
+    jobs_in_flight += 1;
+
+    SDL_CondSignal(job_available);
+    SDL_UnlockMutex(job_mutex);
+}
+
+void wait_for_jobs(void) {
+    if (worker_count == 0) {
+        return;
+    }
+
+    SDL_LockMutex(job_mutex);
+    while (jobs_in_flight > 0) {
+        SDL_CondWait(jobs_done, job_mutex);
+    }
+    SDL_UnlockMutex(job_mutex);
+}
+
+int get_worker_count(void) {
+    return worker_count;
+}
@@ -0,0 +1,32 @@
+#ifndef JOB_H
+#define JOB_H
+
+#include <stdbool.h>
+
+// a small pool of worker threads that runs fire-and-forget jobs.
+// jobs must not touch the SDL video / render API, only plain memory and files.
+typedef void (*job_function_t)(void* data);
+
+#define MAX_JOB_COUNT 256
+#define MAX_WORKER_COUNT 16
+
+// worker_count <= 0 picks one worker per cpu core, minus the main thread.
+bool init_job_system(int worker_count);
+void destroy_job_system(void);
+
+// queue a job. if the job system is not running, the job runs immediately on the calling thread.
+void submit_job(job_function_t function, void* data);
+
+// completion barrier: blocks until every submitted job has finished.
+void wait_for_jobs(void);
+
+int get_worker_count(void);
+
+// state a job keeps per thread instead of behind a lock, the workers and the main thread each get their own.
+#if defined(_MSC_VER)
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+#endif
@@ -26,4 +26,13 @@ uint32_t light_apply_intensity(uint32_t original_color, float percentage_factor)
     uint32_t new_color = a | (r & 0x00FF0000) |  (g & 0x0000FF00) | (b & 0x000000FF);
 
     return new_color;
-}
\ No newline at end of file
+}
+
+uint32_t color_apply_tint(uint32_t original_color, uint32_t tint) {
+    uint32_t a = (((original_color >> 24) & 0xFF) * ((tint >> 24) & 0xFF)) / 255;
+    uint32_t r = (((original_color >> 16) & 0xFF) * ((tint >> 16) & 0xFF)) / 255;
+    uint32_t g = (((original_color >> 8) & 0xFF) * ((tint >> 8) & 0xFF)) / 255;
+    uint32_t b = ((original_color & 0xFF) * (tint & 0xFF)) / 255;
+
+    return (a << 24) | (r << 16) | (g << 8) | b;
+}
@@ -8,6 +8,8 @@ typedef struct {
 } light_t;
 
 uint32_t light_apply_intensity(uint32_t original_color, float percentage_factor);
+// multiply two colors channel by channel, 0xFFFFFFFF leaves the original color untouched.
+uint32_t color_apply_tint(uint32_t original_color, uint32_t tint);
 
 void init_light(vec3_t direction);
 
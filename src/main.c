@@ -1,7 +1,10 @@
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 #include <stdint.h>
+#include <math.h>
 #include "upng.h"
 
 // We need to tell SDL that we are doing the main instead of SDL.
@@ -18,19 +21,71 @@
 #include "camera.h"
 #include "clipping.h"
 #include "mesh.h"
+#include "job.h"
+#include "occlusion.h"
+#include "bvh.h"
+#include "stream.h"
+#include "vtexture.h"
+#include "bundle.h"
+#include "capture.h"
+#include "benchmark.h"
+#include "profile.h"
+#include "stats.h"
+#include "perf.h"
+#include "stress_scene.h"
 // Pressing “1” displays the wireframe and a small red dot for each triangle vertex
 // Pressing “2” displays only the wireframe lines
 // Pressing “3” displays filled triangles with a solid color
 // Pressing “4” displays both filled triangles and wireframe lines
+// Pressing “7” false colors the textured scene by how many fragments every pixel was written (overdraw)
+// Pressing “8” false colors it by how many fragments every 32x32 tile depth tested, relative to the busiest tile
 // Pressing “c” we should enable back-face culling
 // Pressing “d” we should disable the back-face culling
-
-#define MAX_TRIANGLES_PER_MESH 10000
-triangle_t triangles_to_render[MAX_TRIANGLES_PER_MESH];
-int triangles_to_render_count = 0;
+// Pressing “o” toggles occlusion culling
+// Pressing “t” cycles the texture storage between RGBA8, BC1 and BC3
+// Pressing “p” switches between drawing into the locked SDL texture and copying into it
+// Pressing “i” prints the pipeline counters of the last frame (see stats.h)
+//
+// renderer [scene.cells] streams an out of core scene (see stream.h) around the camera on top of the meshes.
+// renderer --present-buffers=2|3 presents on a thread of its own (see present.h), double or triple buffered.
+// renderer [scene.bundle] takes the meshes and textures from an asset bundle (see bundle.h) instead of loose files.
+// renderer --headless [--size=WxH] [--frames=N] [--output=frame.png|frame_%04d.png|-] renders without a window or
+// SDL video driver and writes the frames out (see capture.h), after the meshes are loaded. --frames=N quits after N
+// frames in any mode. the headless build defines RENDERER_HEADLESS to make that the default, on linux:
+//     cc src/*.c -D RENDERER_HEADLESS -I include/ -std=c99 -O2 -o renderer_headless -lSDL2 -lm -lpthread
+// renderer --benchmark[=path.camera] [--warmup=N] [--frames=N] [--render-mode=1..8] [--benchmark-out=prefix]
+//          [--baseline=old.json] [--regression-threshold=percent] flies the camera path (see benchmark.h) at a fixed
+// timestep without the frame cap, records N frames after the warmup and writes prefix.json and prefix.csv.
+// every load the frames start waits for the frame to end, outside the timings, so runs see the same frames.
+// exits with 2 when a stage got slower than the baseline allows.
+// renderer --stats prints the pipeline counters of every frame, benchmarks print their averages over the run.
+// renderer --benchmark --perf adds the hardware counters of every stage (see perf.h): cycles, instructions, IPC,
+// cache and branch misses per frame, per face in the geometry stage and per fragment in the rasterizer. linux only.
+// renderer --scene=grid=N,sphere=N,planes=N,overdraw=N,micro=N loads a procedural stress scene (see stress_scene.h)
+// instead of the aircraft: N f22 instances on a grid, a sphere of N triangles, N planes crossing the near plane,
+// N stacked quads, a micro triangle grid of N triangles. any subset of the knobs, e.g. --benchmark --scene=sphere=50000.
+// renderer --trace=trace.json writes the last frames as a Chrome trace on exit, in a build that defines
+// RENDERER_PROFILE (see profile.h).
+
+// dynamic array, cleared every frame but never shrunk.
+triangle_t* triangles_to_render = NULL;
+// scratch space for one instance's vertices in camera space.
+vec4_t* view_space_vertices = NULL;
+// instances in the view frustum this frame, from the scene BVH.
+bvh_item_t* visible_instances = NULL;
 
 
 bool is_running = false;
+#if defined(RENDERER_HEADLESS)
+bool is_headless = true;
+#else
+bool is_headless = false;
+#endif
+int frame_limit = -1; // frames to render before quitting, -1 runs until the window is closed.
+bool is_benchmark = false;
+bool has_stress_scene = false;
+stress_scene_t stress_scene;
+float benchmark_time = 0; // seconds along the camera path.
 int previous_frame_time = 0;
 float delta_time = 0;
 
@@ -55,6 +110,12 @@ void setup() {
     float z_far = 100.0;
     projection_matrix = mat4_make_perspective(fovy, aspect_ratio_y, z_near, z_far);
     init_frustrum_planes(fovx, fovy, z_near, z_far);
+    init_occlusion_culling(projection_matrix, z_near);
+
+    if (has_stress_scene) {
+        load_stress_scene(&stress_scene);
+        return;
+    }
 
     // Loads mesh entities
     load_mesh("./assets/runway.obj", "./assets/runway.png", vec3_new(1, 1, 1), vec3_new(0, -1.5, +23), vec3_new(0, 0, 0));
@@ -62,6 +123,9 @@ void setup() {
     load_mesh("./assets/efa.obj", "./assets/efa.png", vec3_new(1, 1, 1), vec3_new(-2, -1.3, +9), vec3_new(0, -M_PI/2, 0));
     load_mesh("./assets/f117.obj", "./assets/f117.png", vec3_new(1, 1, 1), vec3_new(+2, -1.3, +9), vec3_new(0, -M_PI/2, 0));
 
+    // the loads above run on the job system: meshes show up as soon as their geometry is parsed,
+    // and get their texture once it is decoded. the main loop never waits for them.
+
 }
 
 void process_input() {
@@ -170,6 +234,16 @@ void process_input() {
                     set_render_mode( RENDER_MODE_TEXTURED_WITH_WIREFRAME);
                     break;
 
+                }
+                if (event.key.keysym.sym == SDLK_7) {
+                    set_render_mode( RENDER_MODE_OVERDRAW);
+                    break;
+
+                }
+                if (event.key.keysym.sym == SDLK_8) {
+                    set_render_mode( RENDER_MODE_TILE_COST);
+                    break;
+
                 }
                 if (event.key.keysym.sym == SDLK_c) {
                     set_cull_mode(CULL_BACKFACE);
@@ -180,6 +254,28 @@ void process_input() {
                     set_cull_mode(CULL_NONE);
                     break;
                 }
+                if (event.key.keysym.sym == SDLK_o) {
+                    set_occlusion_culling(!is_occlusion_culling_enabled());
+                    break;
+                }
+                if (event.key.keysym.sym == SDLK_p && get_present_mode() != PRESENT_MODE_PIPELINED) {
+                    set_present_mode(get_present_mode() == PRESENT_MODE_LOCK ? PRESENT_MODE_COPY : PRESENT_MODE_LOCK);
+                    printf("present mode: %s\n", get_present_mode() == PRESENT_MODE_LOCK ? "lock" : "copy");
+                    break;
+                }
+                if (event.key.keysym.sym == SDLK_i) {
+                    pipeline_stats_t stats = get_pipeline_stats();
+                    print_pipeline_stats(&stats, 1);
+                    // the next frames count their covered pixels too.
+                    set_pixel_coverage_counting(true);
+                    break;
+                }
+                // cycles the texture storage: 32 bit texels, BC1, BC3. textures decode again in the new form when sampled.
+                if (event.key.keysym.sym == SDLK_t) {
+                    set_texture_block_format((get_texture_block_format() + 1) % BLOCK_FORMAT_COUNT);
+                    printf("texture storage: %s\n", get_block_format_name(get_texture_block_format()));
+                    break;
+                }
             }
 
             default:
@@ -219,8 +315,9 @@ void process_input() {
 //                             +--------------+
 ///////////////////////////////////////////////////////////////////////////////
 
-void process_graphics_pipeline_stages(mesh_t* mesh) {
-        // compute the new camera rotation and translation for the fps camera movement.
+// compute the new camera rotation and translation for the fps camera movement.
+// the view matrix is the same for every mesh and instance, so it is built once per frame.
+void update_view_matrix(void) {
         vec3_t up_direction = {0.0, 1.0, 0.0};
         
         // find the target direction.
@@ -237,65 +334,176 @@ void process_graphics_pipeline_stages(mesh_t* mesh) {
         target = vec3_add(get_camera_position(), get_camera_direction());
 
         view_matrix = mat4_look_at(get_camera_position(), target, up_direction);
+}
 
-        mat4_t translation_matrix = mat4_make_translate(mesh->translation.x, mesh->translation.y, mesh->translation.z);
-        mat4_t scale_matrix = mat4_make_scale(mesh->scale.x, mesh->scale.y, mesh->scale.z);
-        mat4_t rotation_matrix_x = mat4_make_rotation_x(
-            mesh->rotation.x
-        );
-        mat4_t rotation_matrix_y = mat4_make_rotation_y(
-            mesh->rotation.y
-        );
-        mat4_t rotation_matrix_z = mat4_make_rotation_z(
-            mesh->rotation.z
-        );
+// the transforms of one instance, and its bounding sphere in camera space.
+typedef struct {
+    mat4_t rotation_matrix;
+    mat4_t model_view_matrix;
+    vec3_t view_center;
+    float radius;
+    float screen_radius; // in window pixels, INFINITY when the camera is inside the sphere.
+} instance_transform_t;
+
+instance_transform_t make_instance_transform(geometry_t* geometry, mesh_instance_t* instance) {
+        instance_transform_t transform;
+        transform.rotation_matrix = get_mesh_instance_rotation_matrix(instance);
+        mat4_t world_matrix = get_mesh_instance_world_matrix(instance);
+        // straight from model to (view / camera) space.
+        transform.model_view_matrix = mat4_mul_mat4(view_matrix, world_matrix);
+
+        transform.view_center = vec3_from_vec4(mat4_mul_vec4(transform.model_view_matrix, vec4_from_vec3(geometry->bounds_center)));
+        float max_scale = fmaxf(fabsf(instance->scale.x), fmaxf(fabsf(instance->scale.y), fabsf(instance->scale.z)));
+        transform.radius = geometry->bounds_radius * max_scale;
+        transform.screen_radius = INFINITY;
+        if (transform.view_center.z > transform.radius) {
+            transform.screen_radius = transform.radius * projection_matrix.m[1][1] / transform.view_center.z * (get_window_height() / 2.0);
+        }
+        return transform;
+}
 
+// transform every vertex of a level once into camera space, faces share them.
+void transform_lod_vertices(geometry_lod_t* lod, mat4_t model_view_matrix) {
+        int vertex_count = array_length(lod->vertices);
+        if (array_length(view_space_vertices) < vertex_count) {
+            view_space_vertices = array_hold(view_space_vertices, vertex_count - array_length(view_space_vertices), sizeof(vec4_t));
+        }
+        for (int vertex_idx = 0; vertex_idx < vertex_count; ++vertex_idx) {
+            view_space_vertices[vertex_idx] = mat4_mul_vec4(model_view_matrix, vec4_from_vec3(lod->vertices[vertex_idx]));
+        }
+}
 
-        int face_count = array_length(mesh->faces);
-        // loop over faces
-        for (int face_idx = 0; face_idx < face_count; ++face_idx) {
-            //@NOTE(SJM): for now, just do one triangle
-            face_t mesh_face = mesh->faces[face_idx];
+typedef struct {
+    geometry_t* geometry;
+    mesh_instance_t* instance;
+    float screen_radius;
+} occluder_t;
+
+// depth-only pass over the visible instances that cover the most screen, before the geometry stage.
+// uses the level of detail the instance was drawn with last frame.
+void render_occluders(void) {
+    PROFILE_SCOPE("render_occluders");
+    clear_occlusion_buffer();
+    if (!is_occlusion_culling_enabled()) {
+        return;
+    }
 
-            vec3_t face_vertices[3];
-            face_vertices[0] = mesh->vertices[mesh_face.a];
-            face_vertices[1] = mesh->vertices[mesh_face.b];
-            face_vertices[2] = mesh->vertices[mesh_face.c];
+    // keep the biggest ones, sorted by projected size.
+    occluder_t occluders[MAX_OCCLUDER_COUNT];
+    int occluder_count = 0;
+    for (int visible_idx = 0; visible_idx < array_length(visible_instances); ++visible_idx) {
+        mesh_t* mesh = get_mesh(visible_instances[visible_idx].mesh_idx);
+        mesh_instance_t* instance = &mesh->instances[visible_instances[visible_idx].instance_idx];
+        instance_transform_t transform = make_instance_transform(mesh->geometry, instance);
+        if (transform.screen_radius < OCCLUDER_MIN_SCREEN_RADIUS || transform.view_center.z + transform.radius < 0.0) {
+            continue;
+        }
+        int slot = occluder_count < MAX_OCCLUDER_COUNT ? occluder_count++ : MAX_OCCLUDER_COUNT;
+        while (slot > 0 && occluders[slot - 1].screen_radius < transform.screen_radius) {
+            if (slot < MAX_OCCLUDER_COUNT) {
+                occluders[slot] = occluders[slot - 1];
+            }
+            slot -= 1;
+        }
+        if (slot < MAX_OCCLUDER_COUNT) {
+            occluders[slot] = (occluder_t){ mesh->geometry, instance, transform.screen_radius };
+        }
+    }
 
-            vec4_t transformed_vertices[3]; 
+    for (int occluder_idx = 0; occluder_idx < occluder_count; ++occluder_idx) {
+        occluder_t* occluder = &occluders[occluder_idx];
+        instance_transform_t transform = make_instance_transform(occluder->geometry, occluder->instance);
+        geometry_lod_t* lod = &occluder->geometry->lods[occluder->instance->lod];
+        transform_lod_vertices(lod, transform.model_view_matrix);
+        for (int face_idx = 0; face_idx < array_length(lod->faces); ++face_idx) {
+            face_t face = lod->faces[face_idx];
+            rasterize_occluder_triangle(view_space_vertices[face.a], view_space_vertices[face.b], view_space_vertices[face.c]);
+        }
+    }
+}
 
-            // for all three vertices 
-            for (int vertex_idx = 0; vertex_idx <3; ++vertex_idx){
+// what the triangles of an instance sample, at most one of them is set. none draws the instance flat shaded.
+typedef struct {
+    upng_t* texture;
+    compressed_texture_t* compressed_texture;
+    virtual_texture_t* virtual_texture;
+} instance_textures_t;
+
+// only textured render modes pay for a decoded texture. until it is resident the instance is drawn flat shaded.
+instance_textures_t acquire_instance_textures(texture_t* texture, virtual_texture_t* virtual_texture) {
+    instance_textures_t textures = { NULL, NULL, NULL };
+    if (!should_render_textured_triangles()) {
+        return textures;
+    }
+    if (is_virtual_texture_ready(virtual_texture)) {
+        textures.virtual_texture = virtual_texture;
+    } else if (get_texture_block_format() != BLOCK_FORMAT_NONE) {
+        textures.compressed_texture = acquire_compressed_texture(texture);
+    } else {
+        textures.texture = acquire_texture(texture);
+    }
+    return textures;
+}
 
-                vec4_t transformed_vertex = vec4_from_vec3(face_vertices[vertex_idx]);
+// queues the decodes the first frame would, so a caller that waits for the jobs gets a first frame already textured.
+void acquire_mesh_textures(void) {
+    for (int mesh_idx = 0; mesh_idx < get_mesh_count(); ++mesh_idx) {
+        mesh_t* mesh = get_mesh(mesh_idx);
+        acquire_instance_textures(mesh->texture, mesh->virtual_texture);
+    }
+}
 
-                mat4_t world_matrix = mat4_identity();
-                world_matrix = mat4_mul_mat4(world_matrix, scale_matrix);
-                world_matrix = mat4_mul_mat4(rotation_matrix_z, world_matrix);
-                world_matrix = mat4_mul_mat4(rotation_matrix_y, world_matrix);
-                world_matrix = mat4_mul_mat4(rotation_matrix_x, world_matrix);
-                world_matrix = mat4_mul_mat4(translation_matrix, world_matrix);
-                transformed_vertex = mat4_mul_vec4(world_matrix, transformed_vertex);
+void process_mesh_instance(geometry_t* geometry, mesh_instance_t* instance, instance_textures_t textures) {
+        instance_transform_t transform = make_instance_transform(geometry, instance);
+        pipeline_stats_t* stats = get_frame_pipeline_stats();
+        stats->instances_processed += 1;
 
-                // transform to (view / camera) space  by multiplying with view matrix.
-                transformed_vertex = mat4_mul_vec4(view_matrix, transformed_vertex);
-                
-                transformed_vertices[vertex_idx]  = transformed_vertex;
-            }
+        // hidden behind the occluders, skip the whole geometry stage.
+        if (is_sphere_occluded(transform.view_center, transform.radius)) {
+            stats->instances_occluded += 1;
+            return;
+        }
 
+        // pick the level of detail from the size of the bounding sphere on screen.
+        instance->lod = select_geometry_lod(geometry, instance->lod, transform.screen_radius);
+        geometry_lod_t* lod = &geometry->lods[instance->lod];
+
+        // move the camera into object space instead of every face normal into camera space:
+        // undo the translation, rotate by the transposed rotation, then undo the scale.
+        vec3_t camera_offset = vec3_sub(get_camera_position(), instance->translation);
+        vec3_t object_camera = vec3_from_vec4(mat4_mul_vec4(mat4_transpose(transform.rotation_matrix), vec4_from_vec3(camera_offset)));
+        object_camera.x /= instance->scale.x;
+        object_camera.y /= instance->scale.y;
+        object_camera.z /= instance->scale.z;
+        // a mirroring scale flips the winding of every face.
+        float winding = (instance->scale.x * instance->scale.y * instance->scale.z) < 0.0 ? -1.0 : 1.0;
+
+        transform_lod_vertices(lod, transform.model_view_matrix);
+
+        int face_count = array_length(lod->faces);
+        stats->faces_processed += face_count;
+        // loop over faces
+        for (int face_idx = 0; face_idx < face_count; ++face_idx) {
+            face_t mesh_face = lod->faces[face_idx];
 
-            vec3_t face_normal = get_triangle_normal(transformed_vertices);
             // backface culling.
             if ( should_cull_backface()) {
-                vec3_t origin = {0.0,0.0,0.0};
-                vec3_t camera_ray_vector = vec3_sub(origin, vec3_from_vec4(transformed_vertices[0]));
-                float dot_normal_camera = vec3_dot(face_normal, camera_ray_vector);
+                vec3_t camera_ray_vector = vec3_sub(object_camera, lod->vertices[mesh_face.a]);
+                float dot_normal_camera = winding * vec3_dot(lod->face_normals[face_idx], camera_ray_vector);
                 if (dot_normal_camera < 0.0) {
+                        stats->faces_backface_culled += 1;
                         continue;
 
                 }
             }
 
+            vec4_t transformed_vertices[3]; 
+            transformed_vertices[0] = view_space_vertices[mesh_face.a];
+            transformed_vertices[1] = view_space_vertices[mesh_face.b];
+            transformed_vertices[2] = view_space_vertices[mesh_face.c];
+
+            vec3_t face_normal = get_triangle_normal(transformed_vertices);
+
             // create a polygon from the original transformed triangle to be clipped.
             polygon_t polygon  = create_polygon_from_triangle(
                 vec3_from_vec4(transformed_vertices[0]),
@@ -306,7 +514,12 @@ void process_graphics_pipeline_stages(mesh_t* mesh) {
                 mesh_face.c_uv
                 );
 
-            clip_polygon(&polygon);
+            bool is_clipped = clip_polygon(&polygon);
+            if (polygon.vertex_count < 3) {
+                stats->faces_frustum_rejected += 1;
+                continue;
+            }
+            stats->faces_clipped += is_clipped;
 
             // break the clipped polygon apart back into individual triangles.
             triangle_t triangles_after_clipping[MAX_POLYGON_VERTEX_COUNT];
@@ -314,6 +527,7 @@ void process_graphics_pipeline_stages(mesh_t* mesh) {
 
             // triangulate the polygon.
             triangles_from_polygon(&polygon, triangles_after_clipping, &triangle_count_after_clipping);
+            stats->triangles_emitted += triangle_count_after_clipping;
 
             // loop over all the assembled triangles after clipping
             for (int t = 0; t != triangle_count_after_clipping; ++t) {
@@ -357,60 +571,116 @@ void process_graphics_pipeline_stages(mesh_t* mesh) {
                         {triangle_after_clipping.texcoords[1].u, triangle_after_clipping.texcoords[1].v},
                         {triangle_after_clipping.texcoords[2].u, triangle_after_clipping.texcoords[2].v}
                     },
-                    .color = light_apply_intensity(mesh_face.color, light_intensity_vector),
-                    .texture= mesh->texture
+                    .color = light_apply_intensity(color_apply_tint(mesh_face.color, instance->color), light_intensity_vector),
+                    .texture= textures.texture,
+                    .compressed_texture = textures.compressed_texture,
+                    .virtual_texture = textures.virtual_texture
                 };
 
                 // save the projected triangle in the array of triangles to render.
-                if (triangles_to_render_count < MAX_TRIANGLES_PER_MESH) {
-                    triangles_to_render[triangles_to_render_count] = triangle_to_render;
-                    triangles_to_render_count += 1;
-                } else{
-                    assert(false && "TOO MANY TRIANGLES!");
-                }
+                array_push(triangles_to_render, triangle_to_render);
             }
         }
 }
 
-void update() {
+// only the instances the scene BVH found in the frustum run through the pipeline.
+void process_graphics_pipeline_stages(void) {
+        PROFILE_SCOPE("process_graphics_pipeline_stages");
+        int previous_mesh_idx = -1;
+        instance_textures_t mesh_textures = { NULL, NULL, NULL };
 
-    int time_to_wait = FRAME_TARGET_TIME_MS - (SDL_GetTicks() - previous_frame_time);
+        for (int visible_idx = 0; visible_idx < array_length(visible_instances); ++visible_idx) {
+            bvh_item_t item = visible_instances[visible_idx];
+            mesh_t* mesh = get_mesh(item.mesh_idx);
 
-    if (time_to_wait > 0 && time_to_wait <= FRAME_TARGET_TIME_MS) {
-        SDL_Delay(time_to_wait);
-    }
+            // instances of a mesh tend to sit next to each other in the tree, so the texture is looked up once per run.
+            if (item.mesh_idx != previous_mesh_idx) {
+                mesh_textures = acquire_instance_textures(mesh->texture, mesh->virtual_texture);
+                previous_mesh_idx = item.mesh_idx;
+            }
+            process_mesh_instance(mesh->geometry, &mesh->instances[item.instance_idx], mesh_textures);
+        }
+}
 
-    // Get a delta time factor converted to seconds to be used to update our game objects.
-    // /1000 because we get ms back from SDL.
-    delta_time = (SDL_GetTicks() - previous_frame_time) / 1000.0;
+// streamed cells are already in world space. only the resident ones exist as far as the pipeline is concerned.
+void process_stream_cells(void) {
+        PROFILE_SCOPE("process_stream_cells");
+        for (int cell_idx = 0; cell_idx < get_resident_stream_cell_count(); ++cell_idx) {
+            stream_cell_t* cell = get_resident_stream_cell(cell_idx);
+            vec3_t view_center = vec3_from_vec4(mat4_mul_vec4(view_matrix, vec4_from_vec3(cell->geometry.bounds_center)));
+            if (is_sphere_outside_frustum(view_center, cell->geometry.bounds_radius)) {
+                continue;
+            }
 
-    // how many miliseconds have passed since the last frame?
-    previous_frame_time = SDL_GetTicks();
+            process_mesh_instance(&cell->geometry, &cell->instance, acquire_instance_textures(cell->texture, NULL));
+        }
+}
 
-    // initialize the counter of triangles to render for the current frame.
-    //@NOTE(SJM): we are moving to a static array of triangles to render.
-    triangles_to_render_count = 0;
-    // loop over all the meshes.
-    for (int mesh_idx =0; mesh_idx != get_mesh_count(); ++mesh_idx) {
-        mesh_t* mesh = get_mesh(mesh_idx);
+void update() {
+    if (is_benchmark) {
+        // a fixed timestep and no cap: frame N sees the same camera in every run, as fast as it renders.
+        delta_time = 1.0 / FPS;
+        vec3_t camera_position = get_camera_position();
+        float camera_yaw = get_camera_yaw();
+        float camera_pitch = get_camera_pitch();
+        sample_camera_path(benchmark_time, &camera_position, &camera_yaw, &camera_pitch);
+        set_camera_position(camera_position);
+        set_camera_yaw(camera_yaw);
+        set_camera_pitch(camera_pitch);
+        benchmark_time += delta_time;
+    } else if (is_headless) {
+        // nobody is watching: the same fixed timestep, so frame N comes out the same in every run.
+        delta_time = 1.0 / FPS;
+    } else {
+        int time_to_wait = FRAME_TARGET_TIME_MS - (SDL_GetTicks() - previous_frame_time);
+
+        if (time_to_wait > 0 && time_to_wait <= FRAME_TARGET_TIME_MS) {
+            SDL_Delay(time_to_wait);
+        }
 
-        // change the mesh scale /rotation values per animation frame.
-        // 0.6 radians per second.
-        // mesh->rotation.x += 0.6 * delta_time;
-        // mesh->rotation.y += 0.6 * delta_time;
-        // mesh->rotation.z += 0.6 * delta_time;
-        // mesh->scale.x += 0.0002;
-        // mesh->scale.y += 0.0002;
-        // translate the vertex away from the camera.
-        // mesh->translation.x += 0.001;
-        // mesh->translation.z = 4.0;
-        process_graphics_pipeline_stages(mesh);
+        // Get a delta time factor converted to seconds to be used to update our game objects.
+        // /1000 because we get ms back from SDL.
+        delta_time = (SDL_GetTicks() - previous_frame_time) / 1000.0;
+
+        // how many miliseconds have passed since the last frame?
+        previous_frame_time = SDL_GetTicks();
     }
+    begin_benchmark_frame();
+    begin_pipeline_stats_frame();
+    PROFILE_SCOPE("update");
+
+    // initialize the counter of triangles to render for the current frame.
+    array_clear(triangles_to_render);
+
+    // evict textures the previous frames stopped sampling, before this frame acquires any.
+    update_texture_residency();
+    // misses the rasterizer recorded last frame become page reads.
+    update_virtual_textures();
+
+    // change the mesh scale /rotation values per animation frame through set_mesh_instance_transform(),
+    // so the scene BVH is refit. e.g. 0.6 radians per second:
+    // mesh_instance_t* instance = &get_mesh(0)->instances[0];
+    // set_mesh_instance_transform(0, 0, instance->scale, instance->translation, vec3_add(instance->rotation, vec3_new(0.0, 0.6 * delta_time, 0.0)));
+
+    // picks up meshes that finished loading and refits moved instances.
+    update_scene_bvh();
+    update_view_matrix();
+    update_scene_stream(get_camera_position());
+    query_scene_bvh_frustum(mat4_mul_mat4(projection_matrix, view_matrix), &visible_instances);
+    end_benchmark_stage(BENCHMARK_STAGE_UPDATE);
+
+    render_occluders();
+    end_benchmark_stage(BENCHMARK_STAGE_OCCLUSION);
+    process_graphics_pipeline_stages();
+    process_stream_cells();
+    end_benchmark_stage(BENCHMARK_STAGE_GEOMETRY);
 }
 
 void render(void) {
+    PROFILE_SCOPE("render");
     // SDL_SetRenderDrawColor(renderer, 255, 0, 0, 0);
     // SDL_RenderClear(renderer);
+    begin_color_buffer();
     clear_color_buffer(0xff000000);
     clear_z_buffer();
 
@@ -420,7 +690,7 @@ void render(void) {
 
     //@SPEED: this evaluates render_mode linear amount of times for the number of triangles.
     // not really necessary, but otherwise there is some ugly code duplication.
-    for (int triangle_idx = 0; triangle_idx < triangles_to_render_count; ++triangle_idx) {
+    for (int triangle_idx = 0; triangle_idx < array_length(triangles_to_render); ++triangle_idx) {
         triangle_t triangle = triangles_to_render[triangle_idx];
 
         // filled
@@ -442,8 +712,25 @@ void render(void) {
                 triangle.points[2].w,
                 triangle.color);
         }
-        // textured
-        if (should_render_textured_triangles()) {
+        // textured, or flat shaded while the texture is still being decoded.
+        if (should_render_textured_triangles() && triangle.texture == NULL && triangle.compressed_texture == NULL && triangle.virtual_texture == NULL) {
+            draw_filled_triangle(
+                triangle.points[0].x,
+                triangle.points[0].y,
+                triangle.points[0].z,
+                triangle.points[0].w,
+
+                triangle.points[1].x,
+                triangle.points[1].y,
+                triangle.points[1].z,
+                triangle.points[1].w,
+
+                triangle.points[2].x,
+                triangle.points[2].y,
+                triangle.points[2].z,
+                triangle.points[2].w,
+                triangle.color);
+        } else if (should_render_textured_triangles() && triangle.texture != NULL) {
             draw_textured_triangle(
                 triangle.points[0].x,
                 triangle.points[0].y,
@@ -468,6 +755,56 @@ void render(void) {
                 triangle.texture
             );
         }
+        if (should_render_textured_triangles() && triangle.compressed_texture != NULL) {
+            draw_compressed_textured_triangle(
+                triangle.points[0].x,
+                triangle.points[0].y,
+                triangle.points[0].z,
+                triangle.points[0].w,
+                triangle.texcoords[0].u,
+                triangle.texcoords[0].v,
+
+                triangle.points[1].x,
+                triangle.points[1].y,
+                triangle.points[1].z,
+                triangle.points[1].w,
+                triangle.texcoords[1].u,
+                triangle.texcoords[1].v,
+
+                triangle.points[2].x,
+                triangle.points[2].y,
+                triangle.points[2].z,
+                triangle.points[2].w,
+                triangle.texcoords[2].u,
+                triangle.texcoords[2].v,
+                triangle.compressed_texture
+            );
+        }
+        if (should_render_textured_triangles() && triangle.virtual_texture != NULL) {
+            draw_virtual_textured_triangle(
+                triangle.points[0].x,
+                triangle.points[0].y,
+                triangle.points[0].z,
+                triangle.points[0].w,
+                triangle.texcoords[0].u,
+                triangle.texcoords[0].v,
+
+                triangle.points[1].x,
+                triangle.points[1].y,
+                triangle.points[1].z,
+                triangle.points[1].w,
+                triangle.texcoords[1].u,
+                triangle.texcoords[1].v,
+
+                triangle.points[2].x,
+                triangle.points[2].y,
+                triangle.points[2].z,
+                triangle.points[2].w,
+                triangle.texcoords[2].u,
+                triangle.texcoords[2].v,
+                triangle.virtual_texture
+            );
+        }
 
         // wireframe
         if (should_render_wireframe()) {
@@ -489,9 +826,15 @@ void render(void) {
 
     }
 
+    draw_fragment_heatmap();
+
     // test to see if we are right handed coordinate system (we are.)
     // draw_triangle(100,100, 500, 100,  300, 300, 0xFFFF00FF);
+    end_benchmark_stage(BENCHMARK_STAGE_RASTER);
     render_color_buffer();
+    end_benchmark_stage(BENCHMARK_STAGE_PRESENT);
+    end_benchmark_frame();
+    end_pipeline_stats_frame();
 
 
 }
@@ -504,25 +847,178 @@ void transform_points() {
 
 // free the memory that was dynamically allocated by the program.
 void free_resources(void) {
+    array_free(triangles_to_render);
+    array_free(view_space_vertices);
+    array_free(visible_instances);
+    close_scene_stream();
     free_meshes();
+    free_virtual_textures();
+    close_asset_bundle();
+    free_benchmark();
+    destroy_job_system();
     destroy_window();
+    close_frame_capture();
 }
 
 
 int main(int argc, char *argv[]) {
-    // create an SDL window.
-    is_running = initialize_window();
+    // the present thread has to be asked for before the window exists.
+    int headless_width = 800; // the default window size.
+    int headless_height = 600;
+    const char* output_path = NULL;
+    const char* camera_path = NULL;
+    const char* benchmark_prefix = "benchmark";
+    const char* baseline_path = NULL;
+    const char* trace_path = NULL;
+    bool should_print_stats = false;
+    bool should_count_perf = false;
+    float regression_threshold = 5.0;
+    int warmup_frame_count = 30;
+    int render_mode = -1;
+    for (int arg_idx = 1; arg_idx < argc; ++arg_idx) {
+        if (strncmp(argv[arg_idx], "--present-buffers=", 18) == 0) {
+            set_present_mode(PRESENT_MODE_PIPELINED);
+            set_present_buffer_count(atoi(argv[arg_idx] + 18));
+        } else if (strcmp(argv[arg_idx], "--headless") == 0) {
+            is_headless = true;
+        } else if (strncmp(argv[arg_idx], "--size=", 7) == 0) {
+            if (sscanf(argv[arg_idx] + 7, "%dx%d", &headless_width, &headless_height) != 2 || headless_width <= 0 || headless_height <= 0) {
+                fprintf(stderr, "%s: expected --size=WIDTHxHEIGHT.\n", argv[arg_idx]);
+                return 1;
+            }
+        } else if (strncmp(argv[arg_idx], "--frames=", 9) == 0) {
+            frame_limit = atoi(argv[arg_idx] + 9);
+        } else if (strncmp(argv[arg_idx], "--output=", 9) == 0) {
+            output_path = argv[arg_idx] + 9;
+            is_headless = true;
+        } else if (strcmp(argv[arg_idx], "--benchmark") == 0 || strncmp(argv[arg_idx], "--benchmark=", 12) == 0) {
+            is_benchmark = true;
+            camera_path = argv[arg_idx][11] == '=' ? argv[arg_idx] + 12 : NULL;
+        } else if (strncmp(argv[arg_idx], "--warmup=", 9) == 0) {
+            warmup_frame_count = atoi(argv[arg_idx] + 9);
+        } else if (strncmp(argv[arg_idx], "--render-mode=", 14) == 0) {
+            render_mode = atoi(argv[arg_idx] + 14);
+        } else if (strncmp(argv[arg_idx], "--benchmark-out=", 16) == 0) {
+            benchmark_prefix = argv[arg_idx] + 16;
+        } else if (strncmp(argv[arg_idx], "--baseline=", 11) == 0) {
+            baseline_path = argv[arg_idx] + 11;
+        } else if (strncmp(argv[arg_idx], "--regression-threshold=", 23) == 0) {
+            regression_threshold = atof(argv[arg_idx] + 23);
+        } else if (strncmp(argv[arg_idx], "--trace=", 8) == 0) {
+            trace_path = argv[arg_idx] + 8;
+        } else if (strcmp(argv[arg_idx], "--stats") == 0) {
+            should_print_stats = true;
+        } else if (strcmp(argv[arg_idx], "--perf") == 0) {
+            should_count_perf = true;
+        } else if (strncmp(argv[arg_idx], "--scene=", 8) == 0) {
+            if (!parse_stress_scene(argv[arg_idx] + 8, &stress_scene)) {
+                return 1;
+            }
+            has_stress_scene = true;
+        }
+    }
+    if (is_benchmark) {
+        if (!load_camera_path(camera_path)) {
+            return 1;
+        }
+        frame_limit = warmup_frame_count + (frame_limit < 0 ? 300 : frame_limit);
+    }
+    if (output_path != NULL && !open_frame_capture(output_path)) {
+        return 1;
+    }
+    if (is_headless && frame_limit < 0) {
+        frame_limit = 1;
+    }
+
+    PROFILE_THREAD_NAME("main");
+    // create an SDL window, or just the frame buffers.
+    is_running = is_headless ? initialize_offscreen(headless_width, headless_height) : initialize_window();
+    init_job_system(0);
+    // renderer [scene.bundle] [scene.cells]: the bundle has to be open before setup() loads the meshes.
+    for (int arg_idx = 1; arg_idx < argc; ++arg_idx) {
+        if (is_asset_bundle_filename(argv[arg_idx])) {
+            open_asset_bundle(argv[arg_idx]);
+        }
+    }
     setup();
+    for (int arg_idx = 1; arg_idx < argc; ++arg_idx) {
+        if (!is_asset_bundle_filename(argv[arg_idx]) && strncmp(argv[arg_idx], "--", 2) != 0) {
+            open_scene_stream(argv[arg_idx]);
+        }
+    }
+    if (render_mode >= RENDER_MODE_WIREFRAME_WITH_VERTICES && render_mode <= RENDER_MODE_TILE_COST) {
+        set_render_mode(render_mode);
+    }
+    // nobody watches the meshes pop in: the captured frames start with everything loaded. textures are only
+    // decoded once something samples them, so the ones the render mode samples are requested after the files are in.
+    set_pixel_coverage_counting(should_print_stats || is_benchmark);
+    if (is_headless || is_benchmark) {
+        wait_for_jobs();
+        acquire_mesh_textures();
+        wait_for_jobs();
+    }
+    if (is_benchmark && should_count_perf && !open_perf_counters()) {
+        printf("perf: no hardware counters, the benchmark runs without them.\n");
+    }
 
 
+    int frame_count = 0;
     while(is_running) {
-        process_input();
-        update();
-        render();
+        if (is_benchmark && frame_count == warmup_frame_count) {
+            start_benchmark_recording();
+            start_pipeline_stats_run();
+        }
+        if (!is_headless) {
+            process_input();
+        }
+        {
+            PROFILE_SCOPE("frame");
+            update();
+            render();
+        }
+        // what a frame queued is done before the next one, so frame N comes out the same in every run.
+        if (is_headless || is_benchmark) {
+            wait_for_jobs();
+        }
+        if (should_print_stats) {
+            pipeline_stats_t stats = get_pipeline_stats();
+            printf("frame %d: ", frame_count);
+            print_pipeline_stats(&stats, 1);
+        }
+
+        if (is_frame_capture_open()) {
+            int stride = 0;
+            const uint32_t* pixels = get_color_buffer(&stride);
+            if (!capture_frame(pixels, get_window_width(), get_window_height(), stride)) {
+                is_running = false;
+            }
+        }
+        frame_count += 1;
+        if (frame_limit >= 0 && frame_count >= frame_limit) {
+            is_running = false;
+        }
     }
 
+    if (trace_path != NULL) {
+        wait_for_jobs();
+        write_profile_trace(trace_path);
+    }
+    int exit_code = 0;
+    if (is_benchmark_recording()) {
+        print_benchmark_results();
+        int stats_frame_count = 0;
+        pipeline_stats_t stats = get_pipeline_stats_totals(&stats_frame_count);
+        printf("per frame: ");
+        print_pipeline_stats(&stats, stats_frame_count);
+        write_benchmark_results(benchmark_prefix);
+        if (baseline_path != NULL) {
+            int regression_count = compare_benchmark_baseline(baseline_path, regression_threshold);
+            exit_code = regression_count < 0 ? 1 : (regression_count > 0 ? 2 : 0);
+        }
+    }
+    close_perf_counters();
     free_resources();
 
-    return 0;
+    return exit_code;
     // printf("hello world!\n");
 }
\ No newline at end of file
@@ -148,3 +148,12 @@ mat4_t mat4_mul_mat4(mat4_t lhs, mat4_t rhs) {
     return result;
 }
 
+mat4_t mat4_transpose(mat4_t m) {
+    mat4_t result;
+    for (int i = 0; i < 4; ++i) {
+        for (int j = 0; j < 4; ++j) {
+            result.m[i][j] = m.m[j][i];
+        }
+    }
+    return result;
+}
@@ -22,4 +22,6 @@ vec4_t mat4_mul_vec4(mat4_t m, vec4_t v);
 
 mat4_t mat4_mul_mat4(mat4_t lhs, mat4_t rhs);
 
+mat4_t mat4_transpose(mat4_t m);
+
 #endif // MATRIX_H
\ No newline at end of file
@@ -1,129 +1,117 @@
 #include <stdio.h>
+#include <string.h>
+#include <math.h>
 #include "mesh.h"
 #include "array.h"
-#include "texture.h"
+#include "job.h"
+#include "bvh.h"
 
-#define MAX_MESH_COUNT 10
-static mesh_t meshes[MAX_MESH_COUNT];
-static int active_mesh_count = 0;
+// dynamic array of scene objects. meshes may still be loading, check is_mesh_geometry_ready() before touching their geometry.
+static mesh_t* meshes = NULL;
 
 int get_mesh_count(void) {
-    return active_mesh_count;
+    return array_length(meshes);
 }
 
 mesh_t* get_mesh(int idx) {
     return &meshes[idx];
 }
 
-void load_mesh(char* obj_filename, char* png_filename, vec3_t scale, vec3_t translation, vec3_t rotation) {
-    // load the png file information to mesh texture
-    // initialize scale, translation and rotation 
-    mesh_t* mesh = &meshes[active_mesh_count];
-    // load the obj file to our mesh
-    load_mesh_obj_data(obj_filename, mesh);
-    load_mesh_png_data(png_filename, mesh);
-
-    mesh->scale = scale;
-    mesh->translation = translation;
-    mesh->rotation = rotation;
+bool is_mesh_geometry_ready(mesh_t* mesh) {
+    return mesh->geometry != NULL && is_geometry_ready(mesh->geometry);
+}
 
-    active_mesh_count += 1;
+int get_mesh_instance_count(mesh_t* mesh) {
+    return array_length(mesh->instances);
+}
 
+mesh_instance_t make_mesh_instance(vec3_t scale, vec3_t translation, vec3_t rotation, uint32_t color) {
+    mesh_instance_t instance = {
+        .rotation = rotation,
+        .scale = scale,
+        .translation = translation,
+        .color = color,
+        .lod = 0,
+        .bvh_leaf = -1
+    };
+    return instance;
 }
 
-void load_mesh_png_data(char* filename, mesh_t* mesh) {
-    upng_t* png_image = upng_new_from_file(filename);
-    if (png_image != NULL) {
-        upng_decode(png_image);
-        if (upng_get_error(png_image) == UPNG_EOK) {
-            mesh->texture = png_image;
-        } 
-    }
+mat4_t get_mesh_instance_rotation_matrix(mesh_instance_t* instance) {
+    mat4_t rotation_matrix_x = mat4_make_rotation_x(instance->rotation.x);
+    mat4_t rotation_matrix_y = mat4_make_rotation_y(instance->rotation.y);
+    mat4_t rotation_matrix_z = mat4_make_rotation_z(instance->rotation.z);
+    return mat4_mul_mat4(rotation_matrix_x, mat4_mul_mat4(rotation_matrix_y, rotation_matrix_z));
 }
 
-void load_mesh_obj_data(char* obj_filename, mesh_t* mesh) {
-    // todo: read the contents of the obj file
-    // and load the vertices and faces in our mesh.vertices and mesh.faces
-    FILE *file;
+mat4_t get_mesh_instance_world_matrix(mesh_instance_t* instance) {
+    mat4_t translation_matrix = mat4_make_translate(instance->translation.x, instance->translation.y, instance->translation.z);
+    mat4_t scale_matrix = mat4_make_scale(instance->scale.x, instance->scale.y, instance->scale.z);
+    return mat4_mul_mat4(translation_matrix, mat4_mul_mat4(get_mesh_instance_rotation_matrix(instance), scale_matrix));
+}
 
-    // Open the file for reading
-    file = fopen(obj_filename, "r");
+void get_mesh_instance_bounds(mesh_t* mesh, mesh_instance_t* instance, vec3_t* center, float* radius) {
+    mat4_t world_matrix = get_mesh_instance_world_matrix(instance);
+    *center = vec3_from_vec4(mat4_mul_vec4(world_matrix, vec4_from_vec3(mesh->geometry->bounds_center)));
+    float max_scale = fmaxf(fabsf(instance->scale.x), fmaxf(fabsf(instance->scale.y), fabsf(instance->scale.z)));
+    *radius = mesh->geometry->bounds_radius * max_scale;
+}
 
-    // Check if the file was opened successfully
-    if (file == NULL) {
-        printf("Unable to open the file %s. \n", obj_filename);
-        return;
+// files that are already loaded are shared, only new ones queue a parse / read job.
+int load_mesh_instanced(char* obj_filename, char* png_filename, mesh_instance_t* instances, int instance_count) {
+    bool is_virtual = is_virtual_texture_filename(png_filename);
+    mesh_t mesh = {
+        .geometry = load_geometry_asset(obj_filename),
+        .texture = is_virtual ? NULL : load_texture_asset(png_filename),
+        .virtual_texture = is_virtual ? load_virtual_texture(png_filename) : NULL,
+        .instances = NULL
+    };
+    for (int instance_idx = 0; instance_idx < instance_count; ++instance_idx) {
+        array_push(mesh.instances, instances[instance_idx]);
+        mesh.instances[instance_idx].bvh_leaf = -1;
     }
 
-    // Buffer to store each line
-    char line[1024]; // You can adjust the size as needed
-    tex2_t* texture_coordinates = NULL;
-
-    // Read the file line by line
-    while (fgets(line, sizeof(line), file) != NULL) {
-        
-        // Variables to store parsed data
-        vec3_t position;
-        face_t face;
-        int vertex_indices[3];
-        int texture_indices[3];
-        int normal_indices[3];
-        tex2_t vertex_uv;
-
-        // Use sscanf to parse the line
-        if (sscanf(line, "v %f %f %f", &position.x, &position.y, &position.z) == 3) {
-            // Process the parsed data
-            printf("x: %f, y: %f, z: %f\n", position.x, position.y, position.z);
-            array_push(mesh->vertices, position);
-
-        } else if (sscanf(line, "vt %f %f", &vertex_uv.u,  &vertex_uv.v) == 2) {
-            array_push(texture_coordinates, vertex_uv);
-        }else if (sscanf(line, "f %d/%d/%d %d/%d/%d %d/%d/%d", 
-            &vertex_indices[0],
-            &texture_indices[0],
-            &normal_indices[0],
-            &vertex_indices[1],
-            &texture_indices[1],
-            &normal_indices[1],
-            &vertex_indices[2],
-            &texture_indices[2],
-            &normal_indices[2]) == 9){
-           
-            // printf("a0: %d, b0: %d, c0: %d\n", face_0.a, face_0.b, face_0.c);
-            // printf("a1: %d, b1: %d, c2: %d\n", face_1.a, face_1.b, face_1.c);
-            // printf("a2: %d, b2: %d, c2: %d\n", face_2.a, face_2.b, face_2.c);
-
-
-            //@NOTE(SJM): we need to subtract all indices by 1 since we start at 1. 
-            face.a = vertex_indices[0] - 1;
-            face.b = vertex_indices[1] - 1;
-            face.c = vertex_indices[2] - 1;
-            face.a_uv = texture_coordinates[texture_indices[0] -1];
-            face.b_uv = texture_coordinates[texture_indices[1] -1];
-            face.c_uv = texture_coordinates[texture_indices[2] -1];
-
-            face.color = 0xFFFFFFFF;
-
-
-            array_push(mesh->faces, face);
-
-
-        } else {
-            // printf("Failed to parse the line: %s\n", line);
-        }
+    array_push(meshes, mesh);
+    return get_mesh_count() - 1;
+}
+
+void load_mesh(char* obj_filename, char* png_filename, vec3_t scale, vec3_t translation, vec3_t rotation) {
+    mesh_instance_t instance = make_mesh_instance(scale, translation, rotation, 0xFFFFFFFF);
+    load_mesh_instanced(obj_filename, png_filename, &instance, 1);
+}
+
+void add_mesh_instance(int mesh_idx, mesh_instance_t instance) {
+    instance.bvh_leaf = -1;
+    array_push(meshes[mesh_idx].instances, instance);
+}
+
+void set_mesh_instance_transform(int mesh_idx, int instance_idx, vec3_t scale, vec3_t translation, vec3_t rotation) {
+    mesh_instance_t* instance = &meshes[mesh_idx].instances[instance_idx];
+    instance->scale = scale;
+    instance->translation = translation;
+    instance->rotation = rotation;
+    if (instance->bvh_leaf >= 0) {
+        mark_bvh_leaf_moved(instance->bvh_leaf);
     }
-    array_free(texture_coordinates);
+}
 
-    // Close the file
-    fclose(file);
+// completion barrier for all load_mesh() requests.
+void wait_for_mesh_loads(void) {
+    wait_for_jobs();
 }
 
 void free_meshes(void) {
 
-    for (int mesh_idx = 0; mesh_idx != active_mesh_count; ++mesh_idx) {
-        upng_free(meshes[mesh_idx].texture);
-        array_free(meshes[mesh_idx].faces);
-        array_free(meshes[mesh_idx].vertices);
+    for (int mesh_idx = 0; mesh_idx != get_mesh_count(); ++mesh_idx) {
+        release_geometry_asset(meshes[mesh_idx].geometry);
+        release_texture_asset(meshes[mesh_idx].texture);
+        release_virtual_texture(meshes[mesh_idx].virtual_texture);
+        array_free(meshes[mesh_idx].instances);
     }
-    
-}
\ No newline at end of file
+    array_free(meshes);
+    meshes = NULL;
+    free_scene_bvh();
+
+    // anything still held elsewhere goes too.
+    free_assets();
+}
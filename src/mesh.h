@@ -2,26 +2,54 @@
 #define MESH_H
 
 #include "vector.h"
-#include "triangle.h"
-#include "upng.h"
+#include "matrix.h"
+#include "asset.h"
+#include "vtexture.h"
+#include <stdbool.h>
+#include <stdint.h>
 
 typedef struct {
-    vec3_t* vertices; // dynamic array of vertices
-    face_t* faces; // dynamic array of faces
-    upng_t* texture; // mesh PNG texture pointer.
     vec3_t rotation; // mesh rotation xyz
     vec3_t scale; // scale with xyz values
     vec3_t translation;  // mesh translation with x,y, and z values
+    uint32_t color; // multiplied into the face colors, 0xFFFFFFFF leaves them untouched.
+    int lod; // level of detail drawn last frame, see select_geometry_lod().
+    int bvh_leaf; // node of the scene BVH, -1 until the geometry is ready. see bvh.h.
+} mesh_instance_t;
+
+// a scene object: handles to shared assets, drawn once for every instance.
+typedef struct {
+    geometry_t* geometry; // shared OBJ geometry, see asset.h.
+    texture_t* texture; // shared PNG texture, only decoded while a render mode samples it. see acquire_texture().
+    virtual_texture_t* virtual_texture; // set instead of texture when the mesh was loaded with a .vtex file.
+    mesh_instance_t* instances; // dynamic array of per instance transforms.
 
 } mesh_t;
 
+// load requests go through the asset manager and never block the caller.
+// a mesh becomes drawable as soon as its geometry is ready. its texture is only read from disk here,
+// decoding waits until a frame samples it. a .vtex file loads as a virtual texture instead, see vtexture.h.
+// wait_for_mesh_loads() is the completion barrier for callers that need everything loaded.
 void load_mesh(char* obj_filename, char* png_filename, vec3_t scale, vec3_t translation, vec3_t rotation);
-void load_mesh_obj_data(char* filename, mesh_t* mesh);
-void load_mesh_png_data(char* filename, mesh_t* mesh);
+// returns the mesh index, more instances can be added later with add_mesh_instance().
+int load_mesh_instanced(char* obj_filename, char* png_filename, mesh_instance_t* instances, int instance_count);
+mesh_instance_t make_mesh_instance(vec3_t scale, vec3_t translation, vec3_t rotation, uint32_t color);
+void add_mesh_instance(int mesh_idx, mesh_instance_t instance);
+// moving an instance through here keeps the scene BVH in sync, writing the fields directly does not.
+void set_mesh_instance_transform(int mesh_idx, int instance_idx, vec3_t scale, vec3_t translation, vec3_t rotation);
+int get_mesh_instance_count(mesh_t* mesh);
+// rotation is applied z first, then y, then x. world = translation * rotation * scale.
+mat4_t get_mesh_instance_rotation_matrix(mesh_instance_t* instance);
+mat4_t get_mesh_instance_world_matrix(mesh_instance_t* instance);
+// world space bounding sphere, the geometry must be ready.
+void get_mesh_instance_bounds(mesh_t* mesh, mesh_instance_t* instance, vec3_t* center, float* radius);
+void wait_for_mesh_loads(void);
+bool is_mesh_geometry_ready(mesh_t* mesh);
 
 int get_mesh_count();
+// the returned pointer is only valid until the next load_mesh().
 mesh_t* get_mesh(int idx);
 void free_meshes(void);
 
 
-# endif
\ No newline at end of file
+# endif
@@ -0,0 +1,223 @@
+#include <math.h>
+#include "occlusion.h"
+
+// SSE2 is part of every x86-64 target, so there is no runtime detection like in upng.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OCCLUSION_SSE2 1
+#include <emmintrin.h>
+#endif
+
+static float occlusion_buffer[OCCLUSION_BUFFER_WIDTH * OCCLUSION_BUFFER_HEIGHT];
+static float projection_scale_x = 1.0;
+static float projection_scale_y = 1.0;
+static float occlusion_z_near = 0.1;
+static bool is_enabled = true;
+
+typedef struct {
+    float x; // occlusion buffer pixels
+    float y;
+    float inverse_z;
+} occlusion_point_t;
+
+void init_occlusion_culling(mat4_t projection_matrix, float z_near) {
+    projection_scale_x = projection_matrix.m[0][0];
+    projection_scale_y = projection_matrix.m[1][1];
+    occlusion_z_near = z_near;
+}
+
+void set_occlusion_culling(bool is_enabled_in) {
+    is_enabled = is_enabled_in;
+}
+
+bool is_occlusion_culling_enabled(void) {
+    return is_enabled;
+}
+
+void clear_occlusion_buffer(void) {
+    for (int idx = 0; idx < OCCLUSION_BUFFER_WIDTH * OCCLUSION_BUFFER_HEIGHT; ++idx) {
+        occlusion_buffer[idx] = 0.0;
+    }
+}
+
+// same projection as the main pipeline, but straight into occlusion buffer pixels.
+static occlusion_point_t project_to_occlusion_buffer(vec4_t point) {
+    float inverse_z = 1.0 / point.z;
+    occlusion_point_t result = {
+        .x = (projection_scale_x * point.x * inverse_z + 1.0) * 0.5 * OCCLUSION_BUFFER_WIDTH,
+        .y = (1.0 - projection_scale_y * point.y * inverse_z) * 0.5 * OCCLUSION_BUFFER_HEIGHT,
+        .inverse_z = inverse_z
+    };
+    return result;
+}
+
+// edge function a * x + b * y + c, positive on the inside of a counter clockwise (in buffer space) triangle.
+typedef struct {
+    float a;
+    float b;
+    float c;
+} edge_t;
+
+static edge_t make_edge(occlusion_point_t p, occlusion_point_t q) {
+    edge_t edge = {
+        .a = -(q.y - p.y),
+        .b = q.x - p.x,
+    };
+    edge.c = -(edge.a * p.x + edge.b * p.y);
+    return edge;
+}
+
+void rasterize_occluder_triangle(vec4_t a, vec4_t b, vec4_t c) {
+    if (a.z < occlusion_z_near || b.z < occlusion_z_near || c.z < occlusion_z_near) {
+        return;
+    }
+
+    occlusion_point_t v0 = project_to_occlusion_buffer(a);
+    occlusion_point_t v1 = project_to_occlusion_buffer(b);
+    occlusion_point_t v2 = project_to_occlusion_buffer(c);
+
+    // depth fill does not care about facing, flip clockwise triangles around.
+    float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+    if (fabsf(area) < 1e-6f) {
+        return;
+    }
+    if (area < 0.0) {
+        occlusion_point_t swap = v1;
+        v1 = v2;
+        v2 = swap;
+        area = -area;
+    }
+
+    int min_x = (int)floorf(fminf(v0.x, fminf(v1.x, v2.x)));
+    int max_x = (int)ceilf(fmaxf(v0.x, fmaxf(v1.x, v2.x)));
+    int min_y = (int)floorf(fminf(v0.y, fminf(v1.y, v2.y)));
+    int max_y = (int)ceilf(fmaxf(v0.y, fmaxf(v1.y, v2.y)));
+    if (min_x < 0) min_x = 0;
+    if (min_y < 0) min_y = 0;
+    if (max_x > OCCLUSION_BUFFER_WIDTH - 1) max_x = OCCLUSION_BUFFER_WIDTH - 1;
+    if (max_y > OCCLUSION_BUFFER_HEIGHT - 1) max_y = OCCLUSION_BUFFER_HEIGHT - 1;
+    if (min_x > max_x || min_y > max_y) {
+        return;
+    }
+
+    // the barycentric weight of a vertex is the edge function of the opposite edge over the area,
+    // 1 / z is linear in screen space so it is interpolated with the same plane equation.
+    edge_t e0 = make_edge(v1, v2);
+    edge_t e1 = make_edge(v2, v0);
+    edge_t e2 = make_edge(v0, v1);
+    float inverse_area = 1.0 / area;
+    float z_dx = (e0.a * v0.inverse_z + e1.a * v1.inverse_z + e2.a * v2.inverse_z) * inverse_area;
+    float z_dy = (e0.b * v0.inverse_z + e1.b * v1.inverse_z + e2.b * v2.inverse_z) * inverse_area;
+    float z_c = (e0.c * v0.inverse_z + e1.c * v1.inverse_z + e2.c * v2.inverse_z) * inverse_area;
+
+#ifdef OCCLUSION_SSE2
+    // four pixels at a time. the buffer width is a multiple of 4, so an aligned group never leaves the row.
+    const __m128 lane_offsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+    const __m128 zero = _mm_setzero_ps();
+    for (int y = min_y; y <= max_y; ++y) {
+        float pixel_y = y + 0.5f;
+        __m128 row_e0 = _mm_set1_ps(e0.b * pixel_y + e0.c);
+        __m128 row_e1 = _mm_set1_ps(e1.b * pixel_y + e1.c);
+        __m128 row_e2 = _mm_set1_ps(e2.b * pixel_y + e2.c);
+        __m128 row_z = _mm_set1_ps(z_dy * pixel_y + z_c);
+        float* row = &occlusion_buffer[y * OCCLUSION_BUFFER_WIDTH];
+
+        for (int x = min_x & ~3; x <= max_x; x += 4) {
+            __m128 pixel_x = _mm_add_ps(_mm_set1_ps((float)x), lane_offsets);
+            __m128 w0 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(e0.a), pixel_x), row_e0);
+            __m128 w1 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(e1.a), pixel_x), row_e1);
+            __m128 w2 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(e2.a), pixel_x), row_e2);
+            __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(w0, zero), _mm_cmpge_ps(w1, zero)), _mm_cmpge_ps(w2, zero));
+            if (_mm_movemask_ps(inside) == 0) {
+                continue;
+            }
+
+            __m128 depth = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(z_dx), pixel_x), row_z);
+            __m128 previous = _mm_loadu_ps(&row[x]);
+            __m128 nearest = _mm_max_ps(previous, depth);
+            _mm_storeu_ps(&row[x], _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, previous)));
+        }
+    }
+#else
+    for (int y = min_y; y <= max_y; ++y) {
+        float pixel_y = y + 0.5f;
+        for (int x = min_x; x <= max_x; ++x) {
+            float pixel_x = x + 0.5f;
+            if (e0.a * pixel_x + e0.b * pixel_y + e0.c < 0.0f ||
+                e1.a * pixel_x + e1.b * pixel_y + e1.c < 0.0f ||
+                e2.a * pixel_x + e2.b * pixel_y + e2.c < 0.0f) {
+                continue;
+            }
+            float depth = z_dx * pixel_x + z_dy * pixel_y + z_c;
+            float* pixel = &occlusion_buffer[y * OCCLUSION_BUFFER_WIDTH + x];
+            if (depth > *pixel) {
+                *pixel = depth;
+            }
+        }
+    }
+#endif
+}
+
+bool is_sphere_occluded(vec3_t center, float radius) {
+    if (!is_enabled) {
+        return false;
+    }
+
+    float nearest_z = center.z - radius;
+    if (nearest_z <= occlusion_z_near) {
+        return false;
+    }
+
+    // x / z and y / z are monotonic over the bounding box of the sphere, so its corners give conservative screen bounds.
+    float min_x = INFINITY, max_x = -INFINITY, min_y = INFINITY, max_y = -INFINITY;
+    for (int corner = 0; corner < 4; ++corner) {
+        float z = (corner & 1) ? center.z + radius : nearest_z;
+        float x = ((corner & 2) ? center.x + radius : center.x - radius) / z;
+        float y = ((corner & 2) ? center.y + radius : center.y - radius) / z;
+        min_x = fminf(min_x, x);
+        max_x = fmaxf(max_x, x);
+        min_y = fminf(min_y, y);
+        max_y = fmaxf(max_y, y);
+    }
+
+    int x0 = (int)floorf((projection_scale_x * min_x + 1.0) * 0.5 * OCCLUSION_BUFFER_WIDTH);
+    int x1 = (int)ceilf((projection_scale_x * max_x + 1.0) * 0.5 * OCCLUSION_BUFFER_WIDTH);
+    int y0 = (int)floorf((1.0 - projection_scale_y * max_y) * 0.5 * OCCLUSION_BUFFER_HEIGHT);
+    int y1 = (int)ceilf((1.0 - projection_scale_y * min_y) * 0.5 * OCCLUSION_BUFFER_HEIGHT);
+    if (x0 < 0) x0 = 0;
+    if (y0 < 0) y0 = 0;
+    if (x1 > OCCLUSION_BUFFER_WIDTH - 1) x1 = OCCLUSION_BUFFER_WIDTH - 1;
+    if (y1 > OCCLUSION_BUFFER_HEIGHT - 1) y1 = OCCLUSION_BUFFER_HEIGHT - 1;
+    // off screen, that is for frustum clipping to deal with.
+    if (x0 > x1 || y0 > y1) {
+        return false;
+    }
+
+    // visible as soon as one covered pixel has no occluder in front of the nearest point of the sphere.
+    float inverse_nearest_z = 1.0 / nearest_z;
+#ifdef OCCLUSION_SSE2
+    const __m128 lane_offsets = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+    const __m128 first_x = _mm_set1_ps((float)x0);
+    const __m128 last_x = _mm_set1_ps((float)x1);
+    const __m128 sphere_depth = _mm_set1_ps(inverse_nearest_z);
+    for (int y = y0; y <= y1; ++y) {
+        const float* row = &occlusion_buffer[y * OCCLUSION_BUFFER_WIDTH];
+        for (int x = x0 & ~3; x <= x1; x += 4) {
+            __m128 pixel_x = _mm_add_ps(_mm_set1_ps((float)x), lane_offsets);
+            __m128 in_range = _mm_and_ps(_mm_cmpge_ps(pixel_x, first_x), _mm_cmple_ps(pixel_x, last_x));
+            __m128 uncovered = _mm_cmple_ps(_mm_loadu_ps(&row[x]), sphere_depth);
+            if (_mm_movemask_ps(_mm_and_ps(in_range, uncovered)) != 0) {
+                return false;
+            }
+        }
+    }
+#else
+    for (int y = y0; y <= y1; ++y) {
+        for (int x = x0; x <= x1; ++x) {
+            if (occlusion_buffer[y * OCCLUSION_BUFFER_WIDTH + x] <= inverse_nearest_z) {
+                return false;
+            }
+        }
+    }
+#endif
+    return true;
+}
@@ -0,0 +1,26 @@
+#ifndef OCCLUSION_H
+#define OCCLUSION_H
+
+#include <stdbool.h>
+#include "vector.h"
+#include "matrix.h"
+
+// a coarse depth buffer that the biggest instances are rasterized into (depth only) before the geometry stage,
+// so instances hidden completely behind them can be skipped. depth is stored as 1 / view space z, so 0 is empty.
+#define OCCLUSION_BUFFER_WIDTH 256
+#define OCCLUSION_BUFFER_HEIGHT 128
+// the nearest instances with at least this projected bounding sphere radius (in window pixels) become occluders.
+#define OCCLUDER_MIN_SCREEN_RADIUS 64.0f
+#define MAX_OCCLUDER_COUNT 8
+
+void init_occlusion_culling(mat4_t projection_matrix, float z_near);
+void set_occlusion_culling(bool is_enabled);
+bool is_occlusion_culling_enabled(void);
+
+void clear_occlusion_buffer(void);
+// camera space triangle. triangles that cross the near plane are skipped, occluders only need to be conservative.
+void rasterize_occluder_triangle(vec4_t a, vec4_t b, vec4_t c);
+// true if the camera space sphere is behind the occluders everywhere it covers the screen.
+bool is_sphere_occluded(vec3_t center, float radius);
+
+#endif
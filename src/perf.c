@@ -0,0 +1,118 @@
+#if defined(__linux__)
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include "perf.h"
+
+#if defined(__linux__)
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+static const char* counter_names[PERF_COUNTER_COUNT] = {
+    "cycles",
+    "instructions",
+    "L1d read misses",
+    "LLC misses",
+    "branch misses",
+};
+
+const char* get_perf_counter_name(int counter) {
+    return counter_names[counter];
+}
+
+#if defined(__linux__)
+// -1 if the counter is not available.
+static int counter_fds[PERF_COUNTER_COUNT] = { -1, -1, -1, -1, -1 };
+static bool are_counters_open = false;
+
+static int open_counter(unsigned int type, unsigned long long config) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    // with more counters than the pmu has, the kernel takes turns: the times tell how long this one really ran.
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    // every counter on its own instead of a group, so a missing one does not take the others with it.
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+bool open_perf_counters(void) {
+    if (are_counters_open) {
+        return true;
+    }
+    counter_fds[PERF_COUNTER_CYCLES] = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    counter_fds[PERF_COUNTER_INSTRUCTIONS] = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    counter_fds[PERF_COUNTER_L1D_READ_MISSES] = open_counter(PERF_TYPE_HW_CACHE,
+        PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+    counter_fds[PERF_COUNTER_LLC_MISSES] = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    counter_fds[PERF_COUNTER_BRANCH_MISSES] = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+
+    int open_count = 0;
+    for (int counter = 0; counter < PERF_COUNTER_COUNT; ++counter) {
+        if (counter_fds[counter] >= 0) {
+            open_count += 1;
+        } else {
+            printf("perf: no %s counter.\n", counter_names[counter]);
+        }
+    }
+    are_counters_open = open_count > 0;
+    return are_counters_open;
+}
+
+bool are_perf_counters_open(void) {
+    return are_counters_open;
+}
+
+void read_perf_counters(perf_counters_t* counters) {
+    for (int counter = 0; counter < PERF_COUNTER_COUNT; ++counter) {
+        // value, time enabled, time running.
+        uint64_t values[3];
+        counters->values[counter] = -1;
+        if (counter_fds[counter] < 0 || read(counter_fds[counter], values, sizeof(values)) != sizeof(values)) {
+            continue;
+        }
+        if (values[2] == 0) {
+            counters->values[counter] = 0;
+        } else if (values[2] < values[1]) {
+            counters->values[counter] = (int64_t)((double)values[0] * (double)values[1] / (double)values[2]);
+        } else {
+            counters->values[counter] = (int64_t)values[0];
+        }
+    }
+}
+
+void close_perf_counters(void) {
+    for (int counter = 0; counter < PERF_COUNTER_COUNT; ++counter) {
+        if (counter_fds[counter] >= 0) {
+            close(counter_fds[counter]);
+        }
+        counter_fds[counter] = -1;
+    }
+    are_counters_open = false;
+}
+#else
+bool open_perf_counters(void) {
+    printf("perf: hardware counters need perf_event_open, this build is not for linux.\n");
+    return false;
+}
+
+bool are_perf_counters_open(void) {
+    return false;
+}
+
+void read_perf_counters(perf_counters_t* counters) {
+    for (int counter = 0; counter < PERF_COUNTER_COUNT; ++counter) {
+        counters->values[counter] = -1;
+    }
+}
+
+void close_perf_counters(void) {
+}
+#endif
@@ -0,0 +1,31 @@
+#ifndef PERF_H
+#define PERF_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// hardware counters of the calling thread, from perf_event_open on linux. the whole frame runs on the main thread,
+// so that is where they are opened: loader jobs and the present thread are not counted. elsewhere, and wherever the
+// kernel or the cpu does not provide a counter (perf_event_paranoid, most vms), it reads -1.
+enum PERF_COUNTER {
+    PERF_COUNTER_CYCLES,
+    PERF_COUNTER_INSTRUCTIONS,
+    PERF_COUNTER_L1D_READ_MISSES,
+    PERF_COUNTER_LLC_MISSES,
+    PERF_COUNTER_BRANCH_MISSES,
+    PERF_COUNTER_COUNT
+};
+
+typedef struct {
+    int64_t values[PERF_COUNTER_COUNT];
+} perf_counters_t;
+
+// returns false if none of the counters could be opened.
+bool open_perf_counters(void);
+bool are_perf_counters_open(void);
+// the counts since open_perf_counters(), scaled up when the kernel had to multiplex the counters.
+void read_perf_counters(perf_counters_t* counters);
+void close_perf_counters(void);
+const char* get_perf_counter_name(int counter);
+
+#endif
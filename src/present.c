@@ -0,0 +1,199 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "present.h"
+#include "profile.h"
+
+static SDL_Thread* present_thread = NULL;
+static SDL_mutex* present_mutex = NULL;
+static SDL_cond* present_cond = NULL;
+static SDL_Window* present_window = NULL;
+static int present_width = 0;
+static int present_height = 0;
+static int buffer_count = 0;
+static uint32_t* buffers[MAX_PRESENT_BUFFER_COUNT];
+static uint64_t acquire_counters[MAX_PRESENT_BUFFER_COUNT];
+
+// frame f is drawn into buffers[f % buffer_count]. everything below is guarded by present_mutex.
+static int acquired_count = 0;
+static int submitted_count = 0;
+static int presented_count = 0;
+static bool should_stop = false;
+static int startup_result = 0; // 1 once the renderer exists, -1 if it could not be created.
+static double latency_sum_ms = 0.0;
+static double latency_max_ms = 0.0;
+static double present_sum_ms = 0.0;
+static double wait_sum_ms = 0.0;
+
+static double get_elapsed_ms(uint64_t start, uint64_t end) {
+    return (double)(end - start) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+}
+
+static int present_thread_main(void* data) {
+    (void)data;
+    PROFILE_THREAD_NAME("present");
+    SDL_Renderer* renderer = SDL_CreateRenderer(present_window, -1, 0);
+    SDL_Texture* texture = NULL;
+    if (renderer != NULL) {
+        texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STREAMING, present_width, present_height);
+    }
+
+    SDL_LockMutex(present_mutex);
+    startup_result = texture != NULL ? 1 : -1;
+    SDL_CondBroadcast(present_cond);
+    while (texture != NULL) {
+        while (presented_count == submitted_count && !should_stop) {
+            SDL_CondWait(present_cond, present_mutex);
+        }
+        // frames already queued are still presented before stopping.
+        if (presented_count == submitted_count) {
+            break;
+        }
+        int buffer_idx = presented_count % buffer_count;
+        SDL_UnlockMutex(present_mutex);
+
+        uint64_t start = SDL_GetPerformanceCounter();
+        {
+            PROFILE_SCOPE("present");
+            SDL_UpdateTexture(texture, NULL, buffers[buffer_idx], (int)(present_width * sizeof(uint32_t)));
+            SDL_RenderCopy(renderer, texture, NULL, NULL);
+            SDL_RenderPresent(renderer);
+        }
+        uint64_t end = SDL_GetPerformanceCounter();
+
+        SDL_LockMutex(present_mutex);
+        double latency_ms = get_elapsed_ms(acquire_counters[buffer_idx], end);
+        latency_sum_ms += latency_ms;
+        latency_max_ms = latency_ms > latency_max_ms ? latency_ms : latency_max_ms;
+        present_sum_ms += get_elapsed_ms(start, end);
+        presented_count += 1;
+        SDL_CondBroadcast(present_cond);
+    }
+    SDL_UnlockMutex(present_mutex);
+
+    if (texture != NULL) {
+        SDL_DestroyTexture(texture);
+    }
+    if (renderer != NULL) {
+        SDL_DestroyRenderer(renderer);
+    }
+    return 0;
+}
+
+static void free_present_resources(void) {
+    for (int buffer_idx = 0; buffer_idx < MAX_PRESENT_BUFFER_COUNT; ++buffer_idx) {
+        free(buffers[buffer_idx]);
+        buffers[buffer_idx] = NULL;
+    }
+    if (present_cond != NULL) {
+        SDL_DestroyCond(present_cond);
+        present_cond = NULL;
+    }
+    if (present_mutex != NULL) {
+        SDL_DestroyMutex(present_mutex);
+        present_mutex = NULL;
+    }
+    present_thread = NULL;
+}
+
+bool start_present_thread(SDL_Window* window, int width, int height, int count) {
+    if (present_thread != NULL || count < 2 || count > MAX_PRESENT_BUFFER_COUNT) {
+        return false;
+    }
+    present_window = window;
+    present_width = width;
+    present_height = height;
+    buffer_count = count;
+    for (int buffer_idx = 0; buffer_idx < buffer_count; ++buffer_idx) {
+        buffers[buffer_idx] = (uint32_t*)malloc(sizeof(uint32_t) * width * height);
+    }
+    acquired_count = 0;
+    submitted_count = 0;
+    presented_count = 0;
+    should_stop = false;
+    startup_result = 0;
+    latency_sum_ms = 0.0;
+    latency_max_ms = 0.0;
+    present_sum_ms = 0.0;
+    wait_sum_ms = 0.0;
+
+    present_mutex = SDL_CreateMutex();
+    present_cond = SDL_CreateCond();
+    present_thread = SDL_CreateThread(present_thread_main, "present", NULL);
+    if (present_thread == NULL) {
+        fprintf(stderr, "unable to start the present thread: %s\n", SDL_GetError());
+        free_present_resources();
+        return false;
+    }
+
+    SDL_LockMutex(present_mutex);
+    while (startup_result == 0) {
+        SDL_CondWait(present_cond, present_mutex);
+    }
+    bool is_started = startup_result > 0;
+    SDL_UnlockMutex(present_mutex);
+    if (!is_started) {
+        fprintf(stderr, "the present thread could not create a renderer: %s\n", SDL_GetError());
+        SDL_WaitThread(present_thread, NULL);
+        free_present_resources();
+    }
+    return is_started;
+}
+
+void stop_present_thread(void) {
+    if (present_thread == NULL) {
+        return;
+    }
+    SDL_LockMutex(present_mutex);
+    should_stop = true;
+    SDL_CondBroadcast(present_cond);
+    SDL_UnlockMutex(present_mutex);
+    SDL_WaitThread(present_thread, NULL);
+    free_present_resources();
+}
+
+bool is_present_thread_running(void) {
+    return present_thread != NULL;
+}
+
+uint32_t* acquire_present_buffer(void) {
+    SDL_LockMutex(present_mutex);
+    uint64_t start = SDL_GetPerformanceCounter();
+    // the buffer of this frame is free once the frame buffer_count before it is on screen.
+    while (acquired_count - presented_count >= buffer_count) {
+        SDL_CondWait(present_cond, present_mutex);
+    }
+    uint64_t end = SDL_GetPerformanceCounter();
+    wait_sum_ms += get_elapsed_ms(start, end);
+
+    int buffer_idx = acquired_count % buffer_count;
+    acquire_counters[buffer_idx] = end;
+    acquired_count += 1;
+    SDL_UnlockMutex(present_mutex);
+    return buffers[buffer_idx];
+}
+
+void submit_present_buffer(void) {
+    SDL_LockMutex(present_mutex);
+    submitted_count = acquired_count;
+    SDL_CondBroadcast(present_cond);
+    SDL_UnlockMutex(present_mutex);
+}
+
+present_stats_t get_present_stats(void) {
+    present_stats_t stats = { 0 };
+    if (present_mutex == NULL) {
+        return stats;
+    }
+    SDL_LockMutex(present_mutex);
+    stats.frame_count = presented_count;
+    if (presented_count > 0) {
+        stats.mean_latency_ms = latency_sum_ms / presented_count;
+        stats.max_latency_ms = latency_max_ms;
+        stats.mean_present_ms = present_sum_ms / presented_count;
+    }
+    if (acquired_count > 0) {
+        stats.mean_wait_ms = wait_sum_ms / acquired_count;
+    }
+    SDL_UnlockMutex(present_mutex);
+    return stats;
+}
@@ -0,0 +1,36 @@
+#ifndef PRESENT_H
+#define PRESENT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <SDL2/SDL.h>
+
+// pipelined presentation: a thread of its own uploads and presents frame N while the main thread transforms and
+// rasterizes frame N + 1 into the next of two or three color buffers. the buffers form a ring, the main thread
+// only waits when every buffer is still queued or on screen, so a frame costs about max(render, present) instead
+// of render + present, at the price of up to buffer_count - 1 frames of extra latency.
+// the present thread creates and owns the SDL renderer, no other thread may touch it while the thread runs.
+
+#define MAX_PRESENT_BUFFER_COUNT 3
+
+typedef struct {
+    int frame_count; // presented since the thread started.
+    double mean_latency_ms; // from acquire_present_buffer() to the frame being presented.
+    double max_latency_ms;
+    double mean_present_ms; // upload and present on the present thread.
+    double mean_wait_ms; // the main thread waiting for a free buffer.
+} present_stats_t;
+
+// returns false if the renderer or its texture can not be created, nothing is left running then.
+bool start_present_thread(SDL_Window* window, int width, int height, int buffer_count);
+void stop_present_thread(void);
+bool is_present_thread_running(void);
+
+// the buffer the next frame is drawn into (width pixels per row), blocks while all of them are in use.
+uint32_t* acquire_present_buffer(void);
+// queues the acquired buffer for presentation and returns right away.
+void submit_present_buffer(void);
+
+present_stats_t get_present_stats(void);
+
+#endif
@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "array.h"
+#include "procedural.h"
+
+#define PROCEDURAL_PREFIX "procedural:"
+// the layers of a stack, in object units.
+#define STACK_LAYER_SPACING 0.025f
+
+uint32_t get_procedural_color(int idx) {
+    static const uint32_t colors[6] = { 0xFFFF8080, 0xFF80FF80, 0xFF8080FF, 0xFFFFFF80, 0xFFFF80FF, 0xFF80FFFF };
+    return colors[idx % 6];
+}
+
+bool is_procedural_geometry_filename(const char* filename) {
+    return strncmp(filename, PROCEDURAL_PREFIX, strlen(PROCEDURAL_PREFIX)) == 0;
+}
+
+static void add_face(geometry_lod_t* lod, int a, int b, int c, tex2_t a_uv, tex2_t b_uv, tex2_t c_uv, uint32_t color) {
+    face_t face = { .a = a, .b = b, .c = c, .a_uv = a_uv, .b_uv = b_uv, .c_uv = c_uv, .color = color };
+    array_push(lod->faces, face);
+}
+
+// rings from pole to pole, twice as many segments around. the poles get one triangle per segment, the rest two.
+static void build_sphere(geometry_lod_t* lod, int triangle_count) {
+    int ring_count = (int)ceil((1.0 + sqrt(1.0 + triangle_count)) / 2.0);
+    ring_count = ring_count < 3 ? 3 : ring_count;
+    int segment_count = ring_count * 2;
+
+    // the seam is duplicated, so u runs from 0 to 1 without wrapping.
+    for (int ring = 0; ring <= ring_count; ++ring) {
+        float theta = M_PI * ring / ring_count;
+        for (int segment = 0; segment <= segment_count; ++segment) {
+            float phi = 2.0 * M_PI * segment / segment_count;
+            vec3_t vertex = vec3_new(sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi));
+            array_push(lod->vertices, vertex);
+        }
+    }
+    int row_length = segment_count + 1;
+    for (int ring = 0; ring < ring_count; ++ring) {
+        for (int segment = 0; segment < segment_count; ++segment) {
+            int a = ring * row_length + segment;
+            int b = a + 1;
+            int c = a + row_length;
+            int d = c + 1;
+            tex2_t a_uv = { (float)segment / segment_count, (float)ring / ring_count };
+            tex2_t b_uv = { (float)(segment + 1) / segment_count, a_uv.v };
+            tex2_t c_uv = { a_uv.u, (float)(ring + 1) / ring_count };
+            tex2_t d_uv = { b_uv.u, c_uv.v };
+            if (ring > 0) {
+                add_face(lod, a, b, c, a_uv, b_uv, c_uv, 0xFFFFFFFF);
+            }
+            if (ring < ring_count - 1) {
+                add_face(lod, b, d, c, b_uv, d_uv, c_uv, 0xFFFFFFFF);
+            }
+        }
+    }
+}
+
+// a unit quad in the xy plane at z cut into cell_count x cell_count cells, every triangle once for either side.
+static void build_grid(geometry_lod_t* lod, int cell_count, float z, uint32_t color) {
+    int first_vertex = array_length(lod->vertices);
+    for (int y = 0; y <= cell_count; ++y) {
+        for (int x = 0; x <= cell_count; ++x) {
+            vec3_t vertex = vec3_new((float)x / cell_count - 0.5f, (float)y / cell_count - 0.5f, z);
+            array_push(lod->vertices, vertex);
+        }
+    }
+    int row_length = cell_count + 1;
+    for (int y = 0; y < cell_count; ++y) {
+        for (int x = 0; x < cell_count; ++x) {
+            int a = first_vertex + y * row_length + x;
+            int b = a + 1;
+            int c = a + row_length;
+            int d = c + 1;
+            tex2_t a_uv = { (float)x / cell_count, 1.0f - (float)y / cell_count };
+            tex2_t b_uv = { (float)(x + 1) / cell_count, a_uv.v };
+            tex2_t c_uv = { a_uv.u, 1.0f - (float)(y + 1) / cell_count };
+            tex2_t d_uv = { b_uv.u, c_uv.v };
+            add_face(lod, a, b, c, a_uv, b_uv, c_uv, color);
+            add_face(lod, b, d, c, b_uv, d_uv, c_uv, color);
+            add_face(lod, a, c, b, a_uv, c_uv, b_uv, color);
+            add_face(lod, b, c, d, b_uv, c_uv, d_uv, color);
+        }
+    }
+}
+
+// layer_count quads along z, farthest first for a camera looking down +z: faces are drawn in order, so from
+// there every layer passes the depth test.
+static void build_stack(geometry_lod_t* lod, int layer_count) {
+    for (int layer_idx = 0; layer_idx < layer_count; ++layer_idx) {
+        float z = ((layer_count - 1) / 2.0f - layer_idx) * STACK_LAYER_SPACING;
+        build_grid(lod, 1, z, get_procedural_color(layer_idx));
+    }
+}
+
+void build_procedural_geometry(const char* filename, geometry_lod_t* lod) {
+    char kind[16] = { 0 };
+    int count = 0;
+    if (sscanf(filename, PROCEDURAL_PREFIX "%15[a-z]:%d", kind, &count) != 2 || count <= 0) {
+        printf("Unable to generate %s: expected procedural:kind:count.\n", filename);
+        return;
+    }
+    if (strcmp(kind, "sphere") == 0) {
+        build_sphere(lod, count);
+    } else if (strcmp(kind, "quad") == 0) {
+        build_grid(lod, 1, 0.0f, 0xFFFFFFFF);
+    } else if (strcmp(kind, "grid") == 0) {
+        // four triangles a cell, two for either side.
+        int cell_count = (int)ceil(sqrt(count / 4.0));
+        build_grid(lod, cell_count, 0.0f, 0xFFFFFFFF);
+    } else if (strcmp(kind, "stack") == 0) {
+        build_stack(lod, count);
+    } else {
+        printf("Unable to generate %s: no such kind, expected sphere, quad, grid or stack.\n", filename);
+    }
+}
@@ -0,0 +1,20 @@
+#ifndef PROCEDURAL_H
+#define PROCEDURAL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "asset.h"
+
+// generated geometry for the stress scenes (see stress_scene.h), built where an OBJ file would be parsed, under asset
+// names of the form "procedural:kind:count":
+//     procedural:sphere:N   a UV sphere of radius 1 with about N triangles.
+//     procedural:quad:1     a unit quad in the xy plane, both sides.
+//     procedural:grid:N     a unit quad in the xy plane cut into about N triangles, both sides.
+//     procedural:stack:N    N unit quads along z, both sides, in back to front order looking down +z.
+// generated geometry keeps its face order and gets no levels of detail, so it draws what it was asked for.
+bool is_procedural_geometry_filename(const char* filename);
+void build_procedural_geometry(const char* filename, geometry_lod_t* lod);
+// a hue per index, so the filled modes tell apart the layers of a stack or the instances of a scene.
+uint32_t get_procedural_color(int idx);
+
+#endif
@@ -0,0 +1,142 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+#include "job.h"
+#include "profile.h"
+
+#if defined(RENDERER_PROFILE)
+
+typedef struct {
+    const char* name;
+    uint64_t start;
+    uint64_t end;
+} profile_event_t;
+
+// written by its own thread only. once full, the oldest event is at next.
+typedef struct {
+    profile_event_t events[PROFILE_RING_SIZE];
+    SDL_atomic_t next;
+    SDL_atomic_t is_full;
+    SDL_threadID thread_id;
+    char name[32];
+} profile_ring_t;
+
+static profile_ring_t* rings[PROFILE_MAX_THREADS];
+static SDL_atomic_t ring_count;
+static THREAD_LOCAL profile_ring_t* thread_ring = NULL;
+static THREAD_LOCAL bool is_thread_untracked = false; // more threads than PROFILE_MAX_THREADS.
+
+static profile_ring_t* get_thread_ring(void) {
+    if (thread_ring != NULL || is_thread_untracked) {
+        return thread_ring;
+    }
+    int ring_idx = SDL_AtomicAdd(&ring_count, 1);
+    if (ring_idx >= PROFILE_MAX_THREADS) {
+        is_thread_untracked = true;
+        return NULL;
+    }
+    profile_ring_t* ring = (profile_ring_t*)calloc(1, sizeof(profile_ring_t));
+    ring->thread_id = SDL_ThreadID();
+    thread_ring = ring;
+    SDL_AtomicSetPtr((void**)&rings[ring_idx], ring);
+    return ring;
+}
+
+profile_scope_t begin_profile_scope(const char* name) {
+    profile_scope_t scope = { name, SDL_GetPerformanceCounter() };
+    return scope;
+}
+
+void end_profile_scope(profile_scope_t* scope) {
+    uint64_t end = SDL_GetPerformanceCounter();
+    profile_ring_t* ring = get_thread_ring();
+    if (ring == NULL) {
+        return;
+    }
+    int event_idx = SDL_AtomicGet(&ring->next);
+    profile_event_t* event = &ring->events[event_idx];
+    event->name = scope->name;
+    event->start = scope->start;
+    event->end = end;
+    if (event_idx + 1 == PROFILE_RING_SIZE) {
+        SDL_AtomicSet(&ring->is_full, 1);
+    }
+    SDL_AtomicSet(&ring->next, (event_idx + 1) & (PROFILE_RING_SIZE - 1));
+}
+
+void set_profile_thread_name(const char* name) {
+    profile_ring_t* ring = get_thread_ring();
+    if (ring != NULL) {
+        snprintf(ring->name, sizeof(ring->name), "%s", name);
+    }
+}
+
+static int get_ring_event_count(profile_ring_t* ring) {
+    return SDL_AtomicGet(&ring->is_full) ? PROFILE_RING_SIZE : SDL_AtomicGet(&ring->next);
+}
+
+// the events a thread records while this runs may or may not make it in, call it between frames.
+bool write_profile_trace(const char* filename) {
+    FILE* file = fopen(filename, "w");
+    if (file == NULL) {
+        printf("Unable to write the trace %s.\n", filename);
+        return false;
+    }
+    int thread_count = SDL_AtomicGet(&ring_count);
+    thread_count = thread_count < PROFILE_MAX_THREADS ? thread_count : PROFILE_MAX_THREADS;
+
+    // timestamps start at the oldest event still held.
+    uint64_t first = UINT64_MAX;
+    for (int thread_idx = 0; thread_idx < thread_count; ++thread_idx) {
+        profile_ring_t* ring = (profile_ring_t*)SDL_AtomicGetPtr((void**)&rings[thread_idx]);
+        int event_count = ring != NULL ? get_ring_event_count(ring) : 0;
+        for (int event_idx = 0; event_idx < event_count; ++event_idx) {
+            uint64_t start = ring->events[event_idx].start;
+            first = start < first ? start : first;
+        }
+    }
+    double us_per_tick = 1e6 / (double)SDL_GetPerformanceFrequency();
+
+    fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    bool is_first_event = true;
+    int written_count = 0;
+    for (int thread_idx = 0; thread_idx < thread_count; ++thread_idx) {
+        profile_ring_t* ring = (profile_ring_t*)SDL_AtomicGetPtr((void**)&rings[thread_idx]);
+        if (ring == NULL) {
+            continue;
+        }
+        char thread_name[32];
+        if (ring->name[0] != '\0') {
+            snprintf(thread_name, sizeof(thread_name), "%s", ring->name);
+        } else {
+            snprintf(thread_name, sizeof(thread_name), "thread %lu", (unsigned long)ring->thread_id);
+        }
+        fprintf(file, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": {\"name\": \"%s\"}}",
+            is_first_event ? "" : ",\n", thread_idx, thread_name);
+        is_first_event = false;
+
+        // oldest first.
+        int event_count = get_ring_event_count(ring);
+        int oldest_idx = event_count == PROFILE_RING_SIZE ? SDL_AtomicGet(&ring->next) : 0;
+        for (int event_idx = 0; event_idx < event_count; ++event_idx) {
+            profile_event_t* event = &ring->events[(oldest_idx + event_idx) & (PROFILE_RING_SIZE - 1)];
+            fprintf(file, ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f}",
+                event->name, thread_idx, (event->start - first) * us_per_tick, (event->end - event->start) * us_per_tick);
+            written_count += 1;
+        }
+    }
+    fprintf(file, "\n]}\n");
+    fclose(file);
+    printf("trace: %d scopes from %d threads written to %s.\n", written_count, thread_count, filename);
+    return true;
+}
+
+#else
+
+bool write_profile_trace(const char* filename) {
+    printf("Unable to write the trace %s: this build does not profile, define RENDERER_PROFILE.\n", filename);
+    return false;
+}
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// scoped timing of the hot paths. PROFILE_SCOPE("name") at the top of a block times the rest of the block, returns
+// and all, and records it into a ring buffer of the calling thread, which keeps the last PROFILE_RING_SIZE scopes
+// (a few frames). write_profile_trace() dumps what the rings hold as Chrome trace JSON, for chrome://tracing or
+// https://ui.perfetto.dev.
+// the macros compile to nothing unless RENDERER_PROFILE is defined, so the scopes stay in the code for free.
+// keep them to per-draw granularity: a scope per pixel or texel would cost more than what it measures.
+
+#define PROFILE_RING_SIZE (1 << 17) // a power of two.
+#define PROFILE_MAX_THREADS 32
+
+// returns false if the trace can not be written, or the build does not profile.
+bool write_profile_trace(const char* filename);
+
+#if defined(RENDERER_PROFILE)
+
+#if !defined(__GNUC__) && !defined(__clang__)
+#error "RENDERER_PROFILE ends the scopes with __attribute__((cleanup)), build it with clang or gcc."
+#endif
+
+typedef struct {
+    const char* name; // a string literal, only the pointer is kept.
+    uint64_t start;
+} profile_scope_t;
+
+profile_scope_t begin_profile_scope(const char* name);
+void end_profile_scope(profile_scope_t* scope);
+// the name the thread has in the trace, the thread id otherwise.
+void set_profile_thread_name(const char* name);
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) \
+    profile_scope_t PROFILE_CONCAT(profile_scope_, __LINE__) __attribute__((cleanup(end_profile_scope))) = begin_profile_scope(name)
+#define PROFILE_THREAD_NAME(name) set_profile_thread_name(name)
+
+#else
+
+#define PROFILE_SCOPE(name)
+#define PROFILE_THREAD_NAME(name)
+
+#endif
+
+#endif
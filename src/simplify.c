@@ -0,0 +1,482 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include "simplify.h"
+#include "array.h"
+
+#define SIMPLIFY_MAX_ITERATION_COUNT 100
+// smallest cosine allowed between a face normal before and after a collapse, rejects folded over faces.
+#define SIMPLIFY_MIN_NORMAL_COSINE 0.2
+#define SIMPLIFY_UV_EPSILON 1e-6f
+
+// symmetric 4x4 matrix stored as its upper triangle: aa ab ac ad bb bc bd cc cd dd.
+typedef struct {
+    double q[10];
+} quadric_t;
+
+// vertex to face adjacency in compressed form, the faces of vertex v are face_indices[offsets[v] .. offsets[v + 1]).
+typedef struct {
+    int* offsets;
+    int* face_indices;
+} adjacency_t;
+
+enum VERTEX_KIND {
+    VERTEX_KIND_MANIFOLD, // free to collapse onto any neighbour.
+    VERTEX_KIND_SEAM, // one of the two vertices a UV seam splits a position into, only slides along the seam.
+    VERTEX_KIND_LOCKED // open boundaries, seam corners and per-face texture coordinate seams never move.
+};
+
+typedef struct {
+    int vertex_count;
+    int face_count;
+    int live_face_count;
+    vec3_t* positions; // normalized copy of the input vertices.
+    face_t* faces;
+    bool* is_face_deleted;
+    quadric_t* quadrics; // one per position group.
+    int* groups; // position group of every vertex.
+    int* siblings; // the other vertex at the same position, or -1.
+    unsigned char* kinds; // one of VERTEX_KIND.
+    bool* is_dirty;
+    adjacency_t adjacency;
+} simplifier_t;
+
+// qsort has no context argument.
+static const vec3_t* simplify_sort_positions = NULL;
+
+static int get_corner_vertex(const face_t* face, int corner) {
+    return corner == 0 ? face->a : (corner == 1 ? face->b : face->c);
+}
+
+static void set_corner_vertex(face_t* face, int corner, int vertex) {
+    if (corner == 0) face->a = vertex;
+    else if (corner == 1) face->b = vertex;
+    else face->c = vertex;
+}
+
+static tex2_t get_corner_uv(const face_t* face, int corner) {
+    return corner == 0 ? face->a_uv : (corner == 1 ? face->b_uv : face->c_uv);
+}
+
+static void set_corner_uv(face_t* face, int corner, tex2_t uv) {
+    if (corner == 0) face->a_uv = uv;
+    else if (corner == 1) face->b_uv = uv;
+    else face->c_uv = uv;
+}
+
+// returns the corner of the face that uses the vertex, or -1.
+static int find_corner(const face_t* face, int vertex) {
+    if (face->a == vertex) return 0;
+    if (face->b == vertex) return 1;
+    if (face->c == vertex) return 2;
+    return -1;
+}
+
+static vec3_t get_face_cross(vec3_t a, vec3_t b, vec3_t c) {
+    return vec3_cross(vec3_sub(b, a), vec3_sub(c, a));
+}
+
+static void quadric_add(quadric_t* lhs, const quadric_t* rhs) {
+    for (int i = 0; i < 10; ++i) {
+        lhs->q[i] += rhs->q[i];
+    }
+}
+
+// squared distance (weighted by face area) from p to all the planes accumulated in the quadric.
+static double quadric_error(const quadric_t* quadric, vec3_t p) {
+    const double* q = quadric->q;
+    double x = p.x, y = p.y, z = p.z;
+    return q[0] * x * x + 2 * q[1] * x * y + 2 * q[2] * x * z + 2 * q[3] * x
+         + q[4] * y * y + 2 * q[5] * y * z + 2 * q[6] * y
+         + q[7] * z * z + 2 * q[8] * z
+         + q[9];
+}
+
+static void build_adjacency(adjacency_t* adjacency, const face_t* faces, const bool* is_face_deleted, int face_count, int vertex_count) {
+    memset(adjacency->offsets, 0, sizeof(int) * (vertex_count + 1));
+    for (int face_idx = 0; face_idx < face_count; ++face_idx) {
+        if (is_face_deleted[face_idx]) {
+            continue;
+        }
+        for (int corner = 0; corner < 3; ++corner) {
+            adjacency->offsets[get_corner_vertex(&faces[face_idx], corner) + 1] += 1;
+        }
+    }
+    for (int vertex_idx = 0; vertex_idx < vertex_count; ++vertex_idx) {
+        adjacency->offsets[vertex_idx + 1] += adjacency->offsets[vertex_idx];
+    }
+
+    int* cursor = (int*)malloc(sizeof(int) * vertex_count);
+    memcpy(cursor, adjacency->offsets, sizeof(int) * vertex_count);
+    for (int face_idx = 0; face_idx < face_count; ++face_idx) {
+        if (is_face_deleted[face_idx]) {
+            continue;
+        }
+        for (int corner = 0; corner < 3; ++corner) {
+            int vertex = get_corner_vertex(&faces[face_idx], corner);
+            adjacency->face_indices[cursor[vertex]++] = face_idx;
+        }
+    }
+    free(cursor);
+}
+
+static int compare_positions(const void* lhs, const void* rhs) {
+    const vec3_t* a = &simplify_sort_positions[*(const int*)lhs];
+    const vec3_t* b = &simplify_sort_positions[*(const int*)rhs];
+    if (a->x != b->x) return a->x < b->x ? -1 : 1;
+    if (a->y != b->y) return a->y < b->y ? -1 : 1;
+    if (a->z != b->z) return a->z < b->z ? -1 : 1;
+    return 0;
+}
+
+static bool is_face_live(const simplifier_t* simplifier, int face_idx) {
+    return !simplifier->is_face_deleted[face_idx];
+}
+
+// number of live faces that share the edge a-b, 1 means it is a border edge.
+static int count_edge_faces(const simplifier_t* simplifier, int a, int b) {
+    int shared_face_count = 0;
+    for (int i = simplifier->adjacency.offsets[a]; i < simplifier->adjacency.offsets[a + 1]; ++i) {
+        int face_idx = simplifier->adjacency.face_indices[i];
+        if (is_face_live(simplifier, face_idx) && find_corner(&simplifier->faces[face_idx], b) != -1) {
+            shared_face_count += 1;
+        }
+    }
+    return shared_face_count;
+}
+
+// the texture coordinate of to on the side of from, taken from a face on the edge.
+static bool find_edge_uv(const simplifier_t* simplifier, int from, int to, tex2_t* uv) {
+    for (int i = simplifier->adjacency.offsets[from]; i < simplifier->adjacency.offsets[from + 1]; ++i) {
+        int face_idx = simplifier->adjacency.face_indices[i];
+        int to_corner = find_corner(&simplifier->faces[face_idx], to);
+        if (is_face_live(simplifier, face_idx) && to_corner != -1) {
+            *uv = get_corner_uv(&simplifier->faces[face_idx], to_corner);
+            return true;
+        }
+    }
+    return false;
+}
+
+// collapsing from onto to would flip or degenerate one of the faces that only move (the ones on the edge disappear).
+static bool collapse_flips_face(const simplifier_t* simplifier, int from, int to) {
+    for (int i = simplifier->adjacency.offsets[from]; i < simplifier->adjacency.offsets[from + 1]; ++i) {
+        int face_idx = simplifier->adjacency.face_indices[i];
+        const face_t* face = &simplifier->faces[face_idx];
+        if (!is_face_live(simplifier, face_idx) || find_corner(face, to) != -1) {
+            continue;
+        }
+
+        vec3_t corners[3];
+        for (int corner = 0; corner < 3; ++corner) {
+            corners[corner] = simplifier->positions[get_corner_vertex(face, corner)];
+        }
+        vec3_t old_normal = get_face_cross(corners[0], corners[1], corners[2]);
+        corners[find_corner(face, from)] = simplifier->positions[to];
+        vec3_t new_normal = get_face_cross(corners[0], corners[1], corners[2]);
+
+        float old_length = vec3_length(old_normal);
+        float new_length = vec3_length(new_normal);
+        if (new_length <= 1e-12f || old_length <= 1e-12f) {
+            return true;
+        }
+        if (vec3_dot(old_normal, new_normal) < SIMPLIFY_MIN_NORMAL_COSINE * old_length * new_length) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// a free vertex may collapse onto any neighbour. a seam vertex only slides along its seam, onto another seam vertex,
+// and its twin on the other side of the seam makes the same move. returns the twin edge in twin_from / twin_to, or -1.
+static bool can_collapse(const simplifier_t* simplifier, int from, int to, int* twin_from, int* twin_to) {
+    *twin_from = -1;
+    *twin_to = -1;
+    if (simplifier->kinds[from] == VERTEX_KIND_MANIFOLD) {
+        return true;
+    }
+    if (simplifier->kinds[from] != VERTEX_KIND_SEAM || simplifier->kinds[to] != VERTEX_KIND_SEAM) {
+        return false;
+    }
+    if (count_edge_faces(simplifier, from, to) != 1) {
+        return false;
+    }
+    *twin_from = simplifier->siblings[from];
+    *twin_to = simplifier->siblings[to];
+    return count_edge_faces(simplifier, *twin_from, *twin_to) == 1;
+}
+
+static void collapse_vertex(simplifier_t* simplifier, int from, int to, tex2_t to_uv) {
+    for (int i = simplifier->adjacency.offsets[from]; i < simplifier->adjacency.offsets[from + 1]; ++i) {
+        int face_idx = simplifier->adjacency.face_indices[i];
+        face_t* face = &simplifier->faces[face_idx];
+        if (!is_face_live(simplifier, face_idx)) {
+            continue;
+        }
+        if (find_corner(face, to) != -1) {
+            simplifier->is_face_deleted[face_idx] = true;
+            simplifier->live_face_count -= 1;
+            continue;
+        }
+        int from_corner = find_corner(face, from);
+        set_corner_vertex(face, from_corner, to);
+        set_corner_uv(face, from_corner, to_uv);
+    }
+}
+
+// sort out which vertices may move. vertices at the same position are welded into a group first:
+// a pair of them along matching border edges is a UV seam split into two vertices, anything else stays put.
+static void classify_vertices(simplifier_t* simplifier) {
+    int vertex_count = simplifier->vertex_count;
+    int* order = (int*)malloc(sizeof(int) * vertex_count);
+    bool* has_uv = (bool*)calloc(vertex_count, sizeof(bool));
+    bool* is_locked = (bool*)calloc(vertex_count, sizeof(bool));
+    bool* is_on_border = (bool*)calloc(vertex_count, sizeof(bool));
+    tex2_t* vertex_uvs = (tex2_t*)malloc(sizeof(tex2_t) * vertex_count);
+    int* group_sizes = (int*)calloc(vertex_count, sizeof(int));
+
+    for (int vertex_idx = 0; vertex_idx < vertex_count; ++vertex_idx) {
+        order[vertex_idx] = vertex_idx;
+    }
+    simplify_sort_positions = simplifier->positions;
+    qsort(order, vertex_count, sizeof(int), compare_positions);
+    int group_count = 0;
+    for (int i = 0; i < vertex_count; ++i) {
+        if (i == 0 || compare_positions(&order[i - 1], &order[i]) != 0) {
+            group_count += 1;
+        }
+        simplifier->groups[order[i]] = group_count - 1;
+        group_sizes[group_count - 1] += 1;
+        simplifier->siblings[order[i]] = -1;
+        if (i > 0 && simplifier->groups[order[i - 1]] == group_count - 1) {
+            simplifier->siblings[order[i]] = order[i - 1];
+            simplifier->siblings[order[i - 1]] = order[i];
+        }
+    }
+
+    for (int vertex_idx = 0; vertex_idx < vertex_count; ++vertex_idx) {
+        if (group_sizes[simplifier->groups[vertex_idx]] > 2) {
+            is_locked[vertex_idx] = true;
+        }
+    }
+
+    // one vertex with a different texture coordinate in two of its faces is a seam that cannot be slid along.
+    for (int face_idx = 0; face_idx < simplifier->face_count; ++face_idx) {
+        for (int corner = 0; corner < 3; ++corner) {
+            int vertex = get_corner_vertex(&simplifier->faces[face_idx], corner);
+            tex2_t uv = get_corner_uv(&simplifier->faces[face_idx], corner);
+            if (!has_uv[vertex]) {
+                has_uv[vertex] = true;
+                vertex_uvs[vertex] = uv;
+            } else if (fabsf(vertex_uvs[vertex].u - uv.u) > SIMPLIFY_UV_EPSILON || fabsf(vertex_uvs[vertex].v - uv.v) > SIMPLIFY_UV_EPSILON) {
+                is_locked[vertex] = true;
+            }
+        }
+    }
+
+    // border edges without a twin border edge on the sibling vertices are open boundaries.
+    for (int face_idx = 0; face_idx < simplifier->face_count; ++face_idx) {
+        for (int corner = 0; corner < 3; ++corner) {
+            int a = get_corner_vertex(&simplifier->faces[face_idx], corner);
+            int b = get_corner_vertex(&simplifier->faces[face_idx], (corner + 1) % 3);
+            if (count_edge_faces(simplifier, a, b) != 1) {
+                continue;
+            }
+            is_on_border[a] = true;
+            is_on_border[b] = true;
+            int twin_a = simplifier->siblings[a];
+            int twin_b = simplifier->siblings[b];
+            if (twin_a == -1 || twin_b == -1 || count_edge_faces(simplifier, twin_a, twin_b) != 1) {
+                is_locked[a] = true;
+                is_locked[b] = true;
+            }
+        }
+    }
+
+    for (int vertex_idx = 0; vertex_idx < vertex_count; ++vertex_idx) {
+        int sibling = simplifier->siblings[vertex_idx];
+        if (sibling == -1 && !is_on_border[vertex_idx]) {
+            simplifier->kinds[vertex_idx] = is_locked[vertex_idx] ? VERTEX_KIND_LOCKED : VERTEX_KIND_MANIFOLD;
+        } else if (sibling != -1 && is_on_border[vertex_idx] && is_on_border[sibling] && !is_locked[vertex_idx] && !is_locked[sibling]) {
+            simplifier->kinds[vertex_idx] = VERTEX_KIND_SEAM;
+        } else {
+            simplifier->kinds[vertex_idx] = VERTEX_KIND_LOCKED;
+        }
+    }
+
+    free(group_sizes);
+    free(vertex_uvs);
+    free(is_on_border);
+    free(is_locked);
+    free(has_uv);
+    free(order);
+}
+
+int simplify_mesh(const vec3_t* vertices, const face_t* faces, int target_face_count,
+                  vec3_t** out_vertices, face_t** out_faces) {
+    int vertex_count = array_length((void*)vertices);
+    int face_count = array_length((void*)faces);
+
+    simplifier_t simplifier = {
+        .vertex_count = vertex_count,
+        .face_count = face_count,
+        .live_face_count = face_count,
+        .positions = (vec3_t*)malloc(sizeof(vec3_t) * vertex_count),
+        .faces = (face_t*)malloc(sizeof(face_t) * face_count),
+        .is_face_deleted = (bool*)calloc(face_count, sizeof(bool)),
+        .quadrics = (quadric_t*)calloc(vertex_count, sizeof(quadric_t)),
+        .groups = (int*)malloc(sizeof(int) * vertex_count),
+        .siblings = (int*)malloc(sizeof(int) * vertex_count),
+        .kinds = (unsigned char*)malloc(vertex_count),
+        .is_dirty = (bool*)calloc(vertex_count, sizeof(bool)),
+        .adjacency = {
+            .offsets = (int*)malloc(sizeof(int) * (vertex_count + 1)),
+            .face_indices = (int*)malloc(sizeof(int) * face_count * 3)
+        }
+    };
+    memcpy(simplifier.faces, faces, sizeof(face_t) * face_count);
+
+    // normalize to a unit sized box, so the error thresholds below do not depend on the model scale.
+    vec3_t min = vertex_count > 0 ? vertices[0] : vec3_new(0, 0, 0);
+    vec3_t max = min;
+    for (int vertex_idx = 0; vertex_idx < vertex_count; ++vertex_idx) {
+        vec3_t v = vertices[vertex_idx];
+        min = vec3_new(fminf(min.x, v.x), fminf(min.y, v.y), fminf(min.z, v.z));
+        max = vec3_new(fmaxf(max.x, v.x), fmaxf(max.y, v.y), fmaxf(max.z, v.z));
+    }
+    float extent = vec3_length(vec3_sub(max, min));
+    float inverse_extent = extent > 0.0f ? 1.0f / extent : 1.0f;
+    for (int vertex_idx = 0; vertex_idx < vertex_count; ++vertex_idx) {
+        simplifier.positions[vertex_idx] = vec3_mul(vec3_sub(vertices[vertex_idx], min), inverse_extent);
+    }
+
+    build_adjacency(&simplifier.adjacency, simplifier.faces, simplifier.is_face_deleted, face_count, vertex_count);
+    classify_vertices(&simplifier);
+
+    // every position starts with the area weighted planes of its faces. both sides of a seam share one quadric.
+    for (int face_idx = 0; face_idx < face_count; ++face_idx) {
+        face_t* face = &simplifier.faces[face_idx];
+        vec3_t normal = get_face_cross(simplifier.positions[face->a], simplifier.positions[face->b], simplifier.positions[face->c]);
+        float area = vec3_length(normal) * 0.5f;
+        if (area <= 0.0f) {
+            continue;
+        }
+        vec3_normalize(&normal);
+        double a = normal.x, b = normal.y, c = normal.z;
+        double d = -vec3_dot(normal, simplifier.positions[face->a]);
+        quadric_t plane = {{ a * a, a * b, a * c, a * d, b * b, b * c, b * d, c * c, c * d, d * d }};
+        for (int i = 0; i < 10; ++i) {
+            plane.q[i] *= area;
+        }
+        for (int corner = 0; corner < 3; ++corner) {
+            quadric_add(&simplifier.quadrics[simplifier.groups[get_corner_vertex(face, corner)]], &plane);
+        }
+    }
+
+    // collapse the cheapest edges first by raising the allowed error every pass.
+    // a vertex touched by a collapse waits for the next pass, when the adjacency is rebuilt.
+    for (int iteration = 0; iteration < SIMPLIFY_MAX_ITERATION_COUNT && simplifier.live_face_count > target_face_count; ++iteration) {
+        double threshold = 1e-9 * pow(iteration + 3, 7);
+        if (iteration > 0) {
+            build_adjacency(&simplifier.adjacency, simplifier.faces, simplifier.is_face_deleted, face_count, vertex_count);
+        }
+        memset(simplifier.is_dirty, 0, sizeof(bool) * vertex_count);
+
+        for (int face_idx = 0; face_idx < face_count && simplifier.live_face_count > target_face_count; ++face_idx) {
+            if (!is_face_live(&simplifier, face_idx)) {
+                continue;
+            }
+
+            for (int corner = 0; corner < 3; ++corner) {
+                int a = get_corner_vertex(&simplifier.faces[face_idx], corner);
+                int b = get_corner_vertex(&simplifier.faces[face_idx], (corner + 1) % 3);
+                if (simplifier.is_dirty[a] || simplifier.is_dirty[b]) {
+                    continue;
+                }
+
+                // collapse the edge in whichever direction is allowed and cheaper.
+                quadric_t merged = simplifier.quadrics[simplifier.groups[a]];
+                quadric_add(&merged, &simplifier.quadrics[simplifier.groups[b]]);
+                int twin_from_forward, twin_to_forward, twin_from_backward, twin_to_backward;
+                double error_forward = can_collapse(&simplifier, a, b, &twin_from_forward, &twin_to_forward) ? quadric_error(&merged, simplifier.positions[b]) : INFINITY;
+                double error_backward = can_collapse(&simplifier, b, a, &twin_from_backward, &twin_to_backward) ? quadric_error(&merged, simplifier.positions[a]) : INFINITY;
+
+                int from = a, to = b, twin_from = twin_from_forward, twin_to = twin_to_forward;
+                if (error_backward < error_forward) {
+                    from = b;
+                    to = a;
+                    twin_from = twin_from_backward;
+                    twin_to = twin_to_backward;
+                }
+                if (fmin(error_forward, error_backward) > threshold) {
+                    continue;
+                }
+
+                bool has_twin = twin_from != -1;
+                if (has_twin && (simplifier.is_dirty[twin_from] || simplifier.is_dirty[twin_to])) {
+                    continue;
+                }
+                if (collapse_flips_face(&simplifier, from, to) || (has_twin && collapse_flips_face(&simplifier, twin_from, twin_to))) {
+                    continue;
+                }
+
+                // the surviving faces around from take the texture coordinate to has on their side of any seam,
+                // which is the one it has in the faces on the collapsed edge.
+                tex2_t to_uv, twin_to_uv;
+                if (!find_edge_uv(&simplifier, from, to, &to_uv) || (has_twin && !find_edge_uv(&simplifier, twin_from, twin_to, &twin_to_uv))) {
+                    continue;
+                }
+                collapse_vertex(&simplifier, from, to, to_uv);
+                simplifier.is_dirty[from] = true;
+                simplifier.is_dirty[to] = true;
+                if (has_twin) {
+                    collapse_vertex(&simplifier, twin_from, twin_to, twin_to_uv);
+                    simplifier.is_dirty[twin_from] = true;
+                    simplifier.is_dirty[twin_to] = true;
+                }
+                simplifier.quadrics[simplifier.groups[to]] = merged;
+                break;
+            }
+        }
+    }
+
+    // compact the surviving faces and the vertices they still use.
+    int* remap = (int*)malloc(sizeof(int) * vertex_count);
+    vec3_t* simplified_vertices = NULL;
+    face_t* simplified_faces = NULL;
+    for (int vertex_idx = 0; vertex_idx < vertex_count; ++vertex_idx) {
+        remap[vertex_idx] = -1;
+    }
+    for (int face_idx = 0; face_idx < face_count; ++face_idx) {
+        if (!is_face_live(&simplifier, face_idx)) {
+            continue;
+        }
+        face_t face = simplifier.faces[face_idx];
+        for (int corner = 0; corner < 3; ++corner) {
+            int vertex = get_corner_vertex(&face, corner);
+            if (remap[vertex] == -1) {
+                remap[vertex] = array_length(simplified_vertices);
+                array_push(simplified_vertices, vertices[vertex]);
+            }
+            set_corner_vertex(&face, corner, remap[vertex]);
+        }
+        array_push(simplified_faces, face);
+    }
+    free(remap);
+
+    free(simplifier.adjacency.face_indices);
+    free(simplifier.adjacency.offsets);
+    free(simplifier.is_dirty);
+    free(simplifier.kinds);
+    free(simplifier.siblings);
+    free(simplifier.groups);
+    free(simplifier.quadrics);
+    free(simplifier.is_face_deleted);
+    free(simplifier.faces);
+    free(simplifier.positions);
+
+    *out_vertices = simplified_vertices;
+    *out_faces = simplified_faces;
+    return array_length(simplified_faces);
+}
@@ -0,0 +1,14 @@
+#ifndef SIMPLIFY_H
+#define SIMPLIFY_H
+
+#include "vector.h"
+#include "triangle.h"
+
+// quadric error metric edge collapse (Garland & Heckbert), collapsing each edge onto one of its endpoints.
+// vertices on a UV seam or an open boundary are never moved, so texture seams and silhouettes of open meshes are kept.
+// writes new dynamic arrays (see array.h) to out_vertices and out_faces, the input is left untouched.
+// returns the number of faces in the simplified mesh.
+int simplify_mesh(const vec3_t* vertices, const face_t* faces, int target_face_count,
+                  vec3_t** out_vertices, face_t** out_faces);
+
+#endif
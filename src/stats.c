@@ -0,0 +1,76 @@
+#include <stdio.h>
+#include <string.h>
+#include "display.h"
+#include "stats.h"
+
+static pipeline_stats_t frame_stats;
+static pipeline_stats_t last_frame_stats;
+static pipeline_stats_t run_stats;
+static int run_frame_count = 0;
+static bool is_coverage_counted = false;
+
+pipeline_stats_t* get_frame_pipeline_stats(void) {
+    return &frame_stats;
+}
+
+void begin_pipeline_stats_frame(void) {
+    memset(&frame_stats, 0, sizeof(frame_stats));
+}
+
+void end_pipeline_stats_frame(void) {
+    if (is_coverage_counted) {
+        frame_stats.pixels_covered = count_covered_pixels();
+    }
+    last_frame_stats = frame_stats;
+
+    // the struct is nothing but counters.
+    int64_t* totals = (int64_t*)&run_stats;
+    const int64_t* counters = (const int64_t*)&frame_stats;
+    for (int counter_idx = 0; counter_idx < (int)(sizeof(pipeline_stats_t) / sizeof(int64_t)); ++counter_idx) {
+        totals[counter_idx] += counters[counter_idx];
+    }
+    run_frame_count += 1;
+}
+
+pipeline_stats_t get_pipeline_stats(void) {
+    return last_frame_stats;
+}
+
+pipeline_stats_t get_pipeline_stats_totals(int* frame_count) {
+    *frame_count = run_frame_count;
+    return run_stats;
+}
+
+void start_pipeline_stats_run(void) {
+    memset(&run_stats, 0, sizeof(run_stats));
+    run_frame_count = 0;
+}
+
+void set_pixel_coverage_counting(bool is_enabled) {
+    is_coverage_counted = is_enabled;
+}
+
+bool is_pixel_coverage_counting(void) {
+    return is_coverage_counted;
+}
+
+float get_average_overdraw(const pipeline_stats_t* stats) {
+    return stats->pixels_covered > 0 ? (float)stats->fragments_written / (float)stats->pixels_covered : 0.0f;
+}
+
+void print_pipeline_stats(const pipeline_stats_t* stats, int frame_count) {
+    double count = frame_count > 0 ? (double)frame_count : 1.0;
+    double faces = stats->faces_processed > 0 ? (double)stats->faces_processed : 1.0;
+    double fragments = stats->fragments_tested > 0 ? (double)stats->fragments_tested : 1.0;
+    printf("instances %.0f (%.0f occluded), faces %.0f: %.0f backface culled (%.1f%%), %.0f frustum rejected (%.1f%%), %.0f clipped (%.1f%%), %.0f triangles emitted\n",
+        stats->instances_processed / count, stats->instances_occluded / count, stats->faces_processed / count,
+        stats->faces_backface_culled / count, stats->faces_backface_culled * 100.0 / faces,
+        stats->faces_frustum_rejected / count, stats->faces_frustum_rejected * 100.0 / faces,
+        stats->faces_clipped / count, stats->faces_clipped * 100.0 / faces, stats->triangles_emitted / count);
+    printf("fragments %.0f tested, %.0f written (%.1f%%)", stats->fragments_tested / count, stats->fragments_written / count,
+        stats->fragments_written * 100.0 / fragments);
+    if (stats->pixels_covered > 0) {
+        printf(", %.0f pixels covered, overdraw %.2f", stats->pixels_covered / count, get_average_overdraw(stats));
+    }
+    printf("\n");
+}
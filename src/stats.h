@@ -0,0 +1,42 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// pipeline counters: how much work every stage of a frame did. the stages add to the counters of the frame being
+// drawn, end_pipeline_stats_frame() closes it and adds it to the totals of the run.
+typedef struct {
+    int64_t instances_processed; // in the frustum, through the geometry stage or rejected by occlusion.
+    int64_t instances_occluded;
+    int64_t faces_processed;
+    int64_t faces_backface_culled;
+    int64_t faces_frustum_rejected; // clipped away entirely.
+    int64_t faces_clipped; // cut by at least one frustum plane, and kept.
+    int64_t triangles_emitted; // to the rasterizer, after clipping and triangulation.
+    int64_t fragments_tested; // against the z buffer. wireframe lines do not depth test and are not counted.
+    int64_t fragments_written;
+    int64_t pixels_covered; // written at least once, only counted with set_pixel_coverage_counting().
+} pipeline_stats_t;
+
+// the frame being drawn, for the stages to add to.
+pipeline_stats_t* get_frame_pipeline_stats(void);
+void begin_pipeline_stats_frame(void);
+void end_pipeline_stats_frame(void);
+
+// the last frame that ended.
+pipeline_stats_t get_pipeline_stats(void);
+// every frame since the run started, and how many.
+pipeline_stats_t get_pipeline_stats_totals(int* frame_count);
+void start_pipeline_stats_run(void);
+
+// finding the covered pixels takes a pass over the z buffer at the end of every frame, so it is off by default.
+void set_pixel_coverage_counting(bool is_enabled);
+bool is_pixel_coverage_counting(void);
+
+// fragments written per covered pixel, 0 when the coverage is not counted.
+float get_average_overdraw(const pipeline_stats_t* stats);
+// prints the counters divided by frame_count: 1 for a frame, the frame count of a run for its averages.
+void print_pipeline_stats(const pipeline_stats_t* stats, int frame_count);
+
+#endif
@@ -0,0 +1,422 @@
+#if !defined(_WIN32)
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "stream.h"
+#include "array.h"
+#include "job.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+static stream_cell_t* cells = NULL; // malloc'd, cell_count long.
+static int cell_count = 0;
+static bool is_open = false;
+static size_t memory_budget = DEFAULT_STREAM_MEMORY_BUDGET;
+static float stream_radius = DEFAULT_STREAM_RADIUS;
+static size_t resident_bytes = 0; // recounted every update, so a cell that failed to map drops out by itself.
+// dynamic arrays, refilled every update.
+static stream_cell_t** resident_cells = NULL;
+static stream_cell_t** missing_cells = NULL;
+// textures of evicted cells whose read or decode was still in flight. releasing one of those waits for every job,
+// so they are held here until their job is done, see release_finished_textures().
+static texture_t** pending_texture_releases = NULL;
+
+#if defined(_WIN32)
+static HANDLE stream_file = INVALID_HANDLE_VALUE;
+static HANDLE stream_file_mapping = NULL;
+#else
+static int stream_file = -1;
+#endif
+
+// cell files can be bigger than a long (32 bits on windows) can address. leaves the position where it was.
+static uint64_t get_file_size(FILE* file) {
+#if defined(_WIN32)
+    __int64 position = _ftelli64(file);
+    _fseeki64(file, 0, SEEK_END);
+    uint64_t size = (uint64_t)_ftelli64(file);
+    _fseeki64(file, position, SEEK_SET);
+#else
+    off_t position = ftello(file);
+    fseeko(file, 0, SEEK_END);
+    uint64_t size = (uint64_t)ftello(file);
+    fseeko(file, position, SEEK_SET);
+#endif
+    return size;
+}
+
+static bool open_stream_file(const char* filename) {
+#if defined(_WIN32)
+    stream_file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (stream_file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    stream_file_mapping = CreateFileMappingA(stream_file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (stream_file_mapping == NULL) {
+        CloseHandle(stream_file);
+        stream_file = INVALID_HANDLE_VALUE;
+        return false;
+    }
+    return true;
+#else
+    stream_file = open(filename, O_RDONLY);
+    return stream_file >= 0;
+#endif
+}
+
+static void close_stream_file(void) {
+#if defined(_WIN32)
+    if (stream_file_mapping != NULL) {
+        CloseHandle(stream_file_mapping);
+        stream_file_mapping = NULL;
+    }
+    if (stream_file != INVALID_HANDLE_VALUE) {
+        CloseHandle(stream_file);
+        stream_file = INVALID_HANDLE_VALUE;
+    }
+#else
+    if (stream_file >= 0) {
+        close(stream_file);
+        stream_file = -1;
+    }
+#endif
+}
+
+// views have to start at a multiple of the allocation granularity (64KB on windows), which can be before the cell.
+// returns a pointer to the first byte of the cell, or NULL. safe to call from a job.
+static unsigned char* map_stream_range(uint64_t offset, uint64_t size, void** mapping, size_t* mapping_size) {
+#if defined(_WIN32)
+    SYSTEM_INFO system_info;
+    GetSystemInfo(&system_info);
+    uint64_t granularity = system_info.dwAllocationGranularity;
+#else
+    uint64_t granularity = (uint64_t)sysconf(_SC_PAGESIZE);
+#endif
+    uint64_t view_offset = offset - offset % granularity;
+    *mapping_size = (size_t)(offset - view_offset + size);
+
+#if defined(_WIN32)
+    *mapping = MapViewOfFile(stream_file_mapping, FILE_MAP_READ, (DWORD)(view_offset >> 32), (DWORD)view_offset, *mapping_size);
+    if (*mapping == NULL) {
+        return NULL;
+    }
+#else
+    *mapping = mmap(NULL, *mapping_size, PROT_READ, MAP_PRIVATE, stream_file, (off_t)view_offset);
+    if (*mapping == MAP_FAILED) {
+        *mapping = NULL;
+        return NULL;
+    }
+#endif
+    return (unsigned char*)*mapping + (offset - view_offset);
+}
+
+static void unmap_stream_range(void* mapping, size_t mapping_size) {
+#if defined(_WIN32)
+    (void)mapping_size;
+    UnmapViewOfFile(mapping);
+#else
+    munmap(mapping, mapping_size);
+#endif
+}
+
+// every array of the record fits in the cell at an int aligned offset, and the cell fits in the file. what the arrays
+// hold is only known once the cell is mapped, see load_stream_cell_job().
+static bool is_stream_cell_record_valid(const stream_cell_record_t* record, uint64_t file_size) {
+    uint32_t offsets[3] = { record->vertices_offset, record->faces_offset, record->face_normals_offset };
+    uint64_t sizes[3] = {
+        (uint64_t)record->vertex_count * sizeof(vec3_t),
+        (uint64_t)record->face_count * sizeof(face_t),
+        (uint64_t)record->face_count * sizeof(vec3_t)
+    };
+    if (record->offset > file_size || record->size > file_size - record->offset) {
+        return false;
+    }
+    for (int array_idx = 0; array_idx < 3; ++array_idx) {
+        if (offsets[array_idx] % sizeof(int) != 0 || (uint64_t)offsets[array_idx] + ARRAY_HEADER_SIZE + sizes[array_idx] > record->size) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// maps the cell and touches every page, so the page faults happen here and not in the frame loop.
+static void load_stream_cell_job(void* data) {
+    stream_cell_t* cell = (stream_cell_t*)data;
+    stream_cell_record_t* record = &cell->record;
+
+    unsigned char* cell_data = map_stream_range(record->offset, record->size, &cell->mapping, &cell->mapping_size);
+    if (cell_data == NULL) {
+        fprintf(stderr, "unable to map stream cell at offset %llu.\n", (unsigned long long)record->offset);
+        SDL_AtomicSet(&cell->state, STREAM_CELL_STATE_FAILED);
+        return;
+    }
+
+    volatile unsigned char page_sum = 0;
+    for (uint64_t page_offset = 0; page_offset < record->size; page_offset += STREAM_PAGE_SIZE) {
+        page_sum += cell_data[page_offset];
+    }
+
+    geometry_lod_t* lod = &cell->geometry.lods[0];
+    lod->vertices = (vec3_t*)(cell_data + record->vertices_offset + ARRAY_HEADER_SIZE);
+    lod->faces = (face_t*)(cell_data + record->faces_offset + ARRAY_HEADER_SIZE);
+    lod->face_normals = (vec3_t*)(cell_data + record->face_normals_offset + ARRAY_HEADER_SIZE);
+    if (!is_geometry_lod_data_valid(cell_data, record->size, record->vertices_offset, record->faces_offset, record->face_normals_offset) ||
+        array_length(lod->vertices) != (int)record->vertex_count || array_length(lod->faces) != (int)record->face_count) {
+        fprintf(stderr, "stream cell at offset %llu is corrupt.\n", (unsigned long long)record->offset);
+        memset(lod, 0, sizeof(geometry_lod_t));
+        unmap_stream_range(cell->mapping, cell->mapping_size);
+        cell->mapping = NULL;
+        cell->mapping_size = 0;
+        SDL_AtomicSet(&cell->state, STREAM_CELL_STATE_FAILED);
+        return;
+    }
+    SDL_AtomicSet(&cell->geometry.is_ready, 1);
+    SDL_AtomicSet(&cell->state, STREAM_CELL_STATE_RESIDENT);
+}
+
+bool open_scene_stream(const char* filename) {
+    close_scene_stream();
+
+    FILE* file = fopen(filename, "rb");
+    if (file == NULL) {
+        printf("Unable to open the scene stream %s.\n", filename);
+        return false;
+    }
+
+    stream_file_header_t header;
+    if (fread(&header, sizeof(header), 1, file) != 1 ||
+        memcmp(header.magic, STREAM_FILE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != STREAM_FILE_VERSION ||
+        header.vertex_size != sizeof(vec3_t) ||
+        header.face_size != sizeof(face_t)) {
+        printf("%s is not a scene stream written by this build.\n", filename);
+        fclose(file);
+        return false;
+    }
+
+    uint64_t file_size = get_file_size(file);
+    cells = (stream_cell_t*)calloc(header.cell_count > 0 ? header.cell_count : 1, sizeof(stream_cell_t));
+    for (uint32_t cell_idx = 0; cell_idx < header.cell_count; ++cell_idx) {
+        stream_cell_t* cell = &cells[cell_idx];
+        if (fread(&cell->record, sizeof(stream_cell_record_t), 1, file) != 1) {
+            printf("%s is truncated.\n", filename);
+            free(cells);
+            cells = NULL;
+            fclose(file);
+            return false;
+        }
+
+        // a stale or truncated file keeps its good cells, the bad ones are never mapped.
+        if (is_stream_cell_record_valid(&cell->record, file_size)) {
+            SDL_AtomicSet(&cell->state, STREAM_CELL_STATE_UNLOADED);
+        } else {
+            printf("%s: cell %u does not fit in the file.\n", filename, cell_idx);
+            SDL_AtomicSet(&cell->state, STREAM_CELL_STATE_FAILED);
+        }
+        strncpy(cell->geometry.filename, filename, MAX_ASSET_FILENAME_LENGTH - 1);
+        cell->geometry.lod_count = 1;
+        cell->geometry.bounds_center = cell->record.bounds_center;
+        cell->geometry.bounds_radius = cell->record.bounds_radius;
+        cell->instance = make_mesh_instance(vec3_new(1.0, 1.0, 1.0), vec3_new(0.0, 0.0, 0.0), vec3_new(0.0, 0.0, 0.0), 0xFFFFFFFF);
+    }
+    fclose(file);
+
+    if (!open_stream_file(filename)) {
+        printf("Unable to map the scene stream %s.\n", filename);
+        free(cells);
+        cells = NULL;
+        return false;
+    }
+
+    cell_count = (int)header.cell_count;
+    resident_bytes = 0;
+    is_open = true;
+    return true;
+}
+
+static bool is_texture_job_in_flight(texture_t* texture) {
+    int state = SDL_AtomicGet(&texture->state);
+    return state == TEXTURE_STATE_UNLOADED || state == TEXTURE_STATE_DECODING;
+}
+
+static void release_finished_textures(void) {
+    int kept_count = 0;
+    for (int texture_idx = 0; texture_idx < array_length(pending_texture_releases); ++texture_idx) {
+        texture_t* texture = pending_texture_releases[texture_idx];
+        if (is_texture_job_in_flight(texture)) {
+            pending_texture_releases[kept_count++] = texture;
+        } else {
+            release_texture_asset(texture);
+        }
+    }
+    array_truncate(pending_texture_releases, kept_count);
+}
+
+static void evict_stream_cell(stream_cell_t* cell) {
+    if (cell->texture != NULL && is_texture_job_in_flight(cell->texture)) {
+        array_push(pending_texture_releases, cell->texture);
+    } else {
+        release_texture_asset(cell->texture);
+    }
+    cell->texture = NULL;
+    unmap_stream_range(cell->mapping, cell->mapping_size);
+    cell->mapping = NULL;
+    cell->mapping_size = 0;
+    memset(&cell->geometry.lods[0], 0, sizeof(geometry_lod_t));
+    SDL_AtomicSet(&cell->geometry.is_ready, 0);
+    SDL_AtomicSet(&cell->state, STREAM_CELL_STATE_UNLOADED);
+}
+
+void close_scene_stream(void) {
+    if (!is_open) {
+        return;
+    }
+
+    // loads in flight write into the cells.
+    wait_for_jobs();
+    for (int cell_idx = 0; cell_idx < cell_count; ++cell_idx) {
+        if (SDL_AtomicGet(&cells[cell_idx].state) == STREAM_CELL_STATE_RESIDENT) {
+            evict_stream_cell(&cells[cell_idx]);
+        }
+    }
+    // every job is done, so nothing is held back anymore.
+    release_finished_textures();
+    array_free(pending_texture_releases);
+    pending_texture_releases = NULL;
+    close_stream_file();
+    free(cells);
+    cells = NULL;
+    cell_count = 0;
+    array_free(resident_cells);
+    array_free(missing_cells);
+    resident_cells = NULL;
+    missing_cells = NULL;
+    is_open = false;
+}
+
+bool is_scene_stream_open(void) {
+    return is_open;
+}
+
+static int compare_camera_distances(const void* lhs, const void* rhs) {
+    float a = (*(stream_cell_t* const*)lhs)->camera_distance;
+    float b = (*(stream_cell_t* const*)rhs)->camera_distance;
+    return a < b ? -1 : (a > b ? 1 : 0);
+}
+
+// the resident cell furthest from the camera, if it is further than distance.
+static stream_cell_t* find_furthest_resident_cell(float distance) {
+    stream_cell_t* furthest = NULL;
+    for (int resident_idx = 0; resident_idx < array_length(resident_cells); ++resident_idx) {
+        stream_cell_t* cell = resident_cells[resident_idx];
+        if (SDL_AtomicGet(&cell->state) == STREAM_CELL_STATE_RESIDENT && cell->camera_distance > distance &&
+            (furthest == NULL || cell->camera_distance > furthest->camera_distance)) {
+            furthest = cell;
+        }
+    }
+    return furthest;
+}
+
+void update_scene_stream(vec3_t camera_position) {
+    if (!is_open) {
+        return;
+    }
+
+    release_finished_textures();
+    array_clear(resident_cells);
+    array_clear(missing_cells);
+    int loading_count = 0;
+    resident_bytes = 0;
+    float evict_radius = stream_radius * (1.0f + STREAM_RADIUS_HYSTERESIS);
+
+    for (int cell_idx = 0; cell_idx < cell_count; ++cell_idx) {
+        stream_cell_t* cell = &cells[cell_idx];
+        float distance = vec3_length(vec3_sub(cell->record.bounds_center, camera_position)) - cell->record.bounds_radius;
+        cell->camera_distance = distance > 0.0f ? distance : 0.0f;
+
+        int state = SDL_AtomicGet(&cell->state);
+        if (state == STREAM_CELL_STATE_LOADING) {
+            loading_count += 1;
+            resident_bytes += cell->record.size;
+        } else if (state == STREAM_CELL_STATE_RESIDENT) {
+            if (cell->camera_distance > evict_radius) {
+                evict_stream_cell(cell);
+                continue;
+            }
+            // finished loading since the last update. the texture is read on the job system, decoded once it is sampled.
+            if (cell->texture == NULL && cell->record.texture_filename[0] != '\0') {
+                cell->texture = load_texture_asset(cell->record.texture_filename);
+            }
+            resident_bytes += cell->record.size;
+            array_push(resident_cells, cell);
+        } else if (state == STREAM_CELL_STATE_UNLOADED && cell->camera_distance < stream_radius) {
+            array_push(missing_cells, cell);
+        }
+    }
+
+    // nearest first. a cell that does not fit pushes out resident cells that are further away, never nearer ones.
+    if (array_length(missing_cells) > 1) {
+        qsort(missing_cells, array_length(missing_cells), sizeof(stream_cell_t*), compare_camera_distances);
+    }
+    for (int missing_idx = 0; missing_idx < array_length(missing_cells) && loading_count < MAX_PENDING_STREAM_LOADS; ++missing_idx) {
+        stream_cell_t* cell = missing_cells[missing_idx];
+        while (resident_bytes + cell->record.size > memory_budget) {
+            stream_cell_t* furthest = find_furthest_resident_cell(cell->camera_distance);
+            if (furthest == NULL) {
+                break;
+            }
+            evict_stream_cell(furthest);
+            resident_bytes -= furthest->record.size;
+        }
+        if (resident_bytes + cell->record.size > memory_budget) {
+            break;
+        }
+
+        resident_bytes += cell->record.size;
+        loading_count += 1;
+        SDL_AtomicSet(&cell->state, STREAM_CELL_STATE_LOADING);
+        submit_job(load_stream_cell_job, cell);
+    }
+
+    // drop whatever was evicted for the budget from the list handed to the renderer.
+    int kept_count = 0;
+    for (int resident_idx = 0; resident_idx < array_length(resident_cells); ++resident_idx) {
+        if (SDL_AtomicGet(&resident_cells[resident_idx]->state) == STREAM_CELL_STATE_RESIDENT) {
+            resident_cells[kept_count++] = resident_cells[resident_idx];
+        }
+    }
+    array_truncate(resident_cells, kept_count);
+}
+
+void set_stream_memory_budget(size_t bytes) {
+    memory_budget = bytes;
+}
+
+void set_stream_radius(float radius) {
+    stream_radius = radius;
+}
+
+size_t get_stream_resident_bytes(void) {
+    return resident_bytes;
+}
+
+int get_stream_cell_count(void) {
+    return cell_count;
+}
+
+int get_resident_stream_cell_count(void) {
+    return array_length(resident_cells);
+}
+
+stream_cell_t* get_resident_stream_cell(int idx) {
+    return resident_cells[idx];
+}
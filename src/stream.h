@@ -0,0 +1,93 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <SDL2/SDL_atomic.h>
+#include "vector.h"
+#include "asset.h"
+#include "mesh.h"
+
+// out of core scenes: the scene is cut into spatial cells, stored in one paged file (see tools/pack_cells.c).
+// cells near the camera are memory mapped on the job system and used in place, far ones are unmapped again,
+// so only the neighbourhood of the camera has to fit in memory.
+
+#define STREAM_FILE_MAGIC "SJMCELLS"
+#define STREAM_FILE_VERSION 1
+// cell data starts on a page boundary, so mapping a cell never pulls in a page of its neighbour.
+#define STREAM_PAGE_SIZE 4096
+
+#define DEFAULT_STREAM_MEMORY_BUDGET (256 * 1024 * 1024)
+// cells whose bounding sphere comes closer to the camera than this are loaded.
+#define DEFAULT_STREAM_RADIUS 60.0f
+// loaded cells are only dropped once they are this much further out, so a camera on the edge does not thrash.
+#define STREAM_RADIUS_HYSTERESIS 0.25f
+// at most this many cells are being mapped at once, nearest first.
+#define MAX_PENDING_STREAM_LOADS 4
+
+// the file starts with this header, followed by cell_count records. the file is written and read by the same build,
+// the struct sizes in the header catch a mismatch.
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t page_size;
+    uint32_t cell_count;
+    uint32_t vertex_size; // sizeof(vec3_t)
+    uint32_t face_size; // sizeof(face_t)
+    uint32_t reserved;
+} stream_file_header_t;
+
+// a cell's data is three arrays (see ARRAY_HEADER_SIZE in array.h) at the given offsets from the start of the cell:
+// vertices, faces and object space face normals, ready to be used as a geometry level as they are.
+typedef struct {
+    vec3_t bounds_center;
+    float bounds_radius;
+    uint64_t offset; // page aligned
+    uint64_t size;
+    uint32_t vertex_count;
+    uint32_t face_count;
+    uint32_t vertices_offset;
+    uint32_t faces_offset;
+    uint32_t face_normals_offset;
+    uint32_t reserved;
+    char texture_filename[MAX_ASSET_FILENAME_LENGTH];
+} stream_cell_record_t;
+
+enum STREAM_CELL_STATE {
+    STREAM_CELL_STATE_UNLOADED,
+    STREAM_CELL_STATE_LOADING, // owned by a job
+    STREAM_CELL_STATE_RESIDENT,
+    STREAM_CELL_STATE_FAILED,
+};
+
+typedef struct {
+    stream_cell_record_t record;
+    SDL_atomic_t state;
+    void* mapping; // start of the mapped view, which can begin before the cell.
+    size_t mapping_size;
+    geometry_t geometry; // a single level, pointing into the mapping.
+    mesh_instance_t instance; // cells are stored in world space, so this is the identity.
+    texture_t* texture; // handle from the asset manager while resident.
+    float camera_distance; // to the bounding sphere, from the last update.
+} stream_cell_t;
+
+// returns false if the file can not be opened or is not a cell file of this build.
+bool open_scene_stream(const char* filename);
+void close_scene_stream(void);
+bool is_scene_stream_open(void);
+
+// once per frame on the main thread: unmaps cells that are far away or over budget, and queues the nearest missing ones.
+void update_scene_stream(vec3_t camera_position);
+
+void set_stream_memory_budget(size_t bytes);
+void set_stream_radius(float radius);
+// bytes mapped by resident and loading cells.
+size_t get_stream_resident_bytes(void);
+
+int get_stream_cell_count(void);
+// resident cells are safe to draw until the next update_scene_stream().
+int get_resident_stream_cell_count(void);
+stream_cell_t* get_resident_stream_cell(int idx);
+
+#endif
@@ -0,0 +1,94 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "mesh.h"
+#include "stress_scene.h"
+#include "procedural.h"
+
+// the center of the orbit benchmark.c flies by default, 7 units from the camera.
+#define SCENE_CENTER_X 0.0
+#define SCENE_CENTER_Y -1.0
+#define SCENE_CENTER_Z 7.0
+#define GRID_SPACING 4.0
+#define PLANE_SIZE 200.0
+#define OVERDRAW_STACK_SIZE 4.0
+#define MICRO_GRID_SIZE 2.0
+
+// textured modes need a texture, any will do.
+static char* texture_filename = "./assets/f22.png";
+
+bool parse_stress_scene(const char* spec, stress_scene_t* scene) {
+    memset(scene, 0, sizeof(stress_scene_t));
+    const char* knob = spec;
+    while (*knob != '\0') {
+        char name[16] = { 0 };
+        int value = 0;
+        int length = 0;
+        if (sscanf(knob, "%15[a-z]=%d%n", name, &value, &length) != 2 || value < 0) {
+            printf("Unable to read the scene %s at \"%s\": expected knob=count[,knob=count...].\n", spec, knob);
+            return false;
+        }
+        if (strcmp(name, "grid") == 0) {
+            scene->grid_instance_count = value;
+        } else if (strcmp(name, "sphere") == 0) {
+            scene->sphere_triangle_count = value;
+        } else if (strcmp(name, "planes") == 0) {
+            scene->plane_count = value;
+        } else if (strcmp(name, "overdraw") == 0) {
+            scene->overdraw_layer_count = value;
+        } else if (strcmp(name, "micro") == 0) {
+            scene->micro_triangle_count = value;
+        } else {
+            printf("Unable to read the scene %s: no knob %s, expected grid, sphere, planes, overdraw or micro.\n", spec, name);
+            return false;
+        }
+        knob += length;
+        knob += *knob == ',' ? 1 : 0;
+    }
+    return true;
+}
+
+void load_stress_scene(const stress_scene_t* scene) {
+    vec3_t center = vec3_new(SCENE_CENTER_X, SCENE_CENTER_Y, SCENE_CENTER_Z);
+    char filename[64];
+
+    if (scene->grid_instance_count > 0) {
+        int side = (int)ceil(sqrt((double)scene->grid_instance_count));
+        mesh_instance_t* instances = (mesh_instance_t*)malloc(sizeof(mesh_instance_t) * scene->grid_instance_count);
+        for (int instance_idx = 0; instance_idx < scene->grid_instance_count; ++instance_idx) {
+            float x = ((instance_idx % side) - (side - 1) / 2.0f) * GRID_SPACING;
+            float z = ((instance_idx / side) - (side - 1) / 2.0f) * GRID_SPACING;
+            instances[instance_idx] = make_mesh_instance(vec3_new(1, 1, 1), vec3_new(center.x + x, center.y, center.z + z),
+                vec3_new(0, -M_PI / 2, 0), 0xFFFFFFFF);
+        }
+        load_mesh_instanced("./assets/f22.obj", texture_filename, instances, scene->grid_instance_count);
+        free(instances);
+    }
+
+    if (scene->sphere_triangle_count > 0) {
+        snprintf(filename, sizeof(filename), "procedural:sphere:%d", scene->sphere_triangle_count);
+        load_mesh(filename, texture_filename, vec3_new(2, 2, 2), center, vec3_new(0, 0, 0));
+    }
+
+    // vertical planes through the center at even angles: the orbit passes through every one of them.
+    if (scene->plane_count > 0) {
+        mesh_instance_t* instances = (mesh_instance_t*)malloc(sizeof(mesh_instance_t) * scene->plane_count);
+        for (int plane_idx = 0; plane_idx < scene->plane_count; ++plane_idx) {
+            instances[plane_idx] = make_mesh_instance(vec3_new(PLANE_SIZE, PLANE_SIZE, 1), center,
+                vec3_new(0, M_PI * plane_idx / scene->plane_count, 0), get_procedural_color(plane_idx));
+        }
+        load_mesh_instanced("procedural:quad:1", texture_filename, instances, scene->plane_count);
+        free(instances);
+    }
+
+    if (scene->overdraw_layer_count > 0) {
+        snprintf(filename, sizeof(filename), "procedural:stack:%d", scene->overdraw_layer_count);
+        load_mesh(filename, texture_filename, vec3_new(OVERDRAW_STACK_SIZE, OVERDRAW_STACK_SIZE, OVERDRAW_STACK_SIZE), center, vec3_new(0, 0, 0));
+    }
+
+    if (scene->micro_triangle_count > 0) {
+        snprintf(filename, sizeof(filename), "procedural:grid:%d", scene->micro_triangle_count);
+        load_mesh(filename, texture_filename, vec3_new(MICRO_GRID_SIZE, MICRO_GRID_SIZE, 1), center, vec3_new(0, 0, 0));
+    }
+}
@@ -0,0 +1,24 @@
+#ifndef STRESS_SCENE_H
+#define STRESS_SCENE_H
+
+#include <stdbool.h>
+
+// synthetic scenes for the benchmark, to see how frame time scales with triangle count, pixel coverage and depth
+// complexity. the meshes are generated, see procedural.h.
+
+// what a scene spec asks for, 0 leaves a part out.
+typedef struct {
+    int grid_instance_count; // instances of the f22 on a square grid.
+    int sphere_triangle_count; // one tessellated sphere.
+    int plane_count; // huge vertical planes through the orbit of the camera, they cross its near plane.
+    int overdraw_layer_count; // quads stacked back to front as seen from the start of the camera path, see procedural.h.
+    int micro_triangle_count; // a small grid cut into triangles far below a pixel.
+} stress_scene_t;
+
+// a spec is a comma separated list of knobs, e.g. "grid=400,sphere=20000,planes=4,overdraw=16,micro=200000".
+// returns false, and says why, for anything else.
+bool parse_stress_scene(const char* spec, stress_scene_t* scene);
+// everything is centered on the default camera path (see benchmark.h), the knobs are meant to be swept one at a time.
+void load_stress_scene(const stress_scene_t* scene);
+
+#endif
@@ -1,8 +1,21 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
 #include "texture.h"
 #include "upng.h"
+#include "array.h"
+#include "job.h"
 int texture_width = 64;
 int texture_height = 64;
 
+// every texture ever created, so residency can be swept once per frame. only touched by the main thread.
+static texture_t** textures = NULL;
+static int texture_frame = 0;
+static size_t texture_memory_budget = DEFAULT_TEXTURE_MEMORY_BUDGET;
+static int texture_eviction_frames = DEFAULT_TEXTURE_EVICTION_FRAMES;
+static int texture_block_format = BLOCK_FORMAT_NONE;
+
 tex2_t tex2_clone(tex2_t* t) {
     tex2_t result = {
         t->u,
@@ -11,3 +24,230 @@ tex2_t tex2_clone(tex2_t* t) {
 
     return result;
 }
+
+texture_t* create_texture(const char* filename) {
+    texture_t* texture = (texture_t*)calloc(1, sizeof(texture_t));
+    if (texture == NULL) {
+        return NULL;
+    }
+    snprintf(texture->filename, sizeof(texture->filename), "%s", filename);
+    SDL_AtomicSet(&texture->state, TEXTURE_STATE_UNLOADED);
+    array_push(textures, texture);
+    return texture;
+}
+
+texture_t* find_texture(const char* filename) {
+    for (int texture_idx = 0; texture_idx < array_length(textures); ++texture_idx) {
+        if (strcmp(textures[texture_idx]->filename, filename) == 0) {
+            return textures[texture_idx];
+        }
+    }
+    return NULL;
+}
+
+void load_texture_file(texture_t* texture) {
+    FILE* file = fopen(texture->filename, "rb");
+    if (file == NULL) {
+        printf("Unable to load the texture %s. \n", texture->filename);
+        SDL_AtomicSet(&texture->state, TEXTURE_STATE_FAILED);
+        return;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    rewind(file);
+
+    unsigned char* png_data = size > 0 ? (unsigned char*)malloc((size_t)size) : NULL;
+    if (png_data == NULL || fread(png_data, 1, (size_t)size, file) != (size_t)size) {
+        printf("Unable to load the texture %s. \n", texture->filename);
+        free(png_data);
+        fclose(file);
+        SDL_AtomicSet(&texture->state, TEXTURE_STATE_FAILED);
+        return;
+    }
+    fclose(file);
+
+    texture->png_data = png_data;
+    texture->png_size = (unsigned long)size;
+    SDL_AtomicSet(&texture->state, TEXTURE_STATE_COMPRESSED);
+}
+
+typedef struct {
+    texture_t* texture;
+    int block_format;
+} decode_texture_job_t;
+
+// the upng image borrows png_data, so evicting it later leaves the compressed bytes in place for the next decode.
+// block compression happens here too, the 32 bit texels are dropped as soon as the blocks are written.
+static void decode_texture_job(void* data) {
+    decode_texture_job_t job = *(decode_texture_job_t*)data;
+    free(data);
+    texture_t* texture = job.texture;
+    upng_t* png_image = upng_new_from_bytes(texture->png_data, texture->png_size);
+    if (png_image != NULL) {
+        upng_decode(png_image);
+        if (upng_get_error(png_image) == UPNG_EOK && job.block_format != BLOCK_FORMAT_NONE) {
+            if (upng_get_format(png_image) == UPNG_RGBA8) {
+                texture->compressed = compress_texture((const uint32_t*)upng_get_buffer(png_image),
+                    upng_get_width(png_image), upng_get_height(png_image), job.block_format);
+                upng_free(png_image);
+                SDL_AtomicSet(&texture->state, TEXTURE_STATE_RESIDENT);
+                return;
+            }
+            printf("Unable to block compress the texture %s, it is not RGBA. \n", texture->filename);
+        } else if (upng_get_error(png_image) == UPNG_EOK) {
+            SDL_AtomicSetPtr((void**)&texture->decoded, png_image);
+            SDL_AtomicSet(&texture->state, TEXTURE_STATE_RESIDENT);
+            return;
+        }
+        upng_free(png_image);
+    }
+    printf("Unable to load the texture %s. \n", texture->filename);
+    SDL_AtomicSet(&texture->state, TEXTURE_STATE_FAILED);
+}
+
+// drop the decoded pixels, the compressed bytes stay so the texture can be decoded again on demand.
+static void evict_texture(texture_t* texture) {
+    upng_t* decoded = (upng_t*)SDL_AtomicGetPtr((void**)&texture->decoded);
+    SDL_AtomicSetPtr((void**)&texture->decoded, NULL);
+    free_compressed_texture(texture->compressed);
+    texture->compressed = NULL;
+    SDL_AtomicSet(&texture->state, TEXTURE_STATE_COMPRESSED);
+    if (decoded != NULL) {
+        upng_free(decoded);
+    }
+}
+
+// marks the texture used and returns whether it is resident in the requested form, queueing the decode if not.
+static bool request_texture(texture_t* texture, int block_format) {
+    texture->last_used_frame = texture_frame;
+
+    int state = SDL_AtomicGet(&texture->state);
+    if (state == TEXTURE_STATE_RESIDENT) {
+        bool is_compressed = texture->compressed != NULL;
+        if (is_compressed == (block_format != BLOCK_FORMAT_NONE) &&
+            (!is_compressed || texture->compressed->format == block_format)) {
+            return true;
+        }
+        evict_texture(texture);
+        state = TEXTURE_STATE_COMPRESSED;
+    }
+    if (state == TEXTURE_STATE_COMPRESSED) {
+        decode_texture_job_t* job = (decode_texture_job_t*)malloc(sizeof(decode_texture_job_t));
+        job->texture = texture;
+        job->block_format = block_format;
+        SDL_AtomicSet(&texture->state, TEXTURE_STATE_DECODING);
+        submit_job(decode_texture_job, job);
+    }
+    return false;
+}
+
+upng_t* acquire_texture(texture_t* texture) {
+    if (texture == NULL || !request_texture(texture, BLOCK_FORMAT_NONE)) {
+        return NULL;
+    }
+    return (upng_t*)SDL_AtomicGetPtr((void**)&texture->decoded);
+}
+
+compressed_texture_t* acquire_compressed_texture(texture_t* texture) {
+    if (texture == NULL || !request_texture(texture, texture_block_format)) {
+        return NULL;
+    }
+    return texture->compressed;
+}
+
+void set_texture_block_format(int format) {
+    texture_block_format = format;
+}
+
+int get_texture_block_format(void) {
+    return texture_block_format;
+}
+
+size_t get_texture_resident_bytes(void) {
+    size_t resident_bytes = 0;
+    for (int texture_idx = 0; texture_idx < array_length(textures); ++texture_idx) {
+        texture_t* texture = textures[texture_idx];
+        if (SDL_AtomicGet(&texture->state) != TEXTURE_STATE_RESIDENT) {
+            continue;
+        }
+        resident_bytes += texture->compressed != NULL ? get_compressed_texture_size(texture->compressed) : upng_get_size(texture->decoded);
+    }
+    return resident_bytes;
+}
+
+//@NOTE(SJM): this runs between frames, so no triangle of the previous frame still points at an evicted texture.
+void update_texture_residency(void) {
+    texture_frame += 1;
+
+    // stale textures go first.
+    for (int texture_idx = 0; texture_idx < array_length(textures); ++texture_idx) {
+        texture_t* texture = textures[texture_idx];
+        if (SDL_AtomicGet(&texture->state) == TEXTURE_STATE_RESIDENT &&
+            texture_frame - texture->last_used_frame > texture_eviction_frames) {
+            evict_texture(texture);
+        }
+    }
+
+    // then the least recently used ones while over budget, but never one that was sampled last frame.
+    size_t resident_bytes = get_texture_resident_bytes();
+    while (resident_bytes > texture_memory_budget) {
+        texture_t* least_recently_used = NULL;
+        for (int texture_idx = 0; texture_idx < array_length(textures); ++texture_idx) {
+            texture_t* texture = textures[texture_idx];
+            if (SDL_AtomicGet(&texture->state) != TEXTURE_STATE_RESIDENT || texture->last_used_frame >= texture_frame - 1) {
+                continue;
+            }
+            if (least_recently_used == NULL || texture->last_used_frame < least_recently_used->last_used_frame) {
+                least_recently_used = texture;
+            }
+        }
+        if (least_recently_used == NULL) {
+            break;
+        }
+        resident_bytes -= least_recently_used->compressed != NULL ?
+            get_compressed_texture_size(least_recently_used->compressed) : upng_get_size(least_recently_used->decoded);
+        evict_texture(least_recently_used);
+    }
+}
+
+void set_texture_memory_budget(size_t budget_bytes) {
+    texture_memory_budget = budget_bytes;
+}
+
+void set_texture_eviction_frames(int frame_count) {
+    texture_eviction_frames = frame_count;
+}
+
+static void free_texture_data(texture_t* texture) {
+    if (texture->decoded != NULL) {
+        upng_free(texture->decoded);
+    }
+    free_compressed_texture(texture->compressed);
+    if (!texture->is_png_data_mapped) {
+        free(texture->png_data);
+    }
+    free(texture);
+}
+
+void destroy_texture(texture_t* texture) {
+    int texture_count = array_length(textures);
+    for (int texture_idx = 0; texture_idx < texture_count; ++texture_idx) {
+        if (textures[texture_idx] == texture) {
+            // order does not matter, move the last texture into the hole.
+            textures[texture_idx] = textures[texture_count - 1];
+            array_truncate(textures, texture_count - 1);
+            break;
+        }
+    }
+    free_texture_data(texture);
+}
+
+// callers must make sure no decode job is still running, see wait_for_jobs().
+void free_textures(void) {
+    for (int texture_idx = 0; texture_idx < array_length(textures); ++texture_idx) {
+        free_texture_data(textures[texture_idx]);
+    }
+    array_free(textures);
+    textures = NULL;
+}
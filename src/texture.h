@@ -1,6 +1,11 @@
 #ifndef TEXTURE_H
 #define TEXTURE_H
 #include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <SDL2/SDL_atomic.h>
+#include "upng.h"
+#include "bcn.h"
 
 typedef struct {
     float u;
@@ -9,4 +14,56 @@ typedef struct {
 
 tex2_t tex2_clone(tex2_t* t);
 
+// textures are kept as compressed PNG bytes until a frame actually samples them.
+// the decode then runs on the job system, and decoded textures that go unused are evicted again.
+enum TEXTURE_STATE {
+    TEXTURE_STATE_UNLOADED = 0, // the file has not been read yet.
+    TEXTURE_STATE_COMPRESSED, // only the PNG bytes are in memory.
+    TEXTURE_STATE_DECODING, // a decode job is in flight.
+    TEXTURE_STATE_RESIDENT, // decoded and ready to sample.
+    TEXTURE_STATE_FAILED // unreadable or undecodable, never retried.
+};
+
+#define MAX_TEXTURE_FILENAME_LENGTH 256
+#define DEFAULT_TEXTURE_MEMORY_BUDGET (64 * 1024 * 1024)
+#define DEFAULT_TEXTURE_EVICTION_FRAMES 120
+
+typedef struct {
+    char filename[MAX_TEXTURE_FILENAME_LENGTH];
+    unsigned char* png_data; // compressed file contents, owned by the texture unless it is mapped.
+    bool is_png_data_mapped; // png_data points into the asset bundle, see bundle.h.
+    unsigned long png_size;
+    upng_t* decoded; // only valid in TEXTURE_STATE_RESIDENT, when it was decoded without block compression.
+    compressed_texture_t* compressed; // instead of decoded, when it was decoded with block compression.
+    SDL_atomic_t state; // one of TEXTURE_STATE.
+    int last_used_frame;
+    int reference_count; // handles held through the asset manager, see asset.h.
+} texture_t;
+
+// create_texture() only registers the texture, load_texture_file() reads its bytes and is safe to run on a job.
+texture_t* create_texture(const char* filename);
+texture_t* find_texture(const char* filename);
+void load_texture_file(texture_t* texture);
+// unregisters and frees a texture. callers must make sure no job still uses it.
+void destroy_texture(texture_t* texture);
+
+// returns the decoded texture, or NULL while it is not resident yet. a miss queues the decode.
+upng_t* acquire_texture(texture_t* texture);
+// the same for block compressed textures. a texture resident in the other form is evicted and decoded again.
+compressed_texture_t* acquire_compressed_texture(texture_t* texture);
+
+// the form decodes from now on produce, one of BLOCK_FORMAT. the decoded block cache lives in bcn.c.
+void set_texture_block_format(int format);
+int get_texture_block_format(void);
+
+// call once per frame, before any acquire_texture() of that frame: evicts textures that were
+// not sampled for the eviction frame count, and least recently used ones while over the memory budget.
+void update_texture_residency(void);
+
+void set_texture_memory_budget(size_t budget_bytes);
+void set_texture_eviction_frames(int frame_count);
+size_t get_texture_resident_bytes(void);
+
+void free_textures(void);
+
 #endif
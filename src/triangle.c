@@ -1,7 +1,10 @@
 #include "triangle.h"
 #include "display.h"
+#include "profile.h"
+#include "stats.h"
 #include "vector.h"
 #include <assert.h>
+#include <math.h>
 
 void int_swap(int*a ,int* b){
     int tmp = *a;
@@ -15,7 +18,7 @@ void float_swap(float*a, float* b) {
     *b = tmp;
 }
 
-void draw_triangle_pixel(
+bool draw_triangle_pixel(
     int x,
     int y,
     uint32_t color,
@@ -50,7 +53,7 @@ void draw_triangle_pixel(
 
     if (x >= get_window_width() || x < 0 || y >= get_window_height() || y < 0) {
         printf("wanted to draw out of bounds, forcing early return.\n");
-        return;
+        return false;
     }
 
     // only the pixel if the depth value is less than the one previously stored in z-buffer. (less meaning closer to the camera,.
@@ -58,8 +61,9 @@ void draw_triangle_pixel(
     if (interpolated_reciprocal_w < get_zbuffer_at(x,y)) {
         draw_pixel(x,y, color);
         update_zbuffer_at(x,y, interpolated_reciprocal_w);
+        return true;
     }
-    
+    return false;
 }
 
 
@@ -72,6 +76,7 @@ void draw_filled_triangle(
      int x1, int y1, float z1, float w1,
       int x2, int y2,float z2, float w2,
        uint32_t color) {
+    PROFILE_SCOPE("draw_filled_triangle");
                            
     // TODO: loop over all the pixels of the triangle to render them based on  the color
     // that is sampled from the texture.
@@ -104,6 +109,9 @@ void draw_filled_triangle(
     vec4_t point_a = {x0, y0, z0, w0};
     vec4_t point_b = {x1, y1, z1, w1};
     vec4_t point_c = {x2, y2, z2, w2};
+    // counted here and added to the frame once per triangle.
+    int fragments_tested = 0;
+    int fragments_written = 0;
 
     //////////////////////////////////////////////////////
     // render the upper part of the triangle (flat bottom)
@@ -127,9 +135,10 @@ void draw_filled_triangle(
                     int_swap(&x_start, &x_end);
                 }
                 // pixel for pixel
+                fragments_tested += x_end - x_start;
                 for (int x = x_start; x < x_end; x++) {
                     // todo: draw our pixel with the color that comes from the texture.
-                    draw_triangle_pixel(x,y, color, point_a, point_b, point_c);
+                    fragments_written += draw_triangle_pixel(x,y, color, point_a, point_b, point_c);
                 }
             }
         }
@@ -155,27 +164,35 @@ void draw_filled_triangle(
                     int_swap(&x_start, &x_end);
                 }
                 // pixel for pixel
+                fragments_tested += x_end - x_start;
                 for (int x = x_start; x < x_end; x++) {
                     // todo: draw our pixel with the color that comes from the texture.
-                    draw_triangle_pixel(x,y, color, point_a, point_b, point_c);
+                    fragments_written += draw_triangle_pixel(x,y, color, point_a, point_b, point_c);
 
                 }
             }
         }
     }
+    pipeline_stats_t* stats = get_frame_pipeline_stats();
+    stats->fragments_tested += fragments_tested;
+    stats->fragments_written += fragments_written;
 }
 
 
-void draw_texel(
+// the perspective correct u and v of pixel (x, y), and its depth for the z-buffer. false if the pixel is off screen or
+// hidden, so the texture is only sampled for pixels that are drawn.
+static inline bool interpolate_visible_texel(
     int x,
     int y,
-    upng_t* texture,
     vec4_t point_a,
     vec4_t point_b,
     vec4_t point_c,
     tex2_t a_uv,
     tex2_t b_uv,
-    tex2_t c_uv) {        
+    tex2_t c_uv,
+    float* u,
+    float* v,
+    float* depth) {
     // we do not need z or w for barycentric weights.
     vec2_t a = vec2_from_vec4(point_a);
     vec2_t b = vec2_from_vec4(point_b);
@@ -187,56 +204,115 @@ void draw_texel(
     float beta =  weights.y;
     float gamma = weights.z;
 
-    // variables to store the interpolated values of U,v, and also 1/W (z before projection) for the current pixel.
-    float interpolated_u = 0;
-    float interpolated_v = 0;
-    float interpolated_reciprocal_w = 0;
-
     // perform interpolation of all U and V  values using barycentric weights.
-    interpolated_u = alpha * (a_uv.u / point_a.w) + beta * (b_uv.u / point_b.w) + gamma * (c_uv.u / point_c.w);
-    interpolated_v = alpha * (a_uv.v / point_a.w) + beta * (b_uv.v / point_b.w) + gamma * (c_uv.v / point_c.w);
+    float interpolated_u = alpha * (a_uv.u / point_a.w) + beta * (b_uv.u / point_b.w) + gamma * (c_uv.u / point_c.w);
+    float interpolated_v = alpha * (a_uv.v / point_a.w) + beta * (b_uv.v / point_b.w) + gamma * (c_uv.v / point_c.w);
 
     // also interpolate the value of 1/w for the current pixel.
-    interpolated_reciprocal_w = alpha * (1 / point_a.w) + beta * ( 1/ point_b.w) + gamma * (1 / point_c.w);
+    float interpolated_reciprocal_w = alpha * (1 / point_a.w) + beta * ( 1/ point_b.w) + gamma * (1 / point_c.w);
 
     // now we can divide back both interpolated values by 1/w .
-    interpolated_u /= interpolated_reciprocal_w;
-    interpolated_v /= interpolated_reciprocal_w;
+    *u = interpolated_u / interpolated_reciprocal_w;
+    *v = interpolated_v / interpolated_reciprocal_w;
 
-    int texture_width  = upng_get_width(texture);
-    int texture_height = upng_get_height(texture);
-
-    // modulo so we do not have invalid values (not really clamping, but rolling over.)
-    int tex_x = abs((int)(interpolated_u * texture_width)) % texture_width;
-    int tex_y = abs((int)(interpolated_v * texture_width)) % texture_height;
-    
     // adjust 1/w such that the pixels that are closer to the camera have smaller values.
-    interpolated_reciprocal_w = 1.0 - interpolated_reciprocal_w;
+    *depth = 1.0 - interpolated_reciprocal_w;
 
     if (x >= get_window_width() || x < 0 || y >= get_window_height() || y < 0) {
         printf("wanted to draw out of bounds, forcing early return.\n");
-        return;
+        return false;
     }
 
     // only the pixel if the depth value is less than the one previously stored in z-buffer. (less meaning closer to the camera,.
     // since z is into the screen.)
-    if (interpolated_reciprocal_w < get_zbuffer_at(x, y)) {
-        // get the buffer of colors from the t4exture.
-        uint32_t* texture_buffer = (uint32_t*)upng_get_buffer(texture);
-        draw_pixel(x,y, texture_buffer[(texture_width * tex_y) + tex_x]);
-        update_zbuffer_at(x,y, interpolated_reciprocal_w);
+    return *depth < get_zbuffer_at(x, y);
+}
+
+// modulo so we do not have invalid values (not really clamping, but rolling over.) every sampler wraps like this.
+static int wrap_texel_coordinate(float t, int size) {
+    return abs((int)(t * size)) % size;
+}
+
+bool draw_texel(
+    int x,
+    int y,
+    upng_t* texture,
+    vec4_t point_a,
+    vec4_t point_b,
+    vec4_t point_c,
+    tex2_t a_uv,
+    tex2_t b_uv,
+    tex2_t c_uv) {
+    float u, v, depth;
+    if (!interpolate_visible_texel(x, y, point_a, point_b, point_c, a_uv, b_uv, c_uv, &u, &v, &depth)) {
+        return false;
+    }
+
+    int texture_width  = upng_get_width(texture);
+    int texture_height = upng_get_height(texture);
+    int tex_x = wrap_texel_coordinate(u, texture_width);
+    int tex_y = wrap_texel_coordinate(v, texture_height);
+
+    // get the buffer of colors from the texture.
+    uint32_t* texture_buffer = (uint32_t*)upng_get_buffer(texture);
+    draw_pixel(x,y, texture_buffer[(texture_width * tex_y) + tex_x]);
+    update_zbuffer_at(x,y, depth);
+    return true;
+}
+
+// same as draw_texel, but the color comes through the page table of a virtual texture.
+// sampled only behind the depth test, so hidden texels do not request pages either.
+bool draw_virtual_texel(
+    int x,
+    int y,
+    virtual_texture_t* texture,
+    int mip,
+    vec4_t point_a,
+    vec4_t point_b,
+    vec4_t point_c,
+    tex2_t a_uv,
+    tex2_t b_uv,
+    tex2_t c_uv) {
+    float u, v, depth;
+    if (!interpolate_visible_texel(x, y, point_a, point_b, point_c, a_uv, b_uv, c_uv, &u, &v, &depth)) {
+        return false;
     }
 
+    draw_pixel(x,y, sample_virtual_texture(texture, u, v, mip));
+    update_zbuffer_at(x,y, depth);
+    return true;
 }
 
+// same as draw_texel, decoding the texel from its 4x4 block. see bcn.h.
+bool draw_compressed_texel(
+    int x,
+    int y,
+    compressed_texture_t* texture,
+    vec4_t point_a,
+    vec4_t point_b,
+    vec4_t point_c,
+    tex2_t a_uv,
+    tex2_t b_uv,
+    tex2_t c_uv) {
+    float u, v, depth;
+    if (!interpolate_visible_texel(x, y, point_a, point_b, point_c, a_uv, b_uv, c_uv, &u, &v, &depth)) {
+        return false;
+    }
 
+    int tex_x = wrap_texel_coordinate(u, texture->width);
+    int tex_y = wrap_texel_coordinate(v, texture->height);
+    draw_pixel(x,y, sample_compressed_texture(texture, tex_x, tex_y));
+    update_zbuffer_at(x,y, depth);
+    return true;
+}
 
 // draw a textured traignle with the flat-top / flat-bottom method.
 // we splti the orignal triangle in two, half flat bottom and half flat-top
-void draw_textured_triangle(int x0, int y0, float z0, float w0, float u0, float v0,
-                            int x1, int y1, float z1, float w1, float u1, float v1,
-                            int x2, int y2, float z2, float w2, float u2, float v2,
-                            upng_t* texture) {    
+// exactly one of texture, compressed_texture and virtual_texture is set.
+static void draw_sampled_triangle(int x0, int y0, float z0, float w0, float u0, float v0,
+                                  int x1, int y1, float z1, float w1, float u1, float v1,
+                                  int x2, int y2, float z2, float w2, float u2, float v2,
+                                  upng_t* texture, compressed_texture_t* compressed_texture, virtual_texture_t* virtual_texture) {    
                             
     // loop over all the pixels of the triangle to render them based on the color
     // that is sampled from the texture.
@@ -287,6 +363,16 @@ void draw_textured_triangle(int x0, int y0, float z0, float w0, float u0, float
     tex2_t b_uv = {u1, v1};
     tex2_t c_uv = {u2, v2};
 
+    // one mip for the whole triangle, from the texels it covers against the pixels it covers.
+    int mip = 0;
+    if (virtual_texture != NULL) {
+        float texel_area = fabsf((u1 - u0) * (v2 - v0) - (u2 - u0) * (v1 - v0)) * 0.5f * virtual_texture->width * virtual_texture->height;
+        float pixel_area = fabsf((float)(x1 - x0) * (y2 - y0) - (float)(x2 - x0) * (y1 - y0)) * 0.5f;
+        mip = get_virtual_texture_mip(virtual_texture, texel_area, pixel_area);
+    }
+    int fragments_tested = 0;
+    int fragments_written = 0;
+
     //////////////////////////////////////////////////////
     // render the upper part of the triangle (flat bottom)
     //////////////////////////////////////////////////////
@@ -309,9 +395,18 @@ void draw_textured_triangle(int x0, int y0, float z0, float w0, float u0, float
                     int_swap(&x_start, &x_end);
                 }
                 // pixel for pixel
+                fragments_tested += x_end - x_start;
                 for (int x = x_start; x < x_end; x++) {
+                    if (virtual_texture != NULL) {
+                        fragments_written += draw_virtual_texel(x, y, virtual_texture, mip, point_a, point_b, point_c, a_uv, b_uv, c_uv);
+                        continue;
+                    }
+                    if (compressed_texture != NULL) {
+                        fragments_written += draw_compressed_texel(x, y, compressed_texture, point_a, point_b, point_c, a_uv, b_uv, c_uv);
+                        continue;
+                    }
                     // todo: draw our pixel with the color that comes from the texture.
-                    draw_texel(x, y, texture,
+                    fragments_written += draw_texel(x, y, texture,
                         point_a,
                         point_b,
                         point_c,
@@ -344,9 +439,18 @@ void draw_textured_triangle(int x0, int y0, float z0, float w0, float u0, float
                     int_swap(&x_start, &x_end);
                 }
                 // pixel for pixel
+                fragments_tested += x_end - x_start;
                 for (int x = x_start; x < x_end; x++) {
+                    if (virtual_texture != NULL) {
+                        fragments_written += draw_virtual_texel(x, y, virtual_texture, mip, point_a, point_b, point_c, a_uv, b_uv, c_uv);
+                        continue;
+                    }
+                    if (compressed_texture != NULL) {
+                        fragments_written += draw_compressed_texel(x, y, compressed_texture, point_a, point_b, point_c, a_uv, b_uv, c_uv);
+                        continue;
+                    }
                     // todo: draw our pixel with the color that comes from the texture.
-                    draw_texel(x, y, texture,
+                    fragments_written += draw_texel(x, y, texture,
                         point_a,
                         point_b,
                         point_c,
@@ -358,6 +462,33 @@ void draw_textured_triangle(int x0, int y0, float z0, float w0, float u0, float
             }
         }
     }
+    pipeline_stats_t* stats = get_frame_pipeline_stats();
+    stats->fragments_tested += fragments_tested;
+    stats->fragments_written += fragments_written;
+}
+
+void draw_textured_triangle(int x0, int y0, float z0, float w0, float u0, float v0,
+                            int x1, int y1, float z1, float w1, float u1, float v1,
+                            int x2, int y2, float z2, float w2, float u2, float v2,
+                            upng_t* texture) {
+    PROFILE_SCOPE("draw_textured_triangle");
+    draw_sampled_triangle(x0, y0, z0, w0, u0, v0, x1, y1, z1, w1, u1, v1, x2, y2, z2, w2, u2, v2, texture, NULL, NULL);
+}
+
+void draw_compressed_textured_triangle(int x0, int y0, float z0, float w0, float u0, float v0,
+                                       int x1, int y1, float z1, float w1, float u1, float v1,
+                                       int x2, int y2, float z2, float w2, float u2, float v2,
+                                       compressed_texture_t* texture) {
+    PROFILE_SCOPE("draw_compressed_textured_triangle");
+    draw_sampled_triangle(x0, y0, z0, w0, u0, v0, x1, y1, z1, w1, u1, v1, x2, y2, z2, w2, u2, v2, NULL, texture, NULL);
+}
+
+void draw_virtual_textured_triangle(int x0, int y0, float z0, float w0, float u0, float v0,
+                                    int x1, int y1, float z1, float w1, float u1, float v1,
+                                    int x2, int y2, float z2, float w2, float u2, float v2,
+                                    virtual_texture_t* texture) {
+    PROFILE_SCOPE("draw_virtual_textured_triangle");
+    draw_sampled_triangle(x0, y0, z0, w0, u0, v0, x1, y1, z1, w1, u1, v1, x2, y2, z2, w2, u2, v2, NULL, NULL, texture);
 }
 
 vec3_t get_triangle_normal(vec4_t vertices[3]) {
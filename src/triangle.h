@@ -1,9 +1,12 @@
 #ifndef TRIANGLE_H
 #define TRIANGLE_H
+#include <stdbool.h>
 #include <stdint.h>
 #include "vector.h"
 #include "texture.h"
 #include "upng.h"
+#include "vtexture.h"
+#include "bcn.h"
 
 typedef struct {
     int a;
@@ -20,6 +23,8 @@ typedef struct {
     tex2_t texcoords[3];
     uint32_t color;
     upng_t* texture; // YIKES, a pointer for EACH triangle? get me out.
+    compressed_texture_t* compressed_texture; // used instead of texture when set.
+    virtual_texture_t* virtual_texture; // used instead of texture when set.
 } triangle_t;
 
 void draw_filled_triangle(
@@ -33,8 +38,20 @@ void draw_textured_triangle(int x0, int y0, float z0, float w0, float u0, float
                             int x2, int y2, float z2, float w2, float u2, float v2,
                             upng_t* texture); 
 
+void draw_compressed_textured_triangle(int x0, int y0, float z0, float w0, float u0, float v0,
+                                       int x1, int y1, float z1, float w1, float u1, float v1,
+                                       int x2, int y2, float z2, float w2, float u2, float v2,
+                                       compressed_texture_t* texture);
 
-void draw_triangle_pixel(
+// the mip is picked per triangle, see get_virtual_texture_mip().
+void draw_virtual_textured_triangle(int x0, int y0, float z0, float w0, float u0, float v0,
+                                    int x1, int y1, float z1, float w1, float u1, float v1,
+                                    int x2, int y2, float z2, float w2, float u2, float v2,
+                                    virtual_texture_t* texture);
+
+
+// the pixel functions depth test one fragment and return true if it was written.
+bool draw_triangle_pixel(
     int x,
     int y,
     uint32_t color,
@@ -43,7 +60,7 @@ void draw_triangle_pixel(
     vec4_t point_c
 );
 
-void draw_texel(
+bool draw_texel(
     int x,
     int y,
     upng_t* texture,
@@ -54,6 +71,29 @@ void draw_texel(
     tex2_t b_uv,
     tex2_t c_uv);
 
+bool draw_compressed_texel(
+    int x,
+    int y,
+    compressed_texture_t* texture,
+    vec4_t point_a,
+    vec4_t point_b,
+    vec4_t point_c,
+    tex2_t a_uv,
+    tex2_t b_uv,
+    tex2_t c_uv);
+
+bool draw_virtual_texel(
+    int x,
+    int y,
+    virtual_texture_t* texture,
+    int mip,
+    vec4_t point_a,
+    vec4_t point_b,
+    vec4_t point_c,
+    tex2_t a_uv,
+    tex2_t b_uv,
+    tex2_t c_uv);
+
 vec3_t get_triangle_normal(vec4_t vertices[3]);
 
 #endif
\ No newline at end of file
@@ -31,6 +31,20 @@ freely, subject to the following restrictions:
 
 #include "upng.h"
 
+/* SIMD scanline unfiltering on x86; the instruction set is picked at runtime, so no compiler flags are needed */
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define UPNG_X86_SIMD
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define UPNG_TARGET(isa)
+#else
+#include <cpuid.h>
+#define UPNG_TARGET(isa) __attribute__((target(isa)))
+#endif
+#endif
+
 #define MAKE_BYTE(b) ((b) & 0xFF)
 #define MAKE_DWORD(a,b,c,d) ((MAKE_BYTE(a) << 24) | (MAKE_BYTE(b) << 16) | (MAKE_BYTE(c) << 8) | MAKE_BYTE(d))
 #define MAKE_DWORD_PTR(p) MAKE_DWORD((p)[0], (p)[1], (p)[2], (p)[3])
@@ -52,9 +66,19 @@ freely, subject to the following restrictions:
 #define CODE_LENGTH_BITLEN 7
 #define MAX_BIT_LENGTH 15 /* largest bitlen used by any tree type */
 
-#define DEFLATE_CODE_BUFFER_SIZE (NUM_DEFLATE_CODE_SYMBOLS * 2)
-#define DISTANCE_BUFFER_SIZE (NUM_DISTANCE_SYMBOLS * 2)
-#define CODE_LENGTH_BUFFER_SIZE (NUM_DISTANCE_SYMBOLS * 2)
+#define HUFFMAN_PRIMARY_BITS 9 /* codes up to this length decode with a single table lookup */
+#define CODE_LENGTH_PRIMARY_BITS CODE_LENGTH_BITLEN /* code length codes always fit the primary table */
+
+/* primary table plus room for the secondary tables; a complete code never needs more than this (see zlib's enough.c) */
+#define DEFLATE_CODE_TABLE_SIZE 1024
+#define DISTANCE_TABLE_SIZE 1024
+#define CODE_LENGTH_TABLE_SIZE (1 << CODE_LENGTH_PRIMARY_BITS)
+
+/* a table entry holds a symbol and its code length, or the offset and index width of a secondary table */
+#define HUFFMAN_ENTRY(value,length) ((value) | ((length) << 16))
+#define HUFFMAN_ENTRY_VALUE(entry) ((entry) & 0xFFFF)
+#define HUFFMAN_ENTRY_LENGTH(entry) (((entry) >> 16) & 0xF)
+#define HUFFMAN_SUBTABLE_FLAG 0x80000000u
 
 #define SET_ERROR(upng,code) do { (upng)->error = (code); (upng)->error_line = __LINE__; } while (0)
 
@@ -76,6 +100,12 @@ typedef enum upng_color {
 	UPNG_RGBA		= 6
 } upng_color;
 
+typedef enum upng_simd {
+	UPNG_SIMD_NONE	= 0,
+	UPNG_SIMD_SSE2	= 1,
+	UPNG_SIMD_SSSE3	= 2
+} upng_simd;
+
 typedef struct upng_source {
 	const unsigned char*	buffer;
 	unsigned long			size;
@@ -98,13 +128,24 @@ struct upng_t {
 
 	upng_state		state;
 	upng_source		source;
+
+	upng_simd		simd;	/*best instruction set for unfiltering, detected on creation */
 };
 
-typedef struct huffman_tree {
-	unsigned* tree2d;
-	unsigned maxbitlen;	/*maximum number of bits a single code can get */
-	unsigned numcodes;	/*number of symbols in the alphabet = number of codes */
-} huffman_tree;
+typedef struct huffman_table {
+	unsigned* entries;	/*primary entries first, followed by the secondary tables of codes longer than primarybits */
+	unsigned capacity;	/*number of entries available in the buffer */
+	unsigned primarybits;	/*number of bits used to index the primary table */
+} huffman_table;
+
+/*the deflate stream is consumed from a 64-bit bit buffer that is refilled a word at a time */
+typedef struct bit_reader {
+	const unsigned char* in;
+	unsigned long inlength;	/*length of the input in bytes */
+	unsigned long pos;	/*next byte to be shifted into the bit buffer, may run past inlength (zeros are shifted in) */
+	unsigned long long bitbuf;
+	unsigned bitcount;	/*number of valid bits in bitbuf */
+} bit_reader;
 
 static const unsigned LENGTH_BASE[29] = {	/*the base lengths represented by codes 257-285 */
 	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59,
@@ -129,173 +170,212 @@ static const unsigned DISTANCE_EXTRA[30] = {	/*the extra bits of backwards dista
 static const unsigned CLCL[NUM_CODE_LENGTH_CODES]	/*the order in which "code length alphabet code lengths" are stored, out of this the huffman tree of the dynamic huffman tree lengths is generated */
 = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
 
-static const unsigned FIXED_DEFLATE_CODE_TREE[NUM_DEFLATE_CODE_SYMBOLS * 2] = {
-	289, 370, 290, 307, 546, 291, 561, 292, 293, 300, 294, 297, 295, 296, 0, 1,
-	2, 3, 298, 299, 4, 5, 6, 7, 301, 304, 302, 303, 8, 9, 10, 11, 305, 306, 12,
-	13, 14, 15, 308, 339, 309, 324, 310, 317, 311, 314, 312, 313, 16, 17, 18,
-	19, 315, 316, 20, 21, 22, 23, 318, 321, 319, 320, 24, 25, 26, 27, 322, 323,
-	28, 29, 30, 31, 325, 332, 326, 329, 327, 328, 32, 33, 34, 35, 330, 331, 36,
-	37, 38, 39, 333, 336, 334, 335, 40, 41, 42, 43, 337, 338, 44, 45, 46, 47,
-	340, 355, 341, 348, 342, 345, 343, 344, 48, 49, 50, 51, 346, 347, 52, 53,
-	54, 55, 349, 352, 350, 351, 56, 57, 58, 59, 353, 354, 60, 61, 62, 63, 356,
-	363, 357, 360, 358, 359, 64, 65, 66, 67, 361, 362, 68, 69, 70, 71, 364,
-	367, 365, 366, 72, 73, 74, 75, 368, 369, 76, 77, 78, 79, 371, 434, 372,
-	403, 373, 388, 374, 381, 375, 378, 376, 377, 80, 81, 82, 83, 379, 380, 84,
-	85, 86, 87, 382, 385, 383, 384, 88, 89, 90, 91, 386, 387, 92, 93, 94, 95,
-	389, 396, 390, 393, 391, 392, 96, 97, 98, 99, 394, 395, 100, 101, 102, 103,
-	397, 400, 398, 399, 104, 105, 106, 107, 401, 402, 108, 109, 110, 111, 404,
-	419, 405, 412, 406, 409, 407, 408, 112, 113, 114, 115, 410, 411, 116, 117,
-	118, 119, 413, 416, 414, 415, 120, 121, 122, 123, 417, 418, 124, 125, 126,
-	127, 420, 427, 421, 424, 422, 423, 128, 129, 130, 131, 425, 426, 132, 133,
-	134, 135, 428, 431, 429, 430, 136, 137, 138, 139, 432, 433, 140, 141, 142,
-	143, 435, 483, 436, 452, 568, 437, 438, 445, 439, 442, 440, 441, 144, 145,
-	146, 147, 443, 444, 148, 149, 150, 151, 446, 449, 447, 448, 152, 153, 154,
-	155, 450, 451, 156, 157, 158, 159, 453, 468, 454, 461, 455, 458, 456, 457,
-	160, 161, 162, 163, 459, 460, 164, 165, 166, 167, 462, 465, 463, 464, 168,
-	169, 170, 171, 466, 467, 172, 173, 174, 175, 469, 476, 470, 473, 471, 472,
-	176, 177, 178, 179, 474, 475, 180, 181, 182, 183, 477, 480, 478, 479, 184,
-	185, 186, 187, 481, 482, 188, 189, 190, 191, 484, 515, 485, 500, 486, 493,
-	487, 490, 488, 489, 192, 193, 194, 195, 491, 492, 196, 197, 198, 199, 494,
-	497, 495, 496, 200, 201, 202, 203, 498, 499, 204, 205, 206, 207, 501, 508,
-	502, 505, 503, 504, 208, 209, 210, 211, 506, 507, 212, 213, 214, 215, 509,
-	512, 510, 511, 216, 217, 218, 219, 513, 514, 220, 221, 222, 223, 516, 531,
-	517, 524, 518, 521, 519, 520, 224, 225, 226, 227, 522, 523, 228, 229, 230,
-	231, 525, 528, 526, 527, 232, 233, 234, 235, 529, 530, 236, 237, 238, 239,
-	532, 539, 533, 536, 534, 535, 240, 241, 242, 243, 537, 538, 244, 245, 246,
-	247, 540, 543, 541, 542, 248, 249, 250, 251, 544, 545, 252, 253, 254, 255,
-	547, 554, 548, 551, 549, 550, 256, 257, 258, 259, 552, 553, 260, 261, 262,
-	263, 555, 558, 556, 557, 264, 265, 266, 267, 559, 560, 268, 269, 270, 271,
-	562, 565, 563, 564, 272, 273, 274, 275, 566, 567, 276, 277, 278, 279, 569,
-	572, 570, 571, 280, 281, 282, 283, 573, 574, 284, 285, 286, 287, 0, 0
-};
+static void bit_reader_init(bit_reader* br, const unsigned char* in, unsigned long inlength, unsigned long pos)
+{
+	br->in = in;
+	br->inlength = inlength;
+	br->pos = pos;
+	br->bitbuf = 0;
+	br->bitcount = 0;
+}
 
-static const unsigned FIXED_DISTANCE_TREE[NUM_DISTANCE_SYMBOLS * 2] = {
-	33, 48, 34, 41, 35, 38, 36, 37, 0, 1, 2, 3, 39, 40, 4, 5, 6, 7, 42, 45, 43,
-	44, 8, 9, 10, 11, 46, 47, 12, 13, 14, 15, 49, 56, 50, 53, 51, 52, 16, 17,
-	18, 19, 54, 55, 20, 21, 22, 23, 57, 60, 58, 59, 24, 25, 26, 27, 61, 62, 28,
-	29, 30, 31, 0, 0
-};
+/*top up the bit buffer to at least 56 bits, so a whole length/distance pair can be decoded without refilling again */
+static void bit_reader_refill(bit_reader* br)
+{
+	if (br->bitcount > 56) {
+		return;
+	}
+
+	if (br->pos + 8 <= br->inlength) {
+		/*fast path: load a whole little endian word and keep as many bytes of it as fit */
+		const unsigned char* p = br->in + br->pos;
+		unsigned long long word = (unsigned long long)p[0] | ((unsigned long long)p[1] << 8) | ((unsigned long long)p[2] << 16) | ((unsigned long long)p[3] << 24)
+			| ((unsigned long long)p[4] << 32) | ((unsigned long long)p[5] << 40) | ((unsigned long long)p[6] << 48) | ((unsigned long long)p[7] << 56);
+		br->bitbuf |= word << br->bitcount;
+		br->pos += (63 - br->bitcount) >> 3;
+		br->bitcount |= 56;
+	} else {
+		/*near the end of the input, shift in byte per byte and pad with zeros; bit_reader_overrun() catches reads of the padding */
+		while (br->bitcount <= 56) {
+			unsigned long long byte = br->pos < br->inlength ? br->in[br->pos] : 0;
+			br->bitbuf |= byte << br->bitcount;
+			br->pos++;
+			br->bitcount += 8;
+		}
+	}
+}
+
+static void bit_reader_consume(bit_reader* br, unsigned nbits)
+{
+	br->bitbuf >>= nbits;
+	br->bitcount -= nbits;
+}
+
+/*number of bits consumed from the start of the input*/
+static unsigned long bit_reader_position(const bit_reader* br)
+{
+	return br->pos * 8 - br->bitcount;
+}
+
+/*true if more bits were consumed than the input holds */
+static int bit_reader_overrun(const bit_reader* br)
+{
+	return bit_reader_position(br) > br->inlength * 8;
+}
 
-static unsigned char read_bit(unsigned long *bitpointer, const unsigned char *bitstream)
+static unsigned read_bits(bit_reader* br, unsigned nbits)
 {
-	unsigned char result = (unsigned char)((bitstream[(*bitpointer) >> 3] >> ((*bitpointer) & 0x7)) & 1);
-	(*bitpointer)++;
+	unsigned result;
+	if (br->bitcount < nbits) {
+		bit_reader_refill(br);
+	}
+	result = (unsigned)(br->bitbuf & ((1ull << nbits) - 1));
+	bit_reader_consume(br, nbits);
 	return result;
 }
 
-static unsigned read_bits(unsigned long *bitpointer, const unsigned char *bitstream, unsigned long nbits)
+static unsigned reverse_bits(unsigned code, unsigned length)
 {
 	unsigned result = 0, i;
-	for (i = 0; i < nbits; i++)
-		result |= ((unsigned)read_bit(bitpointer, bitstream)) << i;
+	for (i = 0; i < length; i++) {
+		result = (result << 1) | ((code >> i) & 1);
+	}
 	return result;
 }
 
-/* the buffer must be numcodes*2 in size! */
-static void huffman_tree_init(huffman_tree* tree, unsigned* buffer, unsigned numcodes, unsigned maxbitlen)
+static void huffman_table_init(huffman_table* table, unsigned* buffer, unsigned capacity, unsigned primarybits)
 {
-	tree->tree2d = buffer;
-
-	tree->numcodes = numcodes;
-	tree->maxbitlen = maxbitlen;
+	table->entries = buffer;
+	table->capacity = capacity;
+	table->primarybits = primarybits;
 }
 
-/*given the code lengths (as stored in the PNG file), generate the tree as defined by Deflate. maxbitlen is the maximum bits that a code in the tree can have. return value is error.*/
-static void huffman_tree_create_lengths(upng_t* upng, huffman_tree* tree, const unsigned *bitlen)
+/*given the code lengths (as stored in the PNG file), generate the lookup table for the canonical code defined by Deflate.
+  codes of up to primarybits bits resolve with a single lookup, longer codes go through a secondary table indexed by the remaining bits.
+  deflate packs huffman codes starting at their most significant bit, so all codes are bit-reversed to index with the low bits of the bit buffer. */
+static void huffman_table_create_lengths(upng_t* upng, huffman_table* table, const unsigned *bitlen, unsigned numcodes)
 {
-	unsigned tree1d[MAX_SYMBOLS];
-	unsigned blcount[MAX_BIT_LENGTH];
-	unsigned nextcode[MAX_BIT_LENGTH+1];
+	unsigned blcount[MAX_BIT_LENGTH + 1];
+	unsigned nextcode[MAX_BIT_LENGTH + 1];
+	unsigned code[MAX_BIT_LENGTH + 1];
+	unsigned subbits[1 << HUFFMAN_PRIMARY_BITS];	/*for every primary index: bits needed by its secondary table, 0 if there is none */
+	unsigned primarysize = 1u << table->primarybits;
+	unsigned primarymask = primarysize - 1;
+	unsigned tablesize = primarysize;
 	unsigned bits, n, i;
-	unsigned nodefilled = 0;	/*up to which node it is filled */
-	unsigned treepos = 0;	/*position in the tree (1 of the numcodes columns) */
+	long left = 1;
 
 	/* initialize local vectors */
 	memset(blcount, 0, sizeof(blcount));
 	memset(nextcode, 0, sizeof(nextcode));
+	memset(subbits, 0, sizeof(subbits));
 
 	/*step 1: count number of instances of each code length */
-	for (bits = 0; bits < tree->numcodes; bits++) {
-		blcount[bitlen[bits]]++;
+	for (n = 0; n < numcodes; n++) {
+		blcount[bitlen[n]]++;
+	}
+	blcount[0] = 0;
+
+	/*an oversubscribed set of lengths cannot form a prefix code */
+	for (bits = 1; bits <= MAX_BIT_LENGTH; bits++) {
+		left = (left << 1) - (long)blcount[bits];
+		if (left < 0) {
+			SET_ERROR(upng, UPNG_EMALFORMED);
+			return;
+		}
 	}
 
 	/*step 2: generate the nextcode values */
-	for (bits = 1; bits <= tree->maxbitlen; bits++) {
+	for (bits = 1; bits <= MAX_BIT_LENGTH; bits++) {
 		nextcode[bits] = (nextcode[bits - 1] + blcount[bits - 1]) << 1;
 	}
 
-	/*step 3: generate all the codes */
-	for (n = 0; n < tree->numcodes; n++) {
-		if (bitlen[n] != 0) {
-			tree1d[n] = nextcode[bitlen[n]]++;
+	/*step 3: size the secondary tables; every primary index shared by long codes gets one large enough for the longest of them */
+	memcpy(code, nextcode, sizeof(code));
+	for (n = 0; n < numcodes; n++) {
+		unsigned len = bitlen[n];
+		if (len > table->primarybits) {
+			unsigned index = reverse_bits(code[len], len) & primarymask;
+			if (len - table->primarybits > subbits[index]) {
+				subbits[index] = len - table->primarybits;
+			}
+		}
+		if (len != 0) {
+			code[len]++;
 		}
 	}
 
-	/*convert tree1d[] to tree2d[][]. In the 2D array, a value of 32767 means uninited, a value >= numcodes is an address to another bit, a value < numcodes is a code. The 2 rows are the 2 possible bit values (0 or 1), there are as many columns as codes - 1
-	   a good huffmann tree has N * 2 - 1 nodes, of which N - 1 are internal nodes. Here, the internal nodes are stored (what their 0 and 1 option point to). There is only memory for such good tree currently, if there are more nodes (due to too long length codes), error 55 will happen */
-	for (n = 0; n < tree->numcodes * 2; n++) {
-		tree->tree2d[n] = 32767;	/*32767 here means the tree2d isn't filled there yet */
-	}
-
-	for (n = 0; n < tree->numcodes; n++) {	/*the codes */
-		for (i = 0; i < bitlen[n]; i++) {	/*the bits for this code */
-			unsigned char bit = (unsigned char)((tree1d[n] >> (bitlen[n] - i - 1)) & 1);
-			/* check if oversubscribed */
-			if (treepos > tree->numcodes - 2) {
+	/*entries with a length of 0 belong to no code, decoding one means the data is corrupt */
+	for (i = 0; i < primarysize; i++) {
+		if (subbits[i] != 0) {
+			unsigned subsize = 1u << subbits[i];
+			if (tablesize + subsize > table->capacity) {
 				SET_ERROR(upng, UPNG_EMALFORMED);
 				return;
 			}
-
-			if (tree->tree2d[2 * treepos + bit] == 32767) {	/*not yet filled in */
-				if (i + 1 == bitlen[n]) {	/*last bit */
-					tree->tree2d[2 * treepos + bit] = n;	/*put the current code in it */
-					treepos = 0;
-				} else {	/*put address of the next step in here, first that address has to be found of course (it's just nodefilled + 1)... */
-					nodefilled++;
-					tree->tree2d[2 * treepos + bit] = nodefilled + tree->numcodes;	/*addresses encoded with numcodes added to it */
-					treepos = nodefilled;
-				}
-			} else {
-				treepos = tree->tree2d[2 * treepos + bit] - tree->numcodes;
-			}
+			table->entries[i] = HUFFMAN_SUBTABLE_FLAG | HUFFMAN_ENTRY(tablesize, subbits[i]);
+			memset(&table->entries[tablesize], 0, subsize * sizeof(unsigned));
+			tablesize += subsize;
+		} else {
+			table->entries[i] = 0;
 		}
 	}
 
-	for (n = 0; n < tree->numcodes * 2; n++) {
-		if (tree->tree2d[n] == 32767) {
-			tree->tree2d[n] = 0;	/*remove possible remaining 32767's */
+	/*step 4: generate all the codes and replicate them over every table slot whose low bits match */
+	memcpy(code, nextcode, sizeof(code));
+	for (n = 0; n < numcodes; n++) {
+		unsigned len = bitlen[n];
+		unsigned reversed;
+		if (len == 0) {
+			continue;
+		}
+
+		reversed = reverse_bits(code[len]++, len);
+		if (len <= table->primarybits) {
+			for (i = reversed; i < primarysize; i += 1u << len) {
+				table->entries[i] = HUFFMAN_ENTRY(n, len);
+			}
+		} else {
+			unsigned link = table->entries[reversed & primarymask];
+			unsigned* subtable = &table->entries[HUFFMAN_ENTRY_VALUE(link)];
+			unsigned subsize = 1u << HUFFMAN_ENTRY_LENGTH(link);
+			for (i = reversed >> table->primarybits; i < subsize; i += 1u << (len - table->primarybits)) {
+				subtable[i] = HUFFMAN_ENTRY(n, len);
+			}
 		}
 	}
 }
 
-static unsigned huffman_decode_symbol(upng_t *upng, const unsigned char *in, unsigned long *bp, const huffman_tree* codetree, unsigned long inlength)
+static unsigned huffman_decode_symbol(upng_t *upng, bit_reader* br, const huffman_table* table)
 {
-	unsigned treepos = 0, ct;
-	unsigned char bit;
-	for (;;) {
-		/* error: end of input memory reached without endcode */
-		if (((*bp) & 0x07) == 0 && ((*bp) >> 3) > inlength) {
-			SET_ERROR(upng, UPNG_EMALFORMED);
-			return 0;
-		}
+	unsigned entry, length;
 
-		bit = read_bit(bp, in);
+	bit_reader_refill(br);
 
-		ct = codetree->tree2d[(treepos << 1) | bit];
-		if (ct < codetree->numcodes) {
-			return ct;
-		}
+	entry = table->entries[br->bitbuf & ((1u << table->primarybits) - 1)];
+	if (entry & HUFFMAN_SUBTABLE_FLAG) {
+		unsigned submask = (1u << HUFFMAN_ENTRY_LENGTH(entry)) - 1;
+		entry = table->entries[HUFFMAN_ENTRY_VALUE(entry) + ((unsigned)(br->bitbuf >> table->primarybits) & submask)];
+	}
 
-		treepos = ct - codetree->numcodes;
-		if (treepos >= codetree->numcodes) {
-			SET_ERROR(upng, UPNG_EMALFORMED);
-			return 0;
-		}
+	length = HUFFMAN_ENTRY_LENGTH(entry);
+	if (length == 0) {
+		SET_ERROR(upng, UPNG_EMALFORMED);
+		return 0;
 	}
+	bit_reader_consume(br, length);
+
+	/* error: end of input memory reached without endcode */
+	if (bit_reader_overrun(br)) {
+		SET_ERROR(upng, UPNG_EMALFORMED);
+		return 0;
+	}
+
+	return HUFFMAN_ENTRY_VALUE(entry);
 }
 
 /* get the tree of a deflated block with dynamic tree, the tree itself is also Huffman compressed with a known tree*/
-static void get_tree_inflate_dynamic(upng_t* upng, huffman_tree* codetree, huffman_tree* codetreeD, huffman_tree* codelengthcodetree, const unsigned char *in, unsigned long *bp, unsigned long inlength)
+static void get_tree_inflate_dynamic(upng_t* upng, huffman_table* codetree, huffman_table* codetreeD, huffman_table* codelengthcodetree, bit_reader* br)
 {
 	unsigned codelengthcode[NUM_CODE_LENGTH_CODES];
 	unsigned bitlen[NUM_DEFLATE_CODE_SYMBOLS];
@@ -304,7 +384,7 @@ static void get_tree_inflate_dynamic(upng_t* upng, huffman_tree* codetree, huffm
 
 	/*make sure that length values that aren't filled in will be 0, or a wrong tree will be generated */
 	/*C-code note: use no "return" between ctor and dtor of an uivector! */
-	if ((*bp) >> 3 >= inlength - 2) {
+	if (bit_reader_position(br) >> 3 >= br->inlength - 2) {
 		SET_ERROR(upng, UPNG_EMALFORMED);
 		return;
 	}
@@ -314,19 +394,19 @@ static void get_tree_inflate_dynamic(upng_t* upng, huffman_tree* codetree, huffm
 	memset(bitlenD, 0, sizeof(bitlenD));
 
 	/*the bit pointer is or will go past the memory */
-	hlit = read_bits(bp, in, 5) + 257;	/*number of literal/length codes + 257. Unlike the spec, the value 257 is added to it here already */
-	hdist = read_bits(bp, in, 5) + 1;	/*number of distance codes. Unlike the spec, the value 1 is added to it here already */
-	hclen = read_bits(bp, in, 4) + 4;	/*number of code length codes. Unlike the spec, the value 4 is added to it here already */
+	hlit = read_bits(br, 5) + 257;	/*number of literal/length codes + 257. Unlike the spec, the value 257 is added to it here already */
+	hdist = read_bits(br, 5) + 1;	/*number of distance codes. Unlike the spec, the value 1 is added to it here already */
+	hclen = read_bits(br, 4) + 4;	/*number of code length codes. Unlike the spec, the value 4 is added to it here already */
 
 	for (i = 0; i < NUM_CODE_LENGTH_CODES; i++) {
 		if (i < hclen) {
-			codelengthcode[CLCL[i]] = read_bits(bp, in, 3);
+			codelengthcode[CLCL[i]] = read_bits(br, 3);
 		} else {
 			codelengthcode[CLCL[i]] = 0;	/*if not, it must stay 0 */
 		}
 	}
 
-	huffman_tree_create_lengths(upng, codelengthcodetree, codelengthcode);
+	huffman_table_create_lengths(upng, codelengthcodetree, codelengthcode, NUM_CODE_LENGTH_CODES);
 
 	/* bail now if we encountered an error earlier */
 	if (upng->error != UPNG_EOK) {
@@ -336,7 +416,7 @@ static void get_tree_inflate_dynamic(upng_t* upng, huffman_tree* codetree, huffm
 	/*now we can use this tree to read the lengths for the tree that this function will return */
 	i = 0;
 	while (i < hlit + hdist) {	/*i is the current symbol we're reading in the part that contains the code lengths of lit/len codes and dist codes */
-		unsigned code = huffman_decode_symbol(upng, in, bp, codelengthcodetree, inlength);
+		unsigned code = huffman_decode_symbol(upng, br, codelengthcodetree);
 		if (upng->error != UPNG_EOK) {
 			break;
 		}
@@ -352,12 +432,12 @@ static void get_tree_inflate_dynamic(upng_t* upng, huffman_tree* codetree, huffm
 			unsigned replength = 3;	/*read in the 2 bits that indicate repeat length (3-6) */
 			unsigned value;	/*set value to the previous code */
 
-			if ((*bp) >> 3 >= inlength) {
+			/*error, there is no previous code to repeat, or the bit pointer jumps past memory */
+			if (i == 0 || bit_reader_position(br) >> 3 >= br->inlength) {
 				SET_ERROR(upng, UPNG_EMALFORMED);
 				break;
 			}
-			/*error, bit pointer jumps past memory */
-			replength += read_bits(bp, in, 2);
+			replength += read_bits(br, 2);
 
 			if ((i - 1) < hlit) {
 				value = bitlen[i - 1];
@@ -382,13 +462,13 @@ static void get_tree_inflate_dynamic(upng_t* upng, huffman_tree* codetree, huffm
 			}
 		} else if (code == 17) {	/*repeat "0" 3-10 times */
 			unsigned replength = 3;	/*read in the bits that indicate repeat length */
-			if ((*bp) >> 3 >= inlength) {
+			if (bit_reader_position(br) >> 3 >= br->inlength) {
 				SET_ERROR(upng, UPNG_EMALFORMED);
 				break;
 			}
 
 			/*error, bit pointer jumps past memory */
-			replength += read_bits(bp, in, 3);
+			replength += read_bits(br, 3);
 
 			/*repeat this value in the next lengths */
 			for (n = 0; n < replength; n++) {
@@ -408,12 +488,12 @@ static void get_tree_inflate_dynamic(upng_t* upng, huffman_tree* codetree, huffm
 		} else if (code == 18) {	/*repeat "0" 11-138 times */
 			unsigned replength = 11;	/*read in the bits that indicate repeat length */
 			/* error, bit pointer jumps past memory */
-			if ((*bp) >> 3 >= inlength) {
+			if (bit_reader_position(br) >> 3 >= br->inlength) {
 				SET_ERROR(upng, UPNG_EMALFORMED);
 				break;
 			}
 
-			replength += read_bits(bp, in, 7);
+			replength += read_bits(br, 7);
 
 			/*repeat this value in the next lengths */
 			for (n = 0; n < replength; n++) {
@@ -442,40 +522,61 @@ static void get_tree_inflate_dynamic(upng_t* upng, huffman_tree* codetree, huffm
 	/*the length of the end code 256 must be larger than 0 */
 	/*now we've finally got hlit and hdist, so generate the code trees, and the function is done */
 	if (upng->error == UPNG_EOK) {
-		huffman_tree_create_lengths(upng, codetree, bitlen);
+		huffman_table_create_lengths(upng, codetree, bitlen, NUM_DEFLATE_CODE_SYMBOLS);
 	}
 	if (upng->error == UPNG_EOK) {
-		huffman_tree_create_lengths(upng, codetreeD, bitlenD);
+		huffman_table_create_lengths(upng, codetreeD, bitlenD, NUM_DISTANCE_SYMBOLS);
 	}
 }
 
+/*the fixed litlen/distance codes of block type 1, as code lengths (cfr. deflate spec 3.2.6) */
+static void get_tree_inflate_fixed(upng_t* upng, huffman_table* codetree, huffman_table* codetreeD)
+{
+	unsigned bitlen[NUM_DEFLATE_CODE_SYMBOLS];
+	unsigned bitlenD[NUM_DISTANCE_SYMBOLS];
+	unsigned i;
+
+	for (i = 0; i < 144; i++) bitlen[i] = 8;
+	for (i = 144; i < 256; i++) bitlen[i] = 9;
+	for (i = 256; i < 280; i++) bitlen[i] = 7;
+	for (i = 280; i < NUM_DEFLATE_CODE_SYMBOLS; i++) bitlen[i] = 8;
+	for (i = 0; i < NUM_DISTANCE_SYMBOLS; i++) bitlenD[i] = 5;
+
+	huffman_table_create_lengths(upng, codetree, bitlen, NUM_DEFLATE_CODE_SYMBOLS);
+	huffman_table_create_lengths(upng, codetreeD, bitlenD, NUM_DISTANCE_SYMBOLS);
+}
+
 /*inflate a block with dynamic of fixed Huffman tree*/
-static void inflate_huffman(upng_t* upng, unsigned char* out, unsigned long outsize, const unsigned char *in, unsigned long *bp, unsigned long *pos, unsigned long inlength, unsigned btype)
+static void inflate_huffman(upng_t* upng, unsigned char* out, unsigned long outsize, bit_reader* br, unsigned long *pos, unsigned btype)
 {
-	unsigned codetree_buffer[DEFLATE_CODE_BUFFER_SIZE];
-	unsigned codetreeD_buffer[DISTANCE_BUFFER_SIZE];
+	unsigned codetree_buffer[DEFLATE_CODE_TABLE_SIZE];
+	unsigned codetreeD_buffer[DISTANCE_TABLE_SIZE];
 	unsigned done = 0;
 
-	huffman_tree codetree;
-	huffman_tree codetreeD;
+	huffman_table codetree;
+	huffman_table codetreeD;
+
+	huffman_table_init(&codetree, codetree_buffer, DEFLATE_CODE_TABLE_SIZE, HUFFMAN_PRIMARY_BITS);
+	huffman_table_init(&codetreeD, codetreeD_buffer, DISTANCE_TABLE_SIZE, HUFFMAN_PRIMARY_BITS);
 
 	if (btype == 1) {
 		/* fixed trees */
-		huffman_tree_init(&codetree, (unsigned*)FIXED_DEFLATE_CODE_TREE, NUM_DEFLATE_CODE_SYMBOLS, DEFLATE_CODE_BITLEN);
-		huffman_tree_init(&codetreeD, (unsigned*)FIXED_DISTANCE_TREE, NUM_DISTANCE_SYMBOLS, DISTANCE_BITLEN);
+		get_tree_inflate_fixed(upng, &codetree, &codetreeD);
 	} else if (btype == 2) {
 		/* dynamic trees */
-		unsigned codelengthcodetree_buffer[CODE_LENGTH_BUFFER_SIZE];
-		huffman_tree codelengthcodetree;
+		unsigned codelengthcodetree_buffer[CODE_LENGTH_TABLE_SIZE];
+		huffman_table codelengthcodetree;
+
+		huffman_table_init(&codelengthcodetree, codelengthcodetree_buffer, CODE_LENGTH_TABLE_SIZE, CODE_LENGTH_PRIMARY_BITS);
+		get_tree_inflate_dynamic(upng, &codetree, &codetreeD, &codelengthcodetree, br);
+	}
 
-		huffman_tree_init(&codetree, codetree_buffer, NUM_DEFLATE_CODE_SYMBOLS, DEFLATE_CODE_BITLEN);
-		huffman_tree_init(&codetreeD, codetreeD_buffer, NUM_DISTANCE_SYMBOLS, DISTANCE_BITLEN);
-		huffman_tree_init(&codelengthcodetree, codelengthcodetree_buffer, NUM_CODE_LENGTH_CODES, CODE_LENGTH_BITLEN);
-		get_tree_inflate_dynamic(upng, &codetree, &codetreeD, &codelengthcodetree, in, bp, inlength);
+	if (upng->error != UPNG_EOK) {
+		return;
 	}
 
 	while (done == 0) {
-		unsigned code = huffman_decode_symbol(upng, in, bp, &codetree, inlength);
+		unsigned code = huffman_decode_symbol(upng, br, &codetree);
 		if (upng->error != UPNG_EOK) {
 			return;
 		}
@@ -496,20 +597,15 @@ static void inflate_huffman(upng_t* upng, unsigned char* out, unsigned long outs
 			/* part 1: get length base */
 			unsigned long length = LENGTH_BASE[code - FIRST_LENGTH_CODE_INDEX];
 			unsigned codeD, distance, numextrabitsD;
-			unsigned long start, forward, backward, numextrabits;
+			unsigned long forward, numextrabits;
+			unsigned char* dest;
 
 			/* part 2: get extra bits and add the value of that to length */
 			numextrabits = LENGTH_EXTRA[code - FIRST_LENGTH_CODE_INDEX];
-
-			/* error, bit pointer will jump past memory */
-			if (((*bp) >> 3) >= inlength) {
-				SET_ERROR(upng, UPNG_EMALFORMED);
-				return;
-			}
-			length += read_bits(bp, in, numextrabits);
+			length += read_bits(br, numextrabits);
 
 			/*part 3: get distance code */
-			codeD = huffman_decode_symbol(upng, in, bp, &codetreeD, inlength);
+			codeD = huffman_decode_symbol(upng, br, &codetreeD);
 			if (upng->error != UPNG_EOK) {
 				return;
 			}
@@ -524,46 +620,43 @@ static void inflate_huffman(upng_t* upng, unsigned char* out, unsigned long outs
 
 			/*part 4: get extra bits from distance */
 			numextrabitsD = DISTANCE_EXTRA[codeD];
+			distance += read_bits(br, numextrabitsD);
 
-			/* error, bit pointer will jump past memory */
-			if (((*bp) >> 3) >= inlength) {
+			/* error, bit pointer jumped past memory */
+			if (bit_reader_overrun(br)) {
 				SET_ERROR(upng, UPNG_EMALFORMED);
 				return;
 			}
 
-			distance += read_bits(bp, in, numextrabitsD);
-
 			/*part 5: fill in all the out[n] values based on the length and dist */
-			start = (*pos);
-			backward = start - distance;
-
-			if ((*pos) + length >= outsize) {
+			if (distance > (*pos) || (*pos) + length > outsize) {
 				SET_ERROR(upng, UPNG_EMALFORMED);
 				return;
 			}
 
+			/*byte per byte, since the source may overlap the bytes being written (distance < length) */
+			dest = &out[*pos];
 			for (forward = 0; forward < length; forward++) {
-				out[(*pos)++] = out[backward];
-				backward++;
-
-				if (backward >= start) {
-					backward = start - distance;
-				}
+				dest[forward] = dest[forward - distance];
 			}
+			(*pos) += length;
+		} else {
+			/* litlen codes 286-287 are never used */
+			SET_ERROR(upng, UPNG_EMALFORMED);
+			return;
 		}
 	}
 }
 
-static void inflate_uncompressed(upng_t* upng, unsigned char* out, unsigned long outsize, const unsigned char *in, unsigned long *bp, unsigned long *pos, unsigned long inlength)
+static void inflate_uncompressed(upng_t* upng, unsigned char* out, unsigned long outsize, bit_reader* br, unsigned long *pos)
 {
+	const unsigned char* in = br->in;
+	unsigned long inlength = br->inlength;
 	unsigned long p;
-	unsigned len, nlen, n;
+	unsigned len, nlen;
 
 	/* go to first boundary of byte */
-	while (((*bp) & 0x7) != 0) {
-		(*bp)++;
-	}
-	p = (*bp) / 8;		/*byte position */
+	p = (bit_reader_position(br) + 7) / 8;		/*byte position */
 
 	/* read len (2 bytes) and nlen (2 bytes) */
 	if (p >= inlength - 4) {
@@ -582,7 +675,7 @@ static void inflate_uncompressed(upng_t* upng, unsigned char* out, unsigned long
 		return;
 	}
 
-	if ((*pos) + len >= outsize) {
+	if ((*pos) + len > outsize) {
 		SET_ERROR(upng, UPNG_EMALFORMED);
 		return;
 	}
@@ -593,42 +686,45 @@ static void inflate_uncompressed(upng_t* upng, unsigned char* out, unsigned long
 		return;
 	}
 
-	for (n = 0; n < len; n++) {
-		out[(*pos)++] = in[p++];
-	}
+	memcpy(&out[*pos], &in[p], len);
+	(*pos) += len;
+	p += len;
 
-	(*bp) = p * 8;
+	/* restart the bit buffer at the byte after the stored data */
+	bit_reader_init(br, in, inlength, p);
 }
 
 /*inflate the deflated data (cfr. deflate spec); return value is the error*/
 static upng_error uz_inflate_data(upng_t* upng, unsigned char* out, unsigned long outsize, const unsigned char *in, unsigned long insize, unsigned long inpos)
 {
-	unsigned long bp = 0;	/*bit pointer in the "in" data, current byte is bp >> 3, current bit is bp & 0x7 (from lsb to msb of the byte) */
+	bit_reader br;	/*bit reader over the "in" data, bits are read from lsb to msb of each byte */
 	unsigned long pos = 0;	/*byte position in the out buffer */
 
 	unsigned done = 0;
 
+	bit_reader_init(&br, in, insize, inpos);
+
 	while (done == 0) {
 		unsigned btype;
 
 		/* ensure next bit doesn't point past the end of the buffer */
-		if ((bp >> 3) >= insize) {
+		if ((bit_reader_position(&br) >> 3) >= insize) {
 			SET_ERROR(upng, UPNG_EMALFORMED);
 			return upng->error;
 		}
 
 		/* read block control bits */
-		done = read_bit(&bp, &in[inpos]);
-		btype = read_bit(&bp, &in[inpos]) | (read_bit(&bp, &in[inpos]) << 1);
+		done = read_bits(&br, 1);
+		btype = read_bits(&br, 2);
 
 		/* process control type appropriateyly */
 		if (btype == 3) {
 			SET_ERROR(upng, UPNG_EMALFORMED);
 			return upng->error;
 		} else if (btype == 0) {
-			inflate_uncompressed(upng, out, outsize, &in[inpos], &bp, &pos, insize);	/*no compression */
+			inflate_uncompressed(upng, out, outsize, &br, &pos);	/*no compression */
 		} else {
-			inflate_huffman(upng, out, outsize, &in[inpos], &bp, &pos, insize, btype);	/*compression, btype 01 or 10 */
+			inflate_huffman(upng, out, outsize, &br, &pos, btype);	/*compression, btype 01 or 10 */
 		}
 
 		/* stop if an error has occured */
@@ -688,6 +784,188 @@ static int paeth_predictor(int a, int b, int c)
 		return c;
 }
 
+#if defined(UPNG_X86_SIMD)
+/*
+   SIMD versions of the filters for 3 and 4 byte pixels (8-bit RGB and RGBA). Sub, Average and Paeth depend on
+   the previous pixel, so they run one pixel per step with all channels of the pixel in parallel. Up has no such
+   dependency and processes 16 bytes per step. Paeth follows the trick used by libpng: the three distances are
+   computed with 16-bit lanes, and the predictor is picked with compare masks instead of branches.
+ */
+UPNG_TARGET("sse2") static __m128i load_pixel(const unsigned char* p, unsigned long bytewidth)
+{
+	int value = 0;
+	memcpy(&value, p, bytewidth);
+	return _mm_cvtsi32_si128(value);
+}
+
+UPNG_TARGET("sse2") static void store_pixel(unsigned char* p, __m128i v, unsigned long bytewidth)
+{
+	int value = _mm_cvtsi128_si32(v);
+	memcpy(p, &value, bytewidth);
+}
+
+UPNG_TARGET("sse2") static void unfilter_sub_sse2(unsigned char *recon, const unsigned char *scanline, unsigned long bytewidth, unsigned long length)
+{
+	__m128i a = _mm_setzero_si128();
+	unsigned long i;
+	for (i = 0; i < length; i += bytewidth) {
+		a = _mm_add_epi8(load_pixel(&scanline[i], bytewidth), a);
+		store_pixel(&recon[i], a, bytewidth);
+	}
+}
+
+UPNG_TARGET("sse2") static void unfilter_up_sse2(unsigned char *recon, const unsigned char *scanline, const unsigned char *precon, unsigned long length)
+{
+	unsigned long i;
+	for (i = 0; i + 16 <= length; i += 16) {
+		__m128i x = _mm_loadu_si128((const __m128i*)&scanline[i]);
+		__m128i b = _mm_loadu_si128((const __m128i*)&precon[i]);
+		_mm_storeu_si128((__m128i*)&recon[i], _mm_add_epi8(x, b));
+	}
+	for (; i < length; i++)
+		recon[i] = scanline[i] + precon[i];
+}
+
+UPNG_TARGET("sse2") static void unfilter_average_sse2(unsigned char *recon, const unsigned char *scanline, const unsigned char *precon, unsigned long bytewidth, unsigned long length)
+{
+	__m128i one = _mm_set1_epi8(1);
+	__m128i a = _mm_setzero_si128();
+	unsigned long i;
+	for (i = 0; i < length; i += bytewidth) {
+		__m128i b = load_pixel(&precon[i], bytewidth);
+		/* _mm_avg_epu8 rounds up, the filter rounds down */
+		__m128i average = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+		a = _mm_add_epi8(load_pixel(&scanline[i], bytewidth), average);
+		store_pixel(&recon[i], a, bytewidth);
+	}
+}
+
+/*pick whichever of a, b and c is nearest to p = a + b - c, ties favor a over b over c */
+UPNG_TARGET("sse2") static __m128i paeth_select(__m128i a, __m128i b, __m128i c, __m128i pa, __m128i pb, __m128i pc)
+{
+	__m128i smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+	__m128i use_a = _mm_cmpeq_epi16(smallest, pa);
+	__m128i use_b = _mm_andnot_si128(use_a, _mm_cmpeq_epi16(smallest, pb));
+	__m128i nearest = _mm_or_si128(_mm_and_si128(use_b, b), _mm_andnot_si128(use_b, c));
+	return _mm_or_si128(_mm_and_si128(use_a, a), _mm_andnot_si128(use_a, nearest));
+}
+
+UPNG_TARGET("sse2") static void unfilter_paeth_sse2(unsigned char *recon, const unsigned char *scanline, const unsigned char *precon, unsigned long bytewidth, unsigned long length)
+{
+	__m128i zero = _mm_setzero_si128();
+	__m128i a = zero, b = zero, c, d;
+	unsigned long i;
+	for (i = 0; i < length; i += bytewidth) {
+		__m128i pa, pb, pc;
+		c = b;
+		b = _mm_unpacklo_epi8(load_pixel(&precon[i], bytewidth), zero);
+		d = _mm_unpacklo_epi8(load_pixel(&scanline[i], bytewidth), zero);
+
+		pa = _mm_sub_epi16(b, c);	/* p - a = b - c */
+		pb = _mm_sub_epi16(a, c);	/* p - b = a - c */
+		pc = _mm_add_epi16(pa, pb);	/* p - c = (b - c) + (a - c) */
+		pa = _mm_max_epi16(pa, _mm_sub_epi16(zero, pa));
+		pb = _mm_max_epi16(pb, _mm_sub_epi16(zero, pb));
+		pc = _mm_max_epi16(pc, _mm_sub_epi16(zero, pc));
+
+		/* add with 8-bit lanes so the sum wraps modulo 256, the high bytes of the 16-bit lanes stay zero */
+		a = _mm_add_epi8(d, paeth_select(a, b, c, pa, pb, pc));
+		store_pixel(&recon[i], _mm_packus_epi16(a, a), bytewidth);
+	}
+}
+
+/*same as unfilter_paeth_sse2, with the single instruction absolute value of SSSE3 */
+UPNG_TARGET("ssse3") static void unfilter_paeth_ssse3(unsigned char *recon, const unsigned char *scanline, const unsigned char *precon, unsigned long bytewidth, unsigned long length)
+{
+	__m128i zero = _mm_setzero_si128();
+	__m128i a = zero, b = zero, c, d;
+	unsigned long i;
+	for (i = 0; i < length; i += bytewidth) {
+		__m128i pa, pb, pc;
+		c = b;
+		b = _mm_unpacklo_epi8(load_pixel(&precon[i], bytewidth), zero);
+		d = _mm_unpacklo_epi8(load_pixel(&scanline[i], bytewidth), zero);
+
+		pa = _mm_sub_epi16(b, c);
+		pb = _mm_sub_epi16(a, c);
+		pc = _mm_add_epi16(pa, pb);
+		pa = _mm_abs_epi16(pa);
+		pb = _mm_abs_epi16(pb);
+		pc = _mm_abs_epi16(pc);
+
+		a = _mm_add_epi8(d, paeth_select(a, b, c, pa, pb, pc));
+		store_pixel(&recon[i], _mm_packus_epi16(a, a), bytewidth);
+	}
+}
+
+static upng_simd detect_simd(void)
+{
+	unsigned regs[4] = { 0, 0, 0, 0 };	/* eax, ebx, ecx, edx of cpuid leaf 1 */
+#if defined(_MSC_VER) && !defined(__clang__)
+	__cpuid((int*)regs, 1);
+#else
+	if (!__get_cpuid(1, &regs[0], &regs[1], &regs[2], &regs[3])) {
+		return UPNG_SIMD_NONE;
+	}
+#endif
+	if (regs[2] & (1u << 9)) {
+		return UPNG_SIMD_SSSE3;
+	}
+	if (regs[3] & (1u << 26)) {
+		return UPNG_SIMD_SSE2;
+	}
+	return UPNG_SIMD_NONE;
+}
+
+/*returns 1 if the scanline was unfiltered with SIMD, 0 if the caller has to fall back to the scalar filters */
+static int unfilter_scanline_simd(upng_t* upng, unsigned char *recon, const unsigned char *scanline, const unsigned char *precon, unsigned long bytewidth, unsigned char filterType, unsigned long length)
+{
+	if (upng->simd == UPNG_SIMD_NONE) {
+		return 0;
+	}
+
+	if (filterType == 2 && precon) {
+		unfilter_up_sse2(recon, scanline, precon, length);
+		return 1;
+	}
+
+	if (bytewidth != 3 && bytewidth != 4) {
+		return 0;
+	}
+
+	switch (filterType) {
+	case 1:
+		unfilter_sub_sse2(recon, scanline, bytewidth, length);
+		return 1;
+	case 3:
+		if (!precon)
+			return 0;
+		unfilter_average_sse2(recon, scanline, precon, bytewidth, length);
+		return 1;
+	case 4:
+		if (!precon)
+			return 0;
+		if (upng->simd == UPNG_SIMD_SSSE3)
+			unfilter_paeth_ssse3(recon, scanline, precon, bytewidth, length);
+		else
+			unfilter_paeth_sse2(recon, scanline, precon, bytewidth, length);
+		return 1;
+	default:
+		return 0;
+	}
+}
+#else
+static upng_simd detect_simd(void)
+{
+	return UPNG_SIMD_NONE;
+}
+
+static int unfilter_scanline_simd(upng_t* upng, unsigned char *recon, const unsigned char *scanline, const unsigned char *precon, unsigned long bytewidth, unsigned char filterType, unsigned long length)
+{
+	return 0;
+}
+#endif
+
 static void unfilter_scanline(upng_t* upng, unsigned char *recon, const unsigned char *scanline, const unsigned char *precon, unsigned long bytewidth, unsigned char filterType, unsigned long length)
 {
 	/*
@@ -699,6 +977,11 @@ static void unfilter_scanline(upng_t* upng, unsigned char *recon, const unsigned
 	 */
 
 	unsigned long i;
+
+	if (unfilter_scanline_simd(upng, recon, scanline, precon, bytewidth, filterType, length)) {
+		return;
+	}
+
 	switch (filterType) {
 	case 0:
 		for (i = 0; i < length; i++)
@@ -1140,6 +1423,8 @@ static upng_t* upng_new(void)
 	upng->source.size = 0;
 	upng->source.owning = 0;
 
+	upng->simd = detect_simd();
+
 	return upng;
 }
 
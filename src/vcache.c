@@ -0,0 +1,235 @@
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vcache.h"
+#include "array.h"
+
+// scoring constants from the paper.
+#define CACHE_DECAY_POWER 1.5f
+#define LAST_FACE_SCORE 0.75f
+#define VALENCE_BOOST_SCALE 2.0f
+#define VALENCE_BOOST_POWER 0.5f
+
+// vertices in the cache score by how recently they were used, the three of the last face all get the same score
+// so the next face is not biased towards one edge. vertices with few faces left get a boost so no lone faces are left behind.
+static float score_vertex(int cache_position, int remaining_face_count) {
+    if (remaining_face_count == 0) {
+        return -1.0f;
+    }
+
+    float score = 0.0f;
+    if (cache_position >= 0) {
+        if (cache_position < 3) {
+            score = LAST_FACE_SCORE;
+        } else {
+            float scale = 1.0f / (VCACHE_SIZE - 3);
+            score = powf(1.0f - (cache_position - 3) * scale, CACHE_DECAY_POWER);
+        }
+    }
+    score += VALENCE_BOOST_SCALE * powf((float)remaining_face_count, -VALENCE_BOOST_POWER);
+    return score;
+}
+
+void optimize_vertex_cache(face_t* faces, int vertex_count) {
+    int face_count = array_length(faces);
+    if (face_count == 0 || vertex_count == 0) {
+        return;
+    }
+
+    // faces per vertex, as one flat array sliced by face_offsets. the first remaining_face_counts[v] entries
+    // of a slice are the faces of v that have not been emitted yet.
+    int* face_offsets = (int*)calloc(vertex_count + 1, sizeof(int));
+    int* remaining_face_counts = (int*)calloc(vertex_count, sizeof(int));
+    int* vertex_faces = (int*)malloc(sizeof(int) * face_count * 3);
+    int* cache_positions = (int*)malloc(sizeof(int) * vertex_count);
+    float* vertex_scores = (float*)malloc(sizeof(float) * vertex_count);
+    float* face_scores = (float*)malloc(sizeof(float) * face_count);
+    bool* is_face_emitted = (bool*)calloc(face_count, sizeof(bool));
+    face_t* sorted_faces = (face_t*)malloc(sizeof(face_t) * face_count);
+
+    for (int face_idx = 0; face_idx < face_count; ++face_idx) {
+        remaining_face_counts[faces[face_idx].a] += 1;
+        remaining_face_counts[faces[face_idx].b] += 1;
+        remaining_face_counts[faces[face_idx].c] += 1;
+    }
+    for (int vertex_idx = 0; vertex_idx < vertex_count; ++vertex_idx) {
+        face_offsets[vertex_idx + 1] = face_offsets[vertex_idx] + remaining_face_counts[vertex_idx];
+        remaining_face_counts[vertex_idx] = 0;
+    }
+    for (int face_idx = 0; face_idx < face_count; ++face_idx) {
+        int corners[3] = { faces[face_idx].a, faces[face_idx].b, faces[face_idx].c };
+        for (int corner = 0; corner < 3; ++corner) {
+            int vertex_idx = corners[corner];
+            vertex_faces[face_offsets[vertex_idx] + remaining_face_counts[vertex_idx]] = face_idx;
+            remaining_face_counts[vertex_idx] += 1;
+        }
+    }
+
+    for (int vertex_idx = 0; vertex_idx < vertex_count; ++vertex_idx) {
+        cache_positions[vertex_idx] = -1;
+        vertex_scores[vertex_idx] = score_vertex(-1, remaining_face_counts[vertex_idx]);
+    }
+    for (int face_idx = 0; face_idx < face_count; ++face_idx) {
+        face_t face = faces[face_idx];
+        face_scores[face_idx] = vertex_scores[face.a] + vertex_scores[face.b] + vertex_scores[face.c];
+    }
+
+    // the cache briefly holds VCACHE_SIZE + 3 entries: the vertices pushed out by a face still need their faces rescored.
+    int cache[VCACHE_SIZE + 3];
+    int cache_count = 0;
+    int best_face = -1;
+
+    for (int sorted_idx = 0; sorted_idx < face_count; ++sorted_idx) {
+        // nothing in the cache has faces left (a new island), fall back to the best face overall.
+        if (best_face < 0) {
+            float best_score = -1.0f;
+            for (int face_idx = 0; face_idx < face_count; ++face_idx) {
+                if (!is_face_emitted[face_idx] && face_scores[face_idx] > best_score) {
+                    best_score = face_scores[face_idx];
+                    best_face = face_idx;
+                }
+            }
+        }
+
+        face_t face = faces[best_face];
+        sorted_faces[sorted_idx] = face;
+        is_face_emitted[best_face] = true;
+
+        int corners[3] = { face.a, face.b, face.c };
+        for (int corner = 0; corner < 3; ++corner) {
+            int vertex_idx = corners[corner];
+            int* slice = &vertex_faces[face_offsets[vertex_idx]];
+            for (int slice_idx = 0; slice_idx < remaining_face_counts[vertex_idx]; ++slice_idx) {
+                if (slice[slice_idx] == best_face) {
+                    slice[slice_idx] = slice[remaining_face_counts[vertex_idx] - 1];
+                    remaining_face_counts[vertex_idx] -= 1;
+                    break;
+                }
+            }
+        }
+
+        // the face's vertices move to the front, everything else keeps its order behind them.
+        int new_cache[VCACHE_SIZE + 3];
+        int new_cache_count = 0;
+        for (int corner = 0; corner < 3; ++corner) {
+            bool is_duplicate = false;
+            for (int cache_idx = 0; cache_idx < new_cache_count; ++cache_idx) {
+                is_duplicate |= new_cache[cache_idx] == corners[corner];
+            }
+            if (!is_duplicate) {
+                new_cache[new_cache_count++] = corners[corner];
+            }
+        }
+        for (int cache_idx = 0; cache_idx < cache_count; ++cache_idx) {
+            int vertex_idx = cache[cache_idx];
+            if (vertex_idx != face.a && vertex_idx != face.b && vertex_idx != face.c) {
+                new_cache[new_cache_count++] = vertex_idx;
+            }
+        }
+
+        for (int cache_idx = 0; cache_idx < new_cache_count; ++cache_idx) {
+            int vertex_idx = new_cache[cache_idx];
+            cache_positions[vertex_idx] = cache_idx < VCACHE_SIZE ? cache_idx : -1;
+            vertex_scores[vertex_idx] = score_vertex(cache_positions[vertex_idx], remaining_face_counts[vertex_idx]);
+        }
+
+        // only faces touching the cache changed score, so the next face is picked from those.
+        best_face = -1;
+        float best_score = -1.0f;
+        for (int cache_idx = 0; cache_idx < new_cache_count; ++cache_idx) {
+            int vertex_idx = new_cache[cache_idx];
+            int* slice = &vertex_faces[face_offsets[vertex_idx]];
+            for (int slice_idx = 0; slice_idx < remaining_face_counts[vertex_idx]; ++slice_idx) {
+                int face_idx = slice[slice_idx];
+                face_t neighbour = faces[face_idx];
+                float score = vertex_scores[neighbour.a] + vertex_scores[neighbour.b] + vertex_scores[neighbour.c];
+                face_scores[face_idx] = score;
+                if (score > best_score) {
+                    best_score = score;
+                    best_face = face_idx;
+                }
+            }
+        }
+
+        cache_count = new_cache_count < VCACHE_SIZE ? new_cache_count : VCACHE_SIZE;
+        memcpy(cache, new_cache, sizeof(int) * cache_count);
+    }
+
+    memcpy(faces, sorted_faces, sizeof(face_t) * face_count);
+
+    free(sorted_faces);
+    free(is_face_emitted);
+    free(face_scores);
+    free(vertex_scores);
+    free(cache_positions);
+    free(vertex_faces);
+    free(remaining_face_counts);
+    free(face_offsets);
+}
+
+void optimize_vertex_fetch(vec3_t* vertices, face_t* faces) {
+    int vertex_count = array_length(vertices);
+    int face_count = array_length(faces);
+    if (vertex_count == 0) {
+        return;
+    }
+
+    int* remap = (int*)malloc(sizeof(int) * vertex_count);
+    for (int vertex_idx = 0; vertex_idx < vertex_count; ++vertex_idx) {
+        remap[vertex_idx] = -1;
+    }
+
+    int next_vertex = 0;
+    for (int face_idx = 0; face_idx < face_count; ++face_idx) {
+        int* corners[3] = { &faces[face_idx].a, &faces[face_idx].b, &faces[face_idx].c };
+        for (int corner = 0; corner < 3; ++corner) {
+            int vertex_idx = *corners[corner];
+            if (remap[vertex_idx] < 0) {
+                remap[vertex_idx] = next_vertex++;
+            }
+            *corners[corner] = remap[vertex_idx];
+        }
+    }
+    for (int vertex_idx = 0; vertex_idx < vertex_count; ++vertex_idx) {
+        if (remap[vertex_idx] < 0) {
+            remap[vertex_idx] = next_vertex++;
+        }
+    }
+
+    vec3_t* remapped = (vec3_t*)malloc(sizeof(vec3_t) * vertex_count);
+    for (int vertex_idx = 0; vertex_idx < vertex_count; ++vertex_idx) {
+        remapped[remap[vertex_idx]] = vertices[vertex_idx];
+    }
+    memcpy(vertices, remapped, sizeof(vec3_t) * vertex_count);
+
+    free(remapped);
+    free(remap);
+}
+
+float get_average_cache_miss_ratio(face_t* faces, int vertex_count, int cache_size) {
+    int face_count = array_length(faces);
+    if (face_count == 0) {
+        return 0.0f;
+    }
+
+    // a vertex is in a FIFO cache if fewer than cache_size misses happened since it was loaded.
+    int* loaded_at = (int*)malloc(sizeof(int) * vertex_count);
+    for (int vertex_idx = 0; vertex_idx < vertex_count; ++vertex_idx) {
+        loaded_at[vertex_idx] = -cache_size - 1;
+    }
+
+    int miss_count = 0;
+    for (int face_idx = 0; face_idx < face_count; ++face_idx) {
+        int corners[3] = { faces[face_idx].a, faces[face_idx].b, faces[face_idx].c };
+        for (int corner = 0; corner < 3; ++corner) {
+            if (miss_count - loaded_at[corners[corner]] > cache_size) {
+                loaded_at[corners[corner]] = miss_count;
+                miss_count += 1;
+            }
+        }
+    }
+
+    free(loaded_at);
+    return (float)miss_count / (float)face_count;
+}
@@ -0,0 +1,21 @@
+#ifndef VCACHE_H
+#define VCACHE_H
+
+#include "vector.h"
+#include "triangle.h"
+
+// size of the simulated LRU cache the face order is optimized for.
+#define VCACHE_SIZE 32
+
+// reorders faces (in place) so consecutive faces reuse recently used vertices,
+// using Tom Forsyth's "Linear-Speed Vertex Cache Optimisation".
+void optimize_vertex_cache(face_t* faces, int vertex_count);
+
+// renumbers vertices in the order the faces first use them, so the face loop walks memory forward.
+// vertices that no face uses end up at the back.
+void optimize_vertex_fetch(vec3_t* vertices, face_t* faces);
+
+// average number of cache misses per face for a FIFO cache of the given size, 3.0 is the worst case.
+float get_average_cache_miss_ratio(face_t* faces, int vertex_count, int cache_size);
+
+#endif
@@ -0,0 +1,398 @@
+#if !defined(_WIN32)
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include "vtexture.h"
+#include "array.h"
+#include "job.h"
+
+// page table entries that are not a slot.
+#define PAGE_NOT_RESIDENT -1
+#define PAGE_LOADING -2
+#define PAGE_FAILED -3 // unreadable, never requested again.
+
+enum PAGE_SLOT_STATE {
+    PAGE_SLOT_STATE_FREE,
+    PAGE_SLOT_STATE_LOADING, // owned by a job
+    PAGE_SLOT_STATE_LOADED, // written by the job, published at the next update.
+    PAGE_SLOT_STATE_FAILED,
+    PAGE_SLOT_STATE_RESIDENT,
+};
+
+typedef struct {
+    virtual_texture_t* owner;
+    int page;
+    int last_used_frame;
+    SDL_atomic_t state;
+} page_slot_t;
+
+typedef struct {
+    virtual_texture_t* texture;
+    int page;
+    int mip;
+} page_request_t;
+
+static virtual_texture_t** virtual_textures = NULL;
+static size_t cache_budget = DEFAULT_VIRTUAL_TEXTURE_CACHE_BUDGET;
+static bool is_cache_stale = true;
+static page_slot_t* slots = NULL;
+static uint32_t* slot_texels = NULL; // VIRTUAL_TEXTURE_PAGE_SIZE squared texels per slot.
+static int slot_count = 0;
+static int pending_load_count = 0;
+static int virtual_texture_frame = 0;
+// misses recorded by the sampler during the frame, dynamic array.
+static page_request_t* page_requests = NULL;
+
+static uint64_t get_page_data_offset(void) {
+    uint64_t header_size = sizeof(virtual_texture_file_header_t);
+    return (header_size + VIRTUAL_TEXTURE_FILE_ALIGNMENT - 1) / VIRTUAL_TEXTURE_FILE_ALIGNMENT * VIRTUAL_TEXTURE_FILE_ALIGNMENT;
+}
+
+// a 16k texture with mips is past what a long can address on windows.
+static bool read_file_at(FILE* file, uint64_t offset, void* data, size_t size) {
+#if defined(_WIN32)
+    if (_fseeki64(file, (__int64)offset, SEEK_SET) != 0) {
+#else
+    if (fseeko(file, (off_t)offset, SEEK_SET) != 0) {
+#endif
+        return false;
+    }
+    return fread(data, 1, size, file) == size;
+}
+
+static void load_virtual_texture_job(void* data) {
+    virtual_texture_t* texture = (virtual_texture_t*)data;
+    FILE* file = fopen(texture->filename, "rb");
+    if (file == NULL) {
+        printf("Unable to open the virtual texture %s.\n", texture->filename);
+        SDL_AtomicSet(&texture->state, VIRTUAL_TEXTURE_STATE_FAILED);
+        return;
+    }
+
+    virtual_texture_file_header_t header;
+    if (!read_file_at(file, 0, &header, sizeof(header)) ||
+        memcmp(header.magic, VIRTUAL_TEXTURE_FILE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != VIRTUAL_TEXTURE_FILE_VERSION ||
+        header.page_size != VIRTUAL_TEXTURE_PAGE_SIZE ||
+        header.mip_count == 0 || header.mip_count > MAX_VIRTUAL_TEXTURE_MIP_COUNT) {
+        printf("%s is not a virtual texture.\n", texture->filename);
+        fclose(file);
+        SDL_AtomicSet(&texture->state, VIRTUAL_TEXTURE_STATE_FAILED);
+        return;
+    }
+
+    texture->width = header.width;
+    texture->height = header.height;
+    texture->mip_count = header.mip_count;
+    texture->page_count = 0;
+    for (int mip = 0; mip < texture->mip_count; ++mip) {
+        texture->mip_widths[mip] = texture->width >> mip > 0 ? texture->width >> mip : 1;
+        texture->mip_heights[mip] = texture->height >> mip > 0 ? texture->height >> mip : 1;
+        texture->mip_page_columns[mip] = (texture->mip_widths[mip] + VIRTUAL_TEXTURE_PAGE_SIZE - 1) / VIRTUAL_TEXTURE_PAGE_SIZE;
+        int page_rows = (texture->mip_heights[mip] + VIRTUAL_TEXTURE_PAGE_SIZE - 1) / VIRTUAL_TEXTURE_PAGE_SIZE;
+        texture->mip_first_pages[mip] = texture->page_count;
+        texture->page_count += texture->mip_page_columns[mip] * page_rows;
+    }
+
+    texture->page_slots = (int*)malloc(sizeof(int) * texture->page_count);
+    texture->page_request_frames = (int*)malloc(sizeof(int) * texture->page_count);
+    for (int page = 0; page < texture->page_count; ++page) {
+        texture->page_slots[page] = PAGE_NOT_RESIDENT;
+        texture->page_request_frames[page] = -1;
+    }
+
+    int last_page = texture->page_count - 1;
+    texture->fallback_page = (uint32_t*)malloc(VIRTUAL_TEXTURE_PAGE_BYTES);
+    if (!read_file_at(file, get_page_data_offset() + (uint64_t)last_page * VIRTUAL_TEXTURE_PAGE_BYTES, texture->fallback_page, VIRTUAL_TEXTURE_PAGE_BYTES)) {
+        printf("%s is truncated.\n", texture->filename);
+        fclose(file);
+        SDL_AtomicSet(&texture->state, VIRTUAL_TEXTURE_STATE_FAILED);
+        return;
+    }
+    // the last mip is never paged in.
+    texture->page_slots[last_page] = PAGE_FAILED;
+    fclose(file);
+
+    SDL_AtomicSet(&texture->state, VIRTUAL_TEXTURE_STATE_READY);
+}
+
+static void load_page_job(void* data) {
+    page_slot_t* slot = (page_slot_t*)data;
+    uint32_t* texels = &slot_texels[(size_t)(slot - slots) * VIRTUAL_TEXTURE_PAGE_SIZE * VIRTUAL_TEXTURE_PAGE_SIZE];
+
+    FILE* file = fopen(slot->owner->filename, "rb");
+    bool is_read = file != NULL &&
+        read_file_at(file, get_page_data_offset() + (uint64_t)slot->page * VIRTUAL_TEXTURE_PAGE_BYTES, texels, VIRTUAL_TEXTURE_PAGE_BYTES);
+    if (file != NULL) {
+        fclose(file);
+    }
+    SDL_AtomicSet(&slot->state, is_read ? PAGE_SLOT_STATE_LOADED : PAGE_SLOT_STATE_FAILED);
+}
+
+bool is_virtual_texture_filename(const char* filename) {
+    size_t length = strlen(filename);
+    return length > 5 && strcmp(filename + length - 5, ".vtex") == 0;
+}
+
+virtual_texture_t* load_virtual_texture(const char* filename) {
+    if (strlen(filename) >= MAX_VIRTUAL_TEXTURE_FILENAME_LENGTH) {
+        printf("virtual texture filename too long: %s\n", filename);
+        return NULL;
+    }
+    for (int texture_idx = 0; texture_idx < array_length(virtual_textures); ++texture_idx) {
+        if (strcmp(virtual_textures[texture_idx]->filename, filename) == 0) {
+            virtual_textures[texture_idx]->reference_count += 1;
+            return virtual_textures[texture_idx];
+        }
+    }
+
+    virtual_texture_t* texture = (virtual_texture_t*)calloc(1, sizeof(virtual_texture_t));
+    strcpy(texture->filename, filename);
+    texture->reference_count = 1;
+    SDL_AtomicSet(&texture->state, VIRTUAL_TEXTURE_STATE_LOADING);
+    array_push(virtual_textures, texture);
+
+    submit_job(load_virtual_texture_job, texture);
+    return texture;
+}
+
+bool is_virtual_texture_ready(virtual_texture_t* texture) {
+    return texture != NULL && SDL_AtomicGet(&texture->state) == VIRTUAL_TEXTURE_STATE_READY;
+}
+
+bool is_virtual_texture_failed(virtual_texture_t* texture) {
+    return texture != NULL && SDL_AtomicGet(&texture->state) == VIRTUAL_TEXTURE_STATE_FAILED;
+}
+
+static void destroy_virtual_texture(virtual_texture_t* texture) {
+    for (int slot_idx = 0; slot_idx < slot_count; ++slot_idx) {
+        if (slots[slot_idx].owner == texture) {
+            slots[slot_idx].owner = NULL;
+            SDL_AtomicSet(&slots[slot_idx].state, PAGE_SLOT_STATE_FREE);
+        }
+    }
+
+    // misses recorded since the last update.
+    int kept_count = 0;
+    for (int request_idx = 0; request_idx < array_length(page_requests); ++request_idx) {
+        if (page_requests[request_idx].texture != texture) {
+            page_requests[kept_count++] = page_requests[request_idx];
+        }
+    }
+    array_truncate(page_requests, kept_count);
+
+    free(texture->page_slots);
+    free(texture->page_request_frames);
+    free(texture->fallback_page);
+    free(texture);
+}
+
+void release_virtual_texture(virtual_texture_t* texture) {
+    if (texture == NULL || --texture->reference_count > 0) {
+        return;
+    }
+
+    // the header read or page reads may still be in flight.
+    wait_for_jobs();
+    for (int slot_idx = 0; slot_idx < slot_count; ++slot_idx) {
+        int state = SDL_AtomicGet(&slots[slot_idx].state);
+        if (slots[slot_idx].owner == texture && (state == PAGE_SLOT_STATE_LOADED || state == PAGE_SLOT_STATE_FAILED)) {
+            pending_load_count -= 1;
+        }
+    }
+
+    int texture_count = array_length(virtual_textures);
+    for (int texture_idx = 0; texture_idx < texture_count; ++texture_idx) {
+        if (virtual_textures[texture_idx] == texture) {
+            virtual_textures[texture_idx] = virtual_textures[texture_count - 1];
+            array_truncate(virtual_textures, texture_count - 1);
+            break;
+        }
+    }
+    destroy_virtual_texture(texture);
+}
+
+int get_virtual_texture_mip(virtual_texture_t* texture, float texel_area, float pixel_area) {
+    if (pixel_area <= 0.0f || texel_area <= pixel_area) {
+        return 0;
+    }
+    // every mip has a quarter of the texels of the one before it.
+    int mip = (int)(0.5f * log2f(texel_area / pixel_area));
+    return mip < texture->mip_count - 1 ? mip : texture->mip_count - 1;
+}
+
+uint32_t sample_virtual_texture(virtual_texture_t* texture, float u, float v, int mip) {
+    for (int level = mip; level < texture->mip_count; ++level) {
+        int width = texture->mip_widths[level];
+        int height = texture->mip_heights[level];
+        // wraps like draw_texel().
+        int tex_x = abs((int)(u * width)) % width;
+        int tex_y = abs((int)(v * height)) % height;
+        int page_x = tex_x / VIRTUAL_TEXTURE_PAGE_SIZE;
+        int page_y = tex_y / VIRTUAL_TEXTURE_PAGE_SIZE;
+        int texel_idx = (tex_y % VIRTUAL_TEXTURE_PAGE_SIZE) * VIRTUAL_TEXTURE_PAGE_SIZE + tex_x % VIRTUAL_TEXTURE_PAGE_SIZE;
+        int page = texture->mip_first_pages[level] + page_y * texture->mip_page_columns[level] + page_x;
+
+        if (level == texture->mip_count - 1) {
+            return texture->fallback_page[texel_idx];
+        }
+
+        int slot_idx = texture->page_slots[page];
+        if (slot_idx >= 0) {
+            slots[slot_idx].last_used_frame = virtual_texture_frame;
+            return slot_texels[(size_t)slot_idx * VIRTUAL_TEXTURE_PAGE_SIZE * VIRTUAL_TEXTURE_PAGE_SIZE + texel_idx];
+        }
+
+        // the feedback: only the page that was wanted is requested, not the coarser ones filling in for it.
+        if (level == mip && slot_idx == PAGE_NOT_RESIDENT && texture->page_request_frames[page] != virtual_texture_frame) {
+            texture->page_request_frames[page] = virtual_texture_frame;
+            page_request_t request = { texture, page, mip };
+            array_push(page_requests, request);
+        }
+    }
+    return 0xFFFF00FF;
+}
+
+static void reset_page_cache(void) {
+    // reads in flight write into the slots that are about to go.
+    wait_for_jobs();
+    for (int texture_idx = 0; texture_idx < array_length(virtual_textures); ++texture_idx) {
+        virtual_texture_t* texture = virtual_textures[texture_idx];
+        if (!is_virtual_texture_ready(texture)) {
+            continue;
+        }
+        for (int page = 0; page < texture->page_count - 1; ++page) {
+            if (texture->page_slots[page] != PAGE_FAILED) {
+                texture->page_slots[page] = PAGE_NOT_RESIDENT;
+            }
+        }
+    }
+
+    free(slots);
+    free(slot_texels);
+    slot_count = (int)(cache_budget / VIRTUAL_TEXTURE_PAGE_BYTES);
+    slots = (page_slot_t*)calloc(slot_count > 0 ? slot_count : 1, sizeof(page_slot_t));
+    slot_texels = (uint32_t*)malloc((size_t)(slot_count > 0 ? slot_count : 1) * VIRTUAL_TEXTURE_PAGE_BYTES);
+    for (int slot_idx = 0; slot_idx < slot_count; ++slot_idx) {
+        SDL_AtomicSet(&slots[slot_idx].state, PAGE_SLOT_STATE_FREE);
+    }
+    pending_load_count = 0;
+    is_cache_stale = false;
+}
+
+// a free slot, or the least recently sampled one that was not sampled this frame.
+static int find_reusable_slot(void) {
+    int best_slot = -1;
+    for (int slot_idx = 0; slot_idx < slot_count; ++slot_idx) {
+        int state = SDL_AtomicGet(&slots[slot_idx].state);
+        if (state == PAGE_SLOT_STATE_FREE) {
+            return slot_idx;
+        }
+        if (state == PAGE_SLOT_STATE_RESIDENT && slots[slot_idx].last_used_frame < virtual_texture_frame &&
+            (best_slot < 0 || slots[slot_idx].last_used_frame < slots[best_slot].last_used_frame)) {
+            best_slot = slot_idx;
+        }
+    }
+    return best_slot;
+}
+
+static int compare_requests(const void* lhs, const void* rhs) {
+    const page_request_t* a = (const page_request_t*)lhs;
+    const page_request_t* b = (const page_request_t*)rhs;
+    return b->mip - a->mip;
+}
+
+void update_virtual_textures(void) {
+    if (is_cache_stale) {
+        reset_page_cache();
+        array_clear(page_requests);
+    }
+
+    for (int slot_idx = 0; slot_idx < slot_count; ++slot_idx) {
+        page_slot_t* slot = &slots[slot_idx];
+        int state = SDL_AtomicGet(&slot->state);
+        if (state == PAGE_SLOT_STATE_LOADED) {
+            slot->owner->page_slots[slot->page] = slot_idx;
+            slot->last_used_frame = virtual_texture_frame;
+            SDL_AtomicSet(&slot->state, PAGE_SLOT_STATE_RESIDENT);
+            pending_load_count -= 1;
+        } else if (state == PAGE_SLOT_STATE_FAILED) {
+            printf("Unable to read page %d of %s.\n", slot->page, slot->owner->filename);
+            slot->owner->page_slots[slot->page] = PAGE_FAILED;
+            slot->owner = NULL;
+            SDL_AtomicSet(&slot->state, PAGE_SLOT_STATE_FREE);
+            pending_load_count -= 1;
+        }
+    }
+
+    // coarse pages first: they cover the most screen per read, and the finer ones fall back to them.
+    if (array_length(page_requests) > 1) {
+        qsort(page_requests, array_length(page_requests), sizeof(page_request_t), compare_requests);
+    }
+    for (int request_idx = 0; request_idx < array_length(page_requests) && pending_load_count < MAX_PENDING_VIRTUAL_PAGE_LOADS; ++request_idx) {
+        page_request_t request = page_requests[request_idx];
+        if (request.texture->page_slots[request.page] != PAGE_NOT_RESIDENT) {
+            continue;
+        }
+
+        int slot_idx = find_reusable_slot();
+        // everything in the cache was sampled last frame: the cache is too small for the view, keep the coarser mips.
+        if (slot_idx < 0) {
+            break;
+        }
+        page_slot_t* slot = &slots[slot_idx];
+        if (SDL_AtomicGet(&slot->state) == PAGE_SLOT_STATE_RESIDENT) {
+            slot->owner->page_slots[slot->page] = PAGE_NOT_RESIDENT;
+        }
+
+        slot->owner = request.texture;
+        slot->page = request.page;
+        SDL_AtomicSet(&slot->state, PAGE_SLOT_STATE_LOADING);
+        request.texture->page_slots[request.page] = PAGE_LOADING;
+        pending_load_count += 1;
+        submit_job(load_page_job, slot);
+    }
+
+    array_clear(page_requests);
+    virtual_texture_frame += 1;
+}
+
+void set_virtual_texture_cache_budget(size_t bytes) {
+    cache_budget = bytes;
+    is_cache_stale = true;
+}
+
+int get_virtual_texture_resident_page_count(void) {
+    int resident_count = 0;
+    for (int slot_idx = 0; slot_idx < slot_count; ++slot_idx) {
+        resident_count += SDL_AtomicGet(&slots[slot_idx].state) == PAGE_SLOT_STATE_RESIDENT;
+    }
+    return resident_count;
+}
+
+size_t get_virtual_texture_cache_bytes(void) {
+    return (size_t)slot_count * VIRTUAL_TEXTURE_PAGE_BYTES;
+}
+
+void free_virtual_textures(void) {
+    wait_for_jobs();
+    for (int texture_idx = 0; texture_idx < array_length(virtual_textures); ++texture_idx) {
+        destroy_virtual_texture(virtual_textures[texture_idx]);
+    }
+    array_free(virtual_textures);
+    array_free(page_requests);
+    free(slots);
+    free(slot_texels);
+    virtual_textures = NULL;
+    page_requests = NULL;
+    slots = NULL;
+    slot_texels = NULL;
+    slot_count = 0;
+    pending_load_count = 0;
+    is_cache_stale = true;
+}
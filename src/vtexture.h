@@ -0,0 +1,86 @@
+#ifndef VTEXTURE_H
+#define VTEXTURE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <SDL2/SDL_atomic.h>
+
+// virtual textures: the texture and its mips are cut into fixed size pages in a tiled file (see tools/pack_vtex.c).
+// only pages the rasterizer actually asked for live in memory, in one physical page cache shared by every virtual
+// texture. the sampler translates through a page table per texture and falls back to the nearest coarser mip
+// that is resident, so texture memory follows what is on screen instead of the size of the assets.
+
+#define VIRTUAL_TEXTURE_FILE_MAGIC "SJMVTEX1"
+#define VIRTUAL_TEXTURE_FILE_VERSION 1
+// texels per side of a page. point sampling never reads across a page, so pages need no border.
+#define VIRTUAL_TEXTURE_PAGE_SIZE 128
+#define VIRTUAL_TEXTURE_PAGE_BYTES (VIRTUAL_TEXTURE_PAGE_SIZE * VIRTUAL_TEXTURE_PAGE_SIZE * 4)
+// page data starts on this boundary in the file.
+#define VIRTUAL_TEXTURE_FILE_ALIGNMENT 4096
+#define MAX_VIRTUAL_TEXTURE_MIP_COUNT 16
+#define MAX_VIRTUAL_TEXTURE_FILENAME_LENGTH 256
+#define DEFAULT_VIRTUAL_TEXTURE_CACHE_BUDGET (16 * 1024 * 1024)
+// page reads in flight at once, requests beyond that wait for a later frame.
+#define MAX_PENDING_VIRTUAL_PAGE_LOADS 16
+
+// the file is this header, then the pages of mip 0 row by row, then mip 1 and so on.
+// the last mip always fits in a single page. texels outside the mip (in edge pages) repeat the edge.
+typedef struct {
+    char magic[8];
+    uint32_t width;
+    uint32_t height;
+    uint32_t mip_count;
+    uint32_t page_size;
+    uint32_t version;
+    uint32_t reserved;
+} virtual_texture_file_header_t;
+
+enum VIRTUAL_TEXTURE_STATE {
+    VIRTUAL_TEXTURE_STATE_LOADING = 0, // the load job has not finished yet.
+    VIRTUAL_TEXTURE_STATE_READY, // the page table and the fallback page exist.
+    VIRTUAL_TEXTURE_STATE_FAILED // unreadable, not a virtual texture or truncated, never retried.
+};
+
+typedef struct {
+    char filename[MAX_VIRTUAL_TEXTURE_FILENAME_LENGTH];
+    SDL_atomic_t state; // one of VIRTUAL_TEXTURE_STATE, set by the load job.
+    int width;
+    int height;
+    int mip_count;
+    int mip_widths[MAX_VIRTUAL_TEXTURE_MIP_COUNT];
+    int mip_heights[MAX_VIRTUAL_TEXTURE_MIP_COUNT];
+    int mip_page_columns[MAX_VIRTUAL_TEXTURE_MIP_COUNT];
+    int mip_first_pages[MAX_VIRTUAL_TEXTURE_MIP_COUNT];
+    int page_count;
+    int* page_slots; // page table: physical cache slot of every virtual page, -1 if it is not resident.
+    int* page_request_frames; // the frame a page was last requested in, so every miss is recorded once.
+    uint32_t* fallback_page; // the last mip, always resident outside of the cache.
+    int reference_count;
+} virtual_texture_t;
+
+// returns a handle right away, the header and the last mip are read on the job system.
+// loading a path that is already loaded only bumps its reference count. main thread only.
+virtual_texture_t* load_virtual_texture(const char* filename);
+void release_virtual_texture(virtual_texture_t* texture);
+bool is_virtual_texture_ready(virtual_texture_t* texture);
+bool is_virtual_texture_failed(virtual_texture_t* texture);
+bool is_virtual_texture_filename(const char* filename);
+
+// the mip whose texels come closest to one per pixel, for a triangle covering texel_area (in mip 0 texels) over pixel_area.
+int get_virtual_texture_mip(virtual_texture_t* texture, float texel_area, float pixel_area);
+// point sample through the page table. a miss records the page for the next update and returns the nearest coarser texel.
+uint32_t sample_virtual_texture(virtual_texture_t* texture, float u, float v, int mip);
+
+// once per frame, before rendering: publishes finished page reads, then turns the misses of the last frame into reads,
+// coarse mips first, reusing the least recently sampled slots. slots sampled in the last frame are never reused.
+void update_virtual_textures(void);
+
+// takes effect at the first update after the call, dropping every cached page.
+void set_virtual_texture_cache_budget(size_t bytes);
+int get_virtual_texture_resident_page_count(void);
+size_t get_virtual_texture_cache_bytes(void);
+
+void free_virtual_textures(void);
+
+#endif
@@ -0,0 +1,140 @@
+// writes an asset bundle (see bundle.h): every .obj goes through the same pipeline as the loader (reordering, face
+// normals, levels of detail) and is stored as the arrays the renderer uses, every other file (the textures) as it is.
+// the entries are named by the paths as given, so pass them the way the scene loads them, e.g. ./assets/f22.obj.
+// usage: pack_bundle <out.bundle> <file> [file ...]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "array.h"
+#include "asset.h"
+#include "bundle.h"
+
+// bundles can be bigger than a long (32 bits on windows) can address, so the position is counted here instead of ftell().
+static uint64_t file_position = 0;
+
+static void write_bytes(FILE* file, const void* data, size_t size) {
+    fwrite(data, 1, size, file);
+    file_position += size;
+}
+
+static void align_file(FILE* file, uint64_t alignment) {
+    static const char zeros[BUNDLE_PAGE_SIZE] = { 0 };
+    write_bytes(file, zeros, (size_t)((alignment - file_position % alignment) % alignment));
+}
+
+// an array header followed by the items, returns the offset of the header from entry_start.
+static uint32_t write_array(FILE* file, uint64_t entry_start, const void* items, int count, int item_size) {
+    align_file(file, sizeof(int));
+    uint32_t offset = (uint32_t)(file_position - entry_start);
+    int header[2];
+    array_write_header(header, count);
+    write_bytes(file, header, ARRAY_HEADER_SIZE);
+    write_bytes(file, items, (size_t)item_size * count);
+    return offset;
+}
+
+static bool has_extension(const char* filename, const char* extension) {
+    size_t length = strlen(filename);
+    size_t extension_length = strlen(extension);
+    return length > extension_length && strcmp(filename + length - extension_length, extension) == 0;
+}
+
+static bool write_geometry(FILE* file, bundle_entry_t* entry) {
+    geometry_t geometry = { 0 };
+    build_geometry(entry->name, &geometry);
+    if (array_length(geometry.lods[0].faces) == 0) {
+        fprintf(stderr, "%s has no faces.\n", entry->name);
+        return false;
+    }
+
+    entry->type = BUNDLE_ENTRY_GEOMETRY;
+    entry->lod_count = (uint32_t)geometry.lod_count;
+    entry->bounds_center = geometry.bounds_center;
+    entry->bounds_radius = geometry.bounds_radius;
+    uint64_t entry_start = file_position;
+    for (int lod_idx = 0; lod_idx < geometry.lod_count; ++lod_idx) {
+        geometry_lod_t* lod = &geometry.lods[lod_idx];
+        entry->vertices_offsets[lod_idx] = write_array(file, entry_start, lod->vertices, array_length(lod->vertices), sizeof(vec3_t));
+        entry->faces_offsets[lod_idx] = write_array(file, entry_start, lod->faces, array_length(lod->faces), sizeof(face_t));
+        entry->face_normals_offsets[lod_idx] = write_array(file, entry_start, lod->face_normals, array_length(lod->face_normals), sizeof(vec3_t));
+        array_free(lod->vertices);
+        array_free(lod->faces);
+        array_free(lod->face_normals);
+    }
+    return true;
+}
+
+static bool write_file_contents(FILE* file, bundle_entry_t* entry) {
+    FILE* source = fopen(entry->name, "rb");
+    if (source == NULL) {
+        fprintf(stderr, "unable to open %s.\n", entry->name);
+        return false;
+    }
+    entry->type = BUNDLE_ENTRY_TEXTURE;
+    char buffer[64 * 1024];
+    size_t read_size;
+    while ((read_size = fread(buffer, 1, sizeof(buffer), source)) > 0) {
+        write_bytes(file, buffer, read_size);
+    }
+    fclose(source);
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s <out.bundle> <file> [file ...]\n", argv[0]);
+        return 1;
+    }
+    int entry_count = argc - 2;
+    for (int entry_idx = 0; entry_idx < entry_count; ++entry_idx) {
+        if (strlen(argv[entry_idx + 2]) >= MAX_ASSET_FILENAME_LENGTH) {
+            fprintf(stderr, "%s: path too long.\n", argv[entry_idx + 2]);
+            return 1;
+        }
+    }
+
+    FILE* file = fopen(argv[1], "wb");
+    if (file == NULL) {
+        fprintf(stderr, "unable to open %s for writing.\n", argv[1]);
+        return 1;
+    }
+
+    bundle_file_header_t header = {
+        .version = BUNDLE_FILE_VERSION,
+        .page_size = BUNDLE_PAGE_SIZE,
+        .entry_count = (uint32_t)entry_count,
+        .vertex_size = sizeof(vec3_t),
+        .face_size = sizeof(face_t),
+    };
+    memcpy(header.magic, BUNDLE_FILE_MAGIC, sizeof(header.magic));
+    write_bytes(file, &header, sizeof(header));
+    // the entries are filled in as the assets are written, and written over these at the end.
+    bundle_entry_t* entries = (bundle_entry_t*)calloc(entry_count, sizeof(bundle_entry_t));
+    write_bytes(file, entries, sizeof(bundle_entry_t) * entry_count);
+
+    bool is_written = true;
+    for (int entry_idx = 0; entry_idx < entry_count && is_written; ++entry_idx) {
+        bundle_entry_t* entry = &entries[entry_idx];
+        strcpy(entry->name, argv[entry_idx + 2]);
+        align_file(file, BUNDLE_PAGE_SIZE);
+        entry->offset = file_position;
+        is_written = has_extension(entry->name, ".obj") ? write_geometry(file, entry) : write_file_contents(file, entry);
+        entry->size = file_position - entry->offset;
+        if (is_written) {
+            printf("%-32s %8.1f KB%s\n", entry->name, entry->size / 1024.0,
+                entry->type == BUNDLE_ENTRY_GEOMETRY ? ", geometry" : "");
+        }
+    }
+
+    fseek(file, sizeof(header), SEEK_SET);
+    fwrite(entries, sizeof(bundle_entry_t), entry_count, file);
+    fclose(file);
+    free(entries);
+
+    if (!is_written) {
+        remove(argv[1]);
+        return 1;
+    }
+    printf("%s: %d assets, %.1f MB.\n", argv[1], entry_count, file_position / (1024.0 * 1024.0));
+    return 0;
+}
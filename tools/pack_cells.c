@@ -0,0 +1,233 @@
+// writes an out of core scene (see stream.h) from an OBJ file: the faces are bucketed into square cells on the xz plane
+// by their centroid, every cell becomes a small mesh of its own with its faces in vertex cache order.
+// repeat tiles the mesh repeat x repeat times, to build scenes bigger than the source.
+// usage: pack_cells <in.obj> <texture.png> <out.cells> [cell_size] [repeat]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "array.h"
+#include "asset.h"
+#include "stream.h"
+#include "vcache.h"
+
+typedef struct {
+    int cell_x;
+    int cell_z;
+    int face_idx;
+} cell_face_t;
+
+static int compare_cell_faces(const void* lhs, const void* rhs) {
+    const cell_face_t* a = (const cell_face_t*)lhs;
+    const cell_face_t* b = (const cell_face_t*)rhs;
+    if (a->cell_z != b->cell_z) return a->cell_z < b->cell_z ? -1 : 1;
+    if (a->cell_x != b->cell_x) return a->cell_x < b->cell_x ? -1 : 1;
+    return a->face_idx < b->face_idx ? -1 : (a->face_idx > b->face_idx ? 1 : 0);
+}
+
+// scenes can be bigger than a long (32 bits on windows) can address, so the position is counted here instead of ftell().
+static uint64_t file_position = 0;
+
+static void write_bytes(FILE* file, const void* data, size_t size) {
+    fwrite(data, 1, size, file);
+    file_position += size;
+}
+
+static void align_file(FILE* file, uint64_t alignment) {
+    static const char zeros[STREAM_PAGE_SIZE] = { 0 };
+    write_bytes(file, zeros, (size_t)((alignment - file_position % alignment) % alignment));
+}
+
+// an array header followed by the items, returns the offset of the header from cell_start.
+static uint32_t write_array(FILE* file, uint64_t cell_start, const void* items, int count, int item_size) {
+    align_file(file, sizeof(int));
+    uint32_t offset = (uint32_t)(file_position - cell_start);
+    int header[2];
+    array_write_header(header, count);
+    write_bytes(file, header, ARRAY_HEADER_SIZE);
+    write_bytes(file, items, (size_t)item_size * count);
+    return offset;
+}
+
+static void write_cell(FILE* file, stream_cell_record_t* record, vec3_t* vertices, face_t* faces) {
+    optimize_vertex_cache(faces, array_length(vertices));
+    optimize_vertex_fetch(vertices, faces);
+
+    vec3_t* face_normals = NULL;
+    for (int face_idx = 0; face_idx < array_length(faces); ++face_idx) {
+        face_t face = faces[face_idx];
+        vec3_t b_minus_a = vec3_sub(vertices[face.b], vertices[face.a]);
+        vec3_t c_minus_a = vec3_sub(vertices[face.c], vertices[face.a]);
+        array_push(face_normals, vec3_cross(b_minus_a, c_minus_a));
+    }
+
+    vec3_t min = vertices[0];
+    vec3_t max = vertices[0];
+    for (int vertex_idx = 1; vertex_idx < array_length(vertices); ++vertex_idx) {
+        vec3_t v = vertices[vertex_idx];
+        min = vec3_new(fminf(min.x, v.x), fminf(min.y, v.y), fminf(min.z, v.z));
+        max = vec3_new(fmaxf(max.x, v.x), fmaxf(max.y, v.y), fmaxf(max.z, v.z));
+    }
+    record->bounds_center = vec3_mul(vec3_add(min, max), 0.5);
+    record->bounds_radius = 0.0;
+    for (int vertex_idx = 0; vertex_idx < array_length(vertices); ++vertex_idx) {
+        record->bounds_radius = fmaxf(record->bounds_radius, vec3_length(vec3_sub(vertices[vertex_idx], record->bounds_center)));
+    }
+
+    align_file(file, STREAM_PAGE_SIZE);
+    uint64_t cell_start = file_position;
+    record->offset = cell_start;
+    record->vertex_count = array_length(vertices);
+    record->face_count = array_length(faces);
+    record->vertices_offset = write_array(file, cell_start, vertices, array_length(vertices), sizeof(vec3_t));
+    record->faces_offset = write_array(file, cell_start, faces, array_length(faces), sizeof(face_t));
+    record->face_normals_offset = write_array(file, cell_start, face_normals, array_length(face_normals), sizeof(vec3_t));
+    record->size = file_position - cell_start;
+
+    array_free(face_normals);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 4) {
+        fprintf(stderr, "usage: %s <in.obj> <texture.png> <out.cells> [cell_size] [repeat]\n", argv[0]);
+        return 1;
+    }
+    float cell_size = argc > 4 ? (float)atof(argv[4]) : 8.0f;
+    int repeat = argc > 5 ? atoi(argv[5]) : 1;
+    if (cell_size <= 0.0f || repeat <= 0 || strlen(argv[2]) >= MAX_ASSET_FILENAME_LENGTH) {
+        fprintf(stderr, "usage: %s <in.obj> <texture.png> <out.cells> [cell_size] [repeat]\n", argv[0]);
+        return 1;
+    }
+
+    geometry_lod_t source = { 0 };
+    load_obj_file_data(argv[1], &source);
+    int source_vertex_count = array_length(source.vertices);
+    int source_face_count = array_length(source.faces);
+    if (source_face_count == 0) {
+        fprintf(stderr, "%s has no faces.\n", argv[1]);
+        return 1;
+    }
+
+    // tiles sit side by side on the xz plane, as far apart as the mesh is wide.
+    vec3_t min = source.vertices[0];
+    vec3_t max = source.vertices[0];
+    for (int vertex_idx = 1; vertex_idx < source_vertex_count; ++vertex_idx) {
+        vec3_t v = source.vertices[vertex_idx];
+        min = vec3_new(fminf(min.x, v.x), fminf(min.y, v.y), fminf(min.z, v.z));
+        max = vec3_new(fmaxf(max.x, v.x), fmaxf(max.y, v.y), fmaxf(max.z, v.z));
+    }
+    vec3_t* vertices = NULL;
+    face_t* faces = NULL;
+    for (int tile_z = 0; tile_z < repeat; ++tile_z) {
+        for (int tile_x = 0; tile_x < repeat; ++tile_x) {
+            vec3_t offset = vec3_new((tile_x - repeat / 2) * (max.x - min.x), 0.0, (tile_z - repeat / 2) * (max.z - min.z));
+            int first_vertex = array_length(vertices);
+            for (int vertex_idx = 0; vertex_idx < source_vertex_count; ++vertex_idx) {
+                array_push(vertices, vec3_add(source.vertices[vertex_idx], offset));
+            }
+            for (int face_idx = 0; face_idx < source_face_count; ++face_idx) {
+                face_t face = source.faces[face_idx];
+                face.a += first_vertex;
+                face.b += first_vertex;
+                face.c += first_vertex;
+                array_push(faces, face);
+            }
+        }
+    }
+    int face_count = array_length(faces);
+    int vertex_count = array_length(vertices);
+
+    cell_face_t* cell_faces = (cell_face_t*)malloc(sizeof(cell_face_t) * face_count);
+    for (int face_idx = 0; face_idx < face_count; ++face_idx) {
+        face_t face = faces[face_idx];
+        vec3_t centroid = vec3_mul(vec3_add(vertices[face.a], vec3_add(vertices[face.b], vertices[face.c])), 1.0 / 3.0);
+        cell_faces[face_idx] = (cell_face_t){ (int)floorf(centroid.x / cell_size), (int)floorf(centroid.z / cell_size), face_idx };
+    }
+    qsort(cell_faces, face_count, sizeof(cell_face_t), compare_cell_faces);
+
+    FILE* file = fopen(argv[3], "wb");
+    if (file == NULL) {
+        fprintf(stderr, "unable to open %s for writing.\n", argv[3]);
+        return 1;
+    }
+
+    int cell_count = 0;
+    for (int sorted_idx = 0; sorted_idx < face_count; ++sorted_idx) {
+        if (sorted_idx == 0 || cell_faces[sorted_idx - 1].cell_x != cell_faces[sorted_idx].cell_x ||
+            cell_faces[sorted_idx - 1].cell_z != cell_faces[sorted_idx].cell_z) {
+            cell_count += 1;
+        }
+    }
+
+    stream_file_header_t header = {
+        .version = STREAM_FILE_VERSION,
+        .page_size = STREAM_PAGE_SIZE,
+        .cell_count = (uint32_t)cell_count,
+        .vertex_size = sizeof(vec3_t),
+        .face_size = sizeof(face_t),
+    };
+    memcpy(header.magic, STREAM_FILE_MAGIC, sizeof(header.magic));
+    write_bytes(file, &header, sizeof(header));
+    // the records are filled in as the cells are written, and written over these at the end.
+    stream_cell_record_t* records = (stream_cell_record_t*)calloc(cell_count, sizeof(stream_cell_record_t));
+    write_bytes(file, records, sizeof(stream_cell_record_t) * cell_count);
+
+    // global vertex index -> index in the current cell, valid while the stamp matches the cell.
+    int* local_vertices = (int*)malloc(sizeof(int) * vertex_count);
+    int* local_stamps = (int*)malloc(sizeof(int) * vertex_count);
+    for (int vertex_idx = 0; vertex_idx < vertex_count; ++vertex_idx) {
+        local_stamps[vertex_idx] = -1;
+    }
+
+    size_t total_bytes = 0;
+    int first_face = 0;
+    for (int cell_idx = 0; cell_idx < cell_count; ++cell_idx) {
+        int last_face = first_face;
+        while (last_face < face_count && cell_faces[last_face].cell_x == cell_faces[first_face].cell_x &&
+               cell_faces[last_face].cell_z == cell_faces[first_face].cell_z) {
+            last_face += 1;
+        }
+
+        vec3_t* cell_vertices = NULL;
+        face_t* cell_face_list = NULL;
+        for (int sorted_idx = first_face; sorted_idx < last_face; ++sorted_idx) {
+            face_t face = faces[cell_faces[sorted_idx].face_idx];
+            int* corners[3] = { &face.a, &face.b, &face.c };
+            for (int corner = 0; corner < 3; ++corner) {
+                int vertex_idx = *corners[corner];
+                if (local_stamps[vertex_idx] != cell_idx) {
+                    local_stamps[vertex_idx] = cell_idx;
+                    local_vertices[vertex_idx] = array_length(cell_vertices);
+                    array_push(cell_vertices, vertices[vertex_idx]);
+                }
+                *corners[corner] = local_vertices[vertex_idx];
+            }
+            array_push(cell_face_list, face);
+        }
+
+        strcpy(records[cell_idx].texture_filename, argv[2]);
+        write_cell(file, &records[cell_idx], cell_vertices, cell_face_list);
+        total_bytes += records[cell_idx].size;
+
+        array_free(cell_vertices);
+        array_free(cell_face_list);
+        first_face = last_face;
+    }
+
+    fseek(file, sizeof(header), SEEK_SET);
+    fwrite(records, sizeof(stream_cell_record_t), cell_count, file);
+    fclose(file);
+
+    printf("%s: %d faces in %d cells of %.1f units, %.1f MB of cell data.\n",
+        argv[3], face_count, cell_count, cell_size, total_bytes / (1024.0 * 1024.0));
+
+    free(local_stamps);
+    free(local_vertices);
+    free(records);
+    free(cell_faces);
+    array_free(vertices);
+    array_free(faces);
+    array_free(source.vertices);
+    array_free(source.faces);
+    return 0;
+}
@@ -0,0 +1,134 @@
+// writes a virtual texture (see vtexture.h) from an RGBA PNG: the image and a chain of box filtered mips,
+// every level cut into pages, down to the first mip that fits in a single page.
+// usage: pack_vtex <in.png> <out.vtex>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "upng.h"
+#include "vtexture.h"
+
+// the average of a 2x2 block per channel. an odd edge reuses its last row / column.
+static uint32_t* downsample(const uint32_t* texels, int width, int height, int* out_width, int* out_height) {
+    int half_width = width > 1 ? width / 2 : 1;
+    int half_height = height > 1 ? height / 2 : 1;
+    uint32_t* half = (uint32_t*)malloc(sizeof(uint32_t) * half_width * half_height);
+    for (int y = 0; y < half_height; ++y) {
+        int y0 = y * 2 < height ? y * 2 : height - 1;
+        int y1 = y * 2 + 1 < height ? y * 2 + 1 : height - 1;
+        for (int x = 0; x < half_width; ++x) {
+            int x0 = x * 2 < width ? x * 2 : width - 1;
+            int x1 = x * 2 + 1 < width ? x * 2 + 1 : width - 1;
+            uint32_t corners[4] = { texels[y0 * width + x0], texels[y0 * width + x1], texels[y1 * width + x0], texels[y1 * width + x1] };
+            uint32_t texel = 0;
+            for (int shift = 0; shift < 32; shift += 8) {
+                uint32_t sum = 0;
+                for (int corner = 0; corner < 4; ++corner) {
+                    sum += (corners[corner] >> shift) & 0xFF;
+                }
+                texel |= ((sum + 2) / 4) << shift;
+            }
+            half[y * half_width + x] = texel;
+        }
+    }
+    *out_width = half_width;
+    *out_height = half_height;
+    return half;
+}
+
+// pages row by row, texels past the edge of the level repeat the edge.
+static size_t write_level(FILE* file, const uint32_t* texels, int width, int height) {
+    uint32_t* page = (uint32_t*)malloc(VIRTUAL_TEXTURE_PAGE_BYTES);
+    int page_columns = (width + VIRTUAL_TEXTURE_PAGE_SIZE - 1) / VIRTUAL_TEXTURE_PAGE_SIZE;
+    int page_rows = (height + VIRTUAL_TEXTURE_PAGE_SIZE - 1) / VIRTUAL_TEXTURE_PAGE_SIZE;
+    for (int page_y = 0; page_y < page_rows; ++page_y) {
+        for (int page_x = 0; page_x < page_columns; ++page_x) {
+            for (int y = 0; y < VIRTUAL_TEXTURE_PAGE_SIZE; ++y) {
+                int source_y = page_y * VIRTUAL_TEXTURE_PAGE_SIZE + y;
+                source_y = source_y < height ? source_y : height - 1;
+                for (int x = 0; x < VIRTUAL_TEXTURE_PAGE_SIZE; ++x) {
+                    int source_x = page_x * VIRTUAL_TEXTURE_PAGE_SIZE + x;
+                    source_x = source_x < width ? source_x : width - 1;
+                    page[y * VIRTUAL_TEXTURE_PAGE_SIZE + x] = texels[source_y * width + source_x];
+                }
+            }
+            fwrite(page, 1, VIRTUAL_TEXTURE_PAGE_BYTES, file);
+        }
+    }
+    free(page);
+    return (size_t)page_columns * page_rows;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s <in.png> <out.vtex>\n", argv[0]);
+        return 1;
+    }
+
+    upng_t* png_image = upng_new_from_file(argv[1]);
+    if (png_image == NULL) {
+        fprintf(stderr, "unable to read %s.\n", argv[1]);
+        return 1;
+    }
+    upng_decode(png_image);
+    if (upng_get_error(png_image) != UPNG_EOK || upng_get_format(png_image) != UPNG_RGBA8) {
+        fprintf(stderr, "%s is not an RGBA PNG.\n", argv[1]);
+        upng_free(png_image);
+        return 1;
+    }
+    int width = upng_get_width(png_image);
+    int height = upng_get_height(png_image);
+
+    int mip_count = 1;
+    for (int w = width, h = height; w > VIRTUAL_TEXTURE_PAGE_SIZE || h > VIRTUAL_TEXTURE_PAGE_SIZE; ++mip_count) {
+        w = w > 1 ? w / 2 : 1;
+        h = h > 1 ? h / 2 : 1;
+    }
+    if (mip_count > MAX_VIRTUAL_TEXTURE_MIP_COUNT) {
+        fprintf(stderr, "%s is too big for %d mips.\n", argv[1], MAX_VIRTUAL_TEXTURE_MIP_COUNT);
+        upng_free(png_image);
+        return 1;
+    }
+
+    FILE* file = fopen(argv[2], "wb");
+    if (file == NULL) {
+        fprintf(stderr, "unable to open %s for writing.\n", argv[2]);
+        upng_free(png_image);
+        return 1;
+    }
+
+    virtual_texture_file_header_t header = {
+        .width = (uint32_t)width,
+        .height = (uint32_t)height,
+        .mip_count = (uint32_t)mip_count,
+        .page_size = VIRTUAL_TEXTURE_PAGE_SIZE,
+        .version = VIRTUAL_TEXTURE_FILE_VERSION,
+    };
+    memcpy(header.magic, VIRTUAL_TEXTURE_FILE_MAGIC, sizeof(header.magic));
+    fwrite(&header, sizeof(header), 1, file);
+    static const char zeros[VIRTUAL_TEXTURE_FILE_ALIGNMENT] = { 0 };
+    fwrite(zeros, 1, VIRTUAL_TEXTURE_FILE_ALIGNMENT - sizeof(header), file);
+
+    // the decoded buffer is used as is, the renderer reads it the same way (see draw_texel()).
+    const uint32_t* level = (const uint32_t*)upng_get_buffer(png_image);
+    uint32_t* owned_level = NULL;
+    int level_width = width;
+    int level_height = height;
+    size_t page_count = 0;
+    for (int mip = 0; mip < mip_count; ++mip) {
+        page_count += write_level(file, level, level_width, level_height);
+        if (mip + 1 < mip_count) {
+            uint32_t* next = downsample(level, level_width, level_height, &level_width, &level_height);
+            free(owned_level);
+            owned_level = next;
+            level = next;
+        }
+    }
+    fclose(file);
+
+    printf("%s: %dx%d, %d mips, %zu pages, %.1f MB.\n", argv[2], width, height, mip_count, page_count,
+        page_count * VIRTUAL_TEXTURE_PAGE_BYTES / (1024.0 * 1024.0));
+
+    free(owned_level);
+    upng_free(png_image);
+    return 0;
+}